@@ -1,6 +1,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <sstream>
+#include <QtDebug>
 #include "applogger.h"
 
 Logger GlobalLog;
@@ -9,32 +10,35 @@ Logger GlobalLog;
 
 Logger::Logger()
 {
+  for (unsigned int module = 0; module < LOG_NUM_MODULES; module++) {
+    m_currentLogLevels[module].store(DEFAULT_LOG_LEVEL, std::memory_order_relaxed);
+  }
 }
 
 void
 Logger::SetModuleLogLevel(unsigned int module, LogLevel level)
 {
-  m_currentLogLevels[module] = level;
+  if (module >= LOG_NUM_MODULES) {
+    return;
+  }
+
+  m_currentLogLevels[module].store(level, std::memory_order_relaxed);
 }
 
 Logger::LogLevel
 Logger::GetModuleLogLevel(unsigned int module)
 {
-  if (m_currentLogLevels.contains(module) == false) {
-    m_currentLogLevels[module] = DEFAULT_LOG_LEVEL;
+  if (module >= LOG_NUM_MODULES) {
+    return DEFAULT_LOG_LEVEL;
   }
 
-  return m_currentLogLevels[module];
+  return (LogLevel)m_currentLogLevels[module].load(std::memory_order_relaxed);
 }
 
 void
 Logger::LogMessage(unsigned int module, LogLevel severity, const char *const format, ...)
 {
-  if (m_currentLogLevels.contains(module) == false) {
-    m_currentLogLevels[module] = DEFAULT_LOG_LEVEL;
-  }
-
-  if (severity <= m_currentLogLevels[module]) {
+  if (IsEnabled(module, severity)) {
     va_list args;
     va_start(args, format);
 
@@ -54,11 +58,7 @@ Logger::LogMessageWithFuncTrace(unsigned int module, LogLevel severity,
                                 const char *const format,
                                 ...)
 {
-  if (m_currentLogLevels.contains(module) == false) {
-    m_currentLogLevels[module] = DEFAULT_LOG_LEVEL;
-  }
-
-  if (severity <= m_currentLogLevels[module]) {
+  if (IsEnabled(module, severity)) {
     va_list args;
     va_start(args, format);
 
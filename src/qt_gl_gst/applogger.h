@@ -2,7 +2,16 @@
 #define LOGGER_H
 
 #include <libgen.h>
-#include <QMap>
+#include <atomic>
+
+// Global log module directory:
+enum {
+  LOG_GL,
+  LOG_GLSHADERS,
+  LOG_OBJLOADER,
+  LOG_VIDPIPELINE,
+  LOG_NUM_MODULES
+};
 
 class Logger
 {
@@ -24,32 +33,44 @@ public:
                                const char *const format,
                                ...);
 
+  // Called by the LOG macro before anything else is evaluated, so must stay cheap
+  bool IsEnabled(unsigned int module, LogLevel severity) {
+    return (module < LOG_NUM_MODULES) &&
+           (severity <= m_currentLogLevels[module].load(std::memory_order_relaxed));
+  }
+
 private:
   void outputMessage(unsigned int module, LogLevel severity, const char *const message);
-  QMap<unsigned int, LogLevel> m_currentLogLevels;
+  std::atomic<int> m_currentLogLevels[LOG_NUM_MODULES];
 };
 
 #define DEFAULT_LOG_LEVEL  Logger::Warning
 
+// Most verbose level which is compiled in at all. LOG calls above this level
+// are removed by the compiler, e.g. build with -DLOG_COMPILED_LEVEL=2 to
+// strip all the Debug1/Debug2 calls from the per-frame paths.
+#ifndef LOG_COMPILED_LEVEL
+ #define LOG_COMPILED_LEVEL Logger::Debug2
+#endif
+
 
 // The global object actually used for LOG calls
 extern Logger GlobalLog;
 
-#define LOG(moduleId, severity, ...)                    \
-  GlobalLog.LogMessageWithFuncTrace(moduleId, severity, \
-        basename(__FILE__),                             \
-        __PRETTY_FUNCTION__,                            \
-        __LINE__,                                       \
-        __VA_ARGS__                                     \
-  )
-
-// Global log module directory:
-enum {
-  LOG_GL,
-  LOG_GLSHADERS,
-  LOG_OBJLOADER,
-  LOG_VIDPIPELINE
-};
+// Arguments are only evaluated when the message is logged, so they mustn't
+// do anything else, e.g. increment a counter
+#define LOG(moduleId, severity, ...)                          \
+  do {                                                        \
+    if (((severity) <= LOG_COMPILED_LEVEL) &&                 \
+        GlobalLog.IsEnabled(moduleId, severity)) {            \
+      GlobalLog.LogMessageWithFuncTrace(moduleId, severity,   \
+            basename(__FILE__),                               \
+            __PRETTY_FUNCTION__,                              \
+            __LINE__,                                         \
+            __VA_ARGS__                                       \
+      );                                                      \
+    }                                                         \
+  } while (0)
 
 
 #endif // LOGGER_H
@@ -0,0 +1,272 @@
+#include <iostream>
+#include <QStringList>
+#include "appoptions.h"
+#include "pipelinefactory.h"
+
+AppOptions::AppOptions() :
+  m_headless(false), m_headlessFrames(DFLT_HEADLESS_FRAMES),
+  m_headlessSize(DFLT_HEADLESS_WIDTH, DFLT_HEADLESS_HEIGHT), m_syntheticCount(0),
+  m_syntheticFormat(DFLT_SYNTH_FORMAT), m_syntheticSize(DFLT_SYNTH_WIDTH, DFLT_SYNTH_HEIGHT),
+  m_syntheticFps(DFLT_SYNTH_FPS), m_gpuTiming(false), m_instancing(true),
+  m_throttleHidden(false), m_textureBudgetMB(0), m_asyncUploadBuffers(0),
+  m_dmabufImport(true), m_pboPoolMB(0),
+  m_deinterlaceMode(DFLT_DEINTERLACE_MODE), m_colourLut(false), m_pipelineBackend(PIPELINE_BACKEND_AUTO),
+  m_syncStreams(false), m_offlineFps(0)
+{
+}
+
+bool
+AppOptions::Parse(int argc, char *argv[])
+{
+  bool framesGiven = false;
+
+  for (int argIx = 1; argIx < argc; argIx++) {
+    QString arg(argv[argIx]);
+
+    if (arg.startsWith("--") == false) {
+      m_videoLocations.push_back(arg);
+      continue;
+    }
+
+    // Options all take the form --name or --name=value
+    QString name = arg.section('=', 0, 0);
+    QString value = arg.section('=', 1);
+    bool ok = true;
+
+    if (name == "--headless") {
+      m_headless = true;
+    }
+    else if (name == "--frames") {
+      m_headlessFrames = value.toInt(&ok);
+      ok = ok && (m_headlessFrames > 0);
+      framesGiven = true;
+    }
+    else if (name == "--size") {
+      ok = parseSize(value, m_headlessSize);
+    }
+    else if (name == "--bench-output") {
+      m_benchOutputFile = value;
+      ok = !value.isEmpty();
+    }
+    else if (name == "--gpu-timing") {
+      m_gpuTiming = true;
+    }
+    else if (name == "--layout") {
+      m_layoutFile = value;
+      ok = !value.isEmpty();
+    }
+    else if (name == "--throttle-hidden") {
+      m_throttleHidden = true;
+    }
+    else if (name == "--tex-budget") {
+      m_textureBudgetMB = value.toInt(&ok);
+      ok = ok && (m_textureBudgetMB >= 0);
+    }
+    else if (name == "--async-upload") {
+      m_asyncUploadBuffers = DFLT_ASYNC_UPLOAD_BUFFERS;
+      if (!value.isEmpty()) {
+        m_asyncUploadBuffers = value.toInt(&ok);
+        ok = ok && (m_asyncUploadBuffers >= 2) && (m_asyncUploadBuffers <= 3);
+      }
+    }
+    else if (name == "--no-dmabuf") {
+      m_dmabufImport = false;
+    }
+    else if (name == "--pbo-pool") {
+      m_pboPoolMB = DFLT_PBO_POOL_MB;
+      if (!value.isEmpty()) {
+        m_pboPoolMB = value.toInt(&ok);
+        ok = ok && (m_pboPoolMB > 0);
+      }
+    }
+    else if (name == "--deinterlace") {
+      ok = Deinterlacer::ParseMode(value, m_deinterlaceMode);
+    }
+    else if (name == "--colour-lut") {
+      m_colourLut = true;
+      m_colourLutFile = value;
+    }
+    else if (name == "--effects") {
+      ok = parseEffectChain(value);
+    }
+    else if (name == "--record") {
+      m_recordFile = value;
+      ok = !value.isEmpty();
+    }
+    else if (name == "--offline") {
+      m_offlineFps = value.toInt(&ok);
+      ok = ok && (m_offlineFps > 0);
+    }
+    else if (name == "--pipeline") {
+      m_pipelineBackend = value;
+      ok = (value == PIPELINE_BACKEND_AUTO) || PipelineFactory::IsRegistered(value);
+    }
+    else if (name == "--sync-streams") {
+      m_syncStreams = true;
+    }
+    else if (name == "--no-instancing") {
+      m_instancing = false;
+    }
+    else if (name == "--synthetic") {
+      m_syntheticCount = value.toInt(&ok);
+      ok = ok && (m_syntheticCount > 0);
+    }
+    else if (name == "--synth-format") {
+      m_syntheticFormat = value.toUpper();
+      ok = (m_syntheticFormat == "I420") || (m_syntheticFormat == "NV12") || (m_syntheticFormat == "UYVY") ||
+           (m_syntheticFormat == "I420_10LE") || (m_syntheticFormat == "P010_10LE");
+    }
+    else if (name == "--synth-size") {
+      ok = parseSize(value, m_syntheticSize);
+    }
+    else if (name == "--synth-fps") {
+      m_syntheticFps = value.toInt(&ok);
+      ok = ok && (m_syntheticFps > 0);
+    }
+    else if (name == "--help") {
+      return false;
+    }
+    else {
+      std::cerr << "Unknown option " << arg.toUtf8().constData() << "\n";
+      return false;
+    }
+
+    if (!ok) {
+      std::cerr << "Bad value for option " << arg.toUtf8().constData() << "\n";
+      return false;
+    }
+  }
+
+  if (m_offlineFps > 0) {
+    if (m_recordFile.isEmpty()) {
+      std::cerr << "--offline needs --record\n";
+      return false;
+    }
+
+    // Frames are stepped through in step with each other, each uploaded
+    // before the output frame it's in is drawn, and none skipped
+    m_headless = true;
+    m_syncStreams = true;
+    m_asyncUploadBuffers = 0;
+    m_throttleHidden = false;
+    if (!framesGiven) {
+      m_headlessFrames = 0;
+    }
+  }
+
+  // Format options can come after --synthetic, so only build locations now
+  for (int synthIx = 0; synthIx < m_syntheticCount; synthIx++) {
+    m_videoLocations.push_back(QString("%1%2:%3x%4@%5")
+                               .arg(SYNTHETIC_VIDEO_LOCATION_PREFIX)
+                               .arg(m_syntheticFormat)
+                               .arg(m_syntheticSize.width())
+                               .arg(m_syntheticSize.height())
+                               .arg(m_syntheticFps));
+  }
+
+  return true;
+}
+
+void
+AppOptions::PrintUsage(const char *progName)
+{
+  std::cout << "Usage: " << progName << " [options] [video files...]\n\n"
+               "With no video files a test source is used. .y4m files, and headerless raw files\n"
+               "given as raw:<fourcc>:<width>x<height>@<fps>:<file>, are played without decoding.\n\n"
+               "Options:\n"
+               "  --headless        Render offscreen, print frame time stats then exit\n"
+               "  --frames=N        Number of frames to render in headless mode (default "
+            << DFLT_HEADLESS_FRAMES << ")\n"
+               "  --size=WxH        Headless render target size (default "
+            << DFLT_HEADLESS_WIDTH << "x" << DFLT_HEADLESS_HEIGHT << ")\n"
+               "  --bench-output=F  Also write headless results to file F as JSON\n"
+               "  --gpu-timing      Measure GPU time of each render pass, if supported\n"
+               "  --layout=F        Lay out the videos as described in JSON file F\n"
+               "  --throttle-hidden Skip uploads and throttle decoding of videos facing away or off screen\n"
+               "  --tex-budget=N    Keep video textures within N MB, reusing freed ones (default no limit)\n"
+               "  --async-upload[=N]\n"
+               "                    Upload frames on a separate thread into N textures per video,\n"
+               "                    2 or 3 (default "
+            << DFLT_ASYNC_UPLOAD_BUFFERS << "). Turns off instancing\n"
+               "  --no-dmabuf       Always copy frames into textures, even if they could be imported\n"
+               "  --pbo-pool[=N]    Have decoders write frames into N MB of mapped pixel buffers\n"
+               "                    (default "
+            << DFLT_PBO_POOL_MB << "). Not with --async-upload\n"
+               "  --deinterlace=M   Deinterlace interlaced videos on the GPU, M is "
+            << Deinterlacer::ModeNames() << "\n"
+               "                    (default " DFLT_DEINTERLACE_MODE_NAME "). Not with --async-upload\n"
+               "  --colour-lut[=F]  Convert and apply colour effects with a 3D LUT lookup, graded with\n"
+               "                    .cube file F if given\n"
+               "  --effects=[N:]C   Draw video N, or all of them, through effect chain C, a comma\n"
+               "                    separated list of "
+            << EffectChain::PassNames() << ".\n"
+               "                    Can be given once per video\n"
+               "  --record=F        Record what's rendered to F, .mp4 or .mkv, with a hardware H.264\n"
+               "                    encoder where there is one\n"
+               "  --offline=FPS     Render the recording headlessly at FPS frames a second, as fast as\n"
+               "                    it can be rather than in real time, until the videos end or\n"
+               "                    --frames. Implies --headless and --sync-streams\n"
+               "  --pipeline=NAME   Play videos with pipeline backend NAME (default "
+            << PIPELINE_BACKEND_AUTO << ", picks one per video):\n";
+  QStringList backendNames = PipelineFactory::Names();
+  for (int backendIx = 0; backendIx < backendNames.size(); backendIx++) {
+    std::cout << "                      " << backendNames[backendIx].toUtf8().constData() << ": "
+              << PipelineFactory::Description(backendNames[backendIx]).toUtf8().constData() << "\n";
+  }
+  std::cout << "  --sync-streams    Play all videos in step on one clock, frame accurately\n"
+               "  --no-instancing   Draw every video quad separately, even where they could be batched\n"
+               "  --synthetic=N     Add N generated test streams\n"
+               "  --synth-format=F  Synthetic stream format, I420, NV12, UYVY, or 10 bit I420_10LE or\n"
+               "                    P010_10LE (default "
+            << DFLT_SYNTH_FORMAT << ")\n"
+               "  --synth-size=WxH  Synthetic stream size (default "
+            << DFLT_SYNTH_WIDTH << "x" << DFLT_SYNTH_HEIGHT << ")\n"
+               "  --synth-fps=N     Synthetic stream frame rate (default "
+            << DFLT_SYNTH_FPS << ")\n"
+               "  --help            Show this text\n";
+}
+
+bool
+AppOptions::parseSize(const QString &sizeStr, QSize &size)
+{
+  QStringList dims = sizeStr.split('x');
+  if (dims.size() != 2) {
+    return false;
+  }
+
+  bool widthOk, heightOk;
+  int width = dims[0].toInt(&widthOk);
+  int height = dims[1].toInt(&heightOk);
+  if (!widthOk || !heightOk || (width <= 0) || (height <= 0)) {
+    return false;
+  }
+
+  size = QSize(width, height);
+  return true;
+}
+
+// [N:]chain, N being the video index
+bool
+AppOptions::parseEffectChain(const QString &optionValue)
+{
+  int vidIx = -1;
+  QString chainDesc = optionValue;
+
+  if (optionValue.contains(':')) {
+    bool ok;
+    vidIx = optionValue.section(':', 0, 0).toInt(&ok);
+    if (!ok || (vidIx < 0)) {
+      return false;
+    }
+    chainDesc = optionValue.section(':', 1);
+  }
+
+  // Only checked here, each vid parses its own
+  EffectChain chain;
+  if (!chain.Parse(chainDesc)) {
+    return false;
+  }
+
+  m_effectChains.insert(vidIx, chainDesc);
+  return true;
+}
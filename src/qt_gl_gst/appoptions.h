@@ -0,0 +1,111 @@
+#ifndef APPOPTIONS_H
+#define APPOPTIONS_H
+
+#include <QVector>
+#include <QString>
+#include <QSize>
+#include <QMap>
+
+#include "deinterlacer.h"
+#include "effectchain.h"
+
+#define DFLT_HEADLESS_FRAMES        1000
+#define DFLT_HEADLESS_WIDTH         1280
+#define DFLT_HEADLESS_HEIGHT        720
+
+#define DFLT_SYNTH_FORMAT           "I420"
+#define DFLT_SYNTH_WIDTH            1280
+#define DFLT_SYNTH_HEIGHT           720
+#define DFLT_SYNTH_FPS              30
+
+#define DFLT_ASYNC_UPLOAD_BUFFERS   3
+#define DFLT_PBO_POOL_MB            64
+#define DFLT_DEINTERLACE_MODE       DeinterlaceLinear
+#define DFLT_DEINTERLACE_MODE_NAME  "linear"
+
+// Command line options. Anything not starting with "--" is taken as
+// a video location, one pipeline is created for each.
+class AppOptions
+{
+public:
+  AppOptions();
+
+  bool Parse(int argc, char *argv[]);
+  void PrintUsage(const char *progName);
+
+  QVector<QString> m_videoLocations;
+
+  // Render a fixed number of frames offscreen then print stats and exit
+  bool m_headless;
+  int m_headlessFrames;
+  QSize m_headlessSize;
+  // Headless results are also written here as JSON if set
+  QString m_benchOutputFile;
+
+  // Time render passes on the GPU with timer queries, where supported
+  bool m_gpuTiming;
+
+  // Batch same format/size video quads into instanced draws, where supported
+  bool m_instancing;
+
+  // JSON file describing how to lay out the videos, see vidlayout.h
+  QString m_layoutFile;
+
+  // Don't upload frames of videos which are off screen or facing away,
+  // and have their pipelines throttle decoding
+  bool m_throttleHidden;
+
+  // Most video texture memory to allocate in MB, 0 for no limit
+  int m_textureBudgetMB;
+
+  // Textures per video when uploading on a separate thread, 0 to upload
+  // on the GUI thread
+  int m_asyncUploadBuffers;
+
+  // Import dmabuf frames on the GPU rather than copying them, where supported
+  bool m_dmabufImport;
+
+  // MB of persistently mapped pixel buffer for decoders to write frames
+  // into, 0 to have them allocate their own
+  int m_pboPoolMB;
+
+  // How frames the caps say are interlaced are deinterlaced on the GPU
+  DeinterlaceMode m_deinterlaceMode;
+
+  // Do YUV conversion and colour effects with one 3D LUT lookup, graded by
+  // the .cube file if one is given
+  bool m_colourLut;
+  QString m_colourLutFile;
+
+  // Effect chain descriptions by video index, see effectchain.h. Key -1
+  // is the chain for every video not given its own.
+  QMap<int, QString> m_effectChains;
+
+  // Record the composited output to this file, .mp4 or .mkv
+  QString m_recordFile;
+
+  // Render the recording headlessly at this frame rate as fast as it can
+  // be done rather than in real time, 0 for off. Runs until the videos
+  // end, or for m_headlessFrames if one was given.
+  int m_offlineFps;
+
+  // Pipeline backend to play the videos with, or "auto" to pick one for
+  // each, see pipelinefactory.h
+  QString m_pipelineBackend;
+
+  // Run every pipeline on one clock and show the frame from each that's
+  // due at each render, for frame accurate side by side playback
+  bool m_syncStreams;
+
+  // Synthetic test streams, added after any video files
+  int m_syntheticCount;
+  QString m_syntheticFormat;
+  QSize m_syntheticSize;
+  int m_syntheticFps;
+
+private:
+  bool parseSize(const QString &sizeStr, QSize &size);
+  bool parseEffectChain(const QString &optionValue);
+};
+
+#endif // APPOPTIONS_H
@@ -0,0 +1,394 @@
+#include <string.h>
+#include <QCoreApplication>
+#include <gst/gst.h>
+#include "asynctexuploader.h"
+#include "applogger.h"
+
+AsyncTexUploader::AsyncTexUploader(GLenum target, TexturePool *texturePool) :
+  m_target(target), m_texturePool(texturePool), m_available(false), m_keepRunning(false),
+  m_numBuffers(ASYNCUPLOAD_MAX_BUFFERS), m_nextSeq(0), m_uploadContext(NULL), m_uploadSurface(NULL)
+{
+}
+
+AsyncTexUploader::~AsyncTexUploader()
+{
+  Stop();
+  delete m_uploadContext;
+  delete m_uploadSurface;
+}
+
+bool
+AsyncTexUploader::Start(const QGLContext *shareContext, int numBuffers)
+{
+  QOpenGLContext *shareHandle = shareContext->contextHandle();
+  if (shareHandle == NULL) {
+    LOG(LOG_GL, Logger::Warning, "No context to share with, textures will be uploaded on the GUI thread");
+    return false;
+  }
+
+  // Without fences nothing stops the upload thread writing into a texture
+  // the renderer's draws haven't finished reading
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "GL_ARB_sync") || !m_glExt.ResolveSync(shareContext)) {
+    LOG(LOG_GL, Logger::Info, "No ARB_sync, textures will be uploaded on the GUI thread");
+    return false;
+  }
+
+  m_numBuffers = qBound(ASYNCUPLOAD_MIN_BUFFERS, numBuffers, ASYNCUPLOAD_MAX_BUFFERS);
+
+  m_uploadContext = new QOpenGLContext();
+  m_uploadContext->setFormat(shareHandle->format());
+  m_uploadContext->setShareContext(shareHandle);
+  // Share context is NULL afterwards if the platform couldn't share
+  if (!m_uploadContext->create() || (m_uploadContext->shareContext() == NULL)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't create shared upload context, textures will be uploaded on the GUI thread");
+    delete m_uploadContext;
+    m_uploadContext = NULL;
+    return false;
+  }
+
+  // Has to be created on the GUI thread, only made current on the upload one
+  m_uploadSurface = new QOffscreenSurface();
+  m_uploadSurface->setFormat(m_uploadContext->format());
+  m_uploadSurface->create();
+  if (!m_uploadSurface->isValid()) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't create upload surface, textures will be uploaded on the GUI thread");
+    delete m_uploadContext;
+    m_uploadContext = NULL;
+    delete m_uploadSurface;
+    m_uploadSurface = NULL;
+    return false;
+  }
+
+  m_uploadContext->moveToThread(this);
+  m_keepRunning = true;
+  m_available = true;
+  start();
+
+  LOG(LOG_GL, Logger::Info, "Uploading textures on a separate thread, %d buffers per video", m_numBuffers);
+  return true;
+}
+
+void
+AsyncTexUploader::Stop()
+{
+  if (!isRunning()) {
+    return;
+  }
+
+  m_mutex.lock();
+  m_keepRunning = false;
+  m_jobQueued.wakeAll();
+  m_mutex.unlock();
+
+  wait();
+}
+
+bool
+AsyncTexUploader::ConfigureVid(int vidIx, GLint internalFormat, GLenum format, GLenum type,
+                               int width, int height, QList<void *> &droppedBufs)
+{
+  QMutexLocker locker(&m_mutex);
+
+  removeRing(vidIx, droppedBufs);
+
+  VidRing ring;
+  ring.internalFormat = internalFormat;
+  ring.format = format;
+  ring.type = type;
+  ring.width = width;
+  ring.height = height;
+
+  for (int slotIx = 0; slotIx < m_numBuffers; slotIx++) {
+    UploadSlot slot;
+    slot.texId = m_texturePool->Acquire(internalFormat, format, type, width, height);
+    slot.state = SlotFree;
+    slot.buf = NULL;
+    slot.seq = 0;
+    slot.uploadFence = NULL;
+    slot.drawFence = NULL;
+
+    if (slot.texId == 0) {
+      releaseRing(ring, droppedBufs);
+      return false;
+    }
+    ring.slots.append(slot);
+  }
+
+  m_rings.insert(vidIx, ring);
+  return true;
+}
+
+void
+AsyncTexUploader::RemoveVid(int vidIx, QList<void *> &droppedBufs)
+{
+  QMutexLocker locker(&m_mutex);
+  removeRing(vidIx, droppedBufs);
+}
+
+void
+AsyncTexUploader::Submit(int vidIx, void *buf, void **droppedBuf)
+{
+  QMutexLocker locker(&m_mutex);
+
+  *droppedBuf = NULL;
+  if (!m_rings.contains(vidIx)) {
+    *droppedBuf = buf;
+    return;
+  }
+
+  // Best to worst: an unused texture, replacing a frame that hasn't been
+  // started on yet, then overwriting the oldest one that was never shown
+  QVector<UploadSlot> &slots = m_rings[vidIx].slots;
+  int useIx = -1;
+  for (int slotIx = 0; (slotIx < slots.size()) && (useIx < 0); slotIx++) {
+    if (slots[slotIx].state == SlotFree) {
+      useIx = slotIx;
+    }
+  }
+  for (int slotIx = 0; (slotIx < slots.size()) && (useIx < 0); slotIx++) {
+    if (slots[slotIx].state == SlotQueued) {
+      *droppedBuf = slots[slotIx].buf;
+      useIx = slotIx;
+    }
+  }
+  if (useIx < 0) {
+    for (int slotIx = 0; slotIx < slots.size(); slotIx++) {
+      if ((slots[slotIx].state == SlotReady) &&
+          ((useIx < 0) || (slots[slotIx].seq < slots[useIx].seq))) {
+        useIx = slotIx;
+      }
+    }
+    if (useIx >= 0) {
+      // Only the upload thread writes it again, so its own ordering is enough
+      deleteFence(slots[useIx].uploadFence);
+    }
+  }
+
+  if (useIx < 0) {
+    // Double buffered with one shown and one uploading
+    *droppedBuf = buf;
+    return;
+  }
+
+  slots[useIx].buf = buf;
+  slots[useIx].state = SlotQueued;
+  slots[useIx].seq = m_nextSeq++;
+  m_jobQueued.wakeOne();
+}
+
+GLuint
+AsyncTexUploader::TakeReady(int vidIx, QList<void *> &doneBufs)
+{
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_rings.contains(vidIx)) {
+    return 0;
+  }
+
+  VidRing &ring = m_rings[vidIx];
+  doneBufs.append(ring.doneBufs);
+  ring.doneBufs.clear();
+
+  int newestIx = -1;
+  for (int slotIx = 0; slotIx < ring.slots.size(); slotIx++) {
+    if ((ring.slots[slotIx].state == SlotReady) &&
+        ((newestIx < 0) || (ring.slots[slotIx].seq > ring.slots[newestIx].seq))) {
+      newestIx = slotIx;
+    }
+  }
+  if (newestIx < 0) {
+    return 0;
+  }
+
+  bool drawFenced = false;
+  for (int slotIx = 0; slotIx < ring.slots.size(); slotIx++) {
+    UploadSlot &slot = ring.slots[slotIx];
+    if (slotIx == newestIx) {
+      continue;
+    }
+
+    if (slot.state == SlotShown) {
+      // Upload thread waits for draws already issued with it before reusing it
+      slot.drawFence = m_glExt.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      drawFenced = true;
+      slot.state = SlotFree;
+    }
+    else if (slot.state == SlotReady) {
+      // Older than the newest, never going to be shown
+      deleteFence(slot.uploadFence);
+      slot.state = SlotFree;
+    }
+  }
+
+  // Waits on the GPU, not here
+  UploadSlot &newest = ring.slots[newestIx];
+  if (newest.uploadFence) {
+    m_glExt.glWaitSync(newest.uploadFence, 0, GL_TIMEOUT_IGNORED);
+    deleteFence(newest.uploadFence);
+  }
+  newest.state = SlotShown;
+
+  // Other contexts can only wait on fences which have been flushed
+  if (drawFenced) {
+    glFlush();
+  }
+
+  return newest.texId;
+}
+
+void
+AsyncTexUploader::run()
+{
+  m_uploadContext->makeCurrent(m_uploadSurface);
+  LOG(LOG_GL, Logger::Debug1, "Upload thread started");
+
+  int vidIx, slotIx;
+  while (takeNextJob(vidIx, slotIx)) {
+    uploadSlot(vidIx, slotIx);
+    emit uploaded(vidIx);
+  }
+
+  m_uploadContext->doneCurrent();
+  // Back to the GUI thread, where it gets deleted
+  m_uploadContext->moveToThread(QCoreApplication::instance()->thread());
+  LOG(LOG_GL, Logger::Debug1, "Upload thread finished");
+}
+
+// Oldest queued frame of any vid, false when stopping
+bool
+AsyncTexUploader::takeNextJob(int &vidIx, int &slotIx)
+{
+  QMutexLocker locker(&m_mutex);
+
+  while (m_keepRunning) {
+    bool found = false;
+    quint64 oldestSeq = 0;
+
+    QMap<int, VidRing>::iterator ringIt;
+    for (ringIt = m_rings.begin(); ringIt != m_rings.end(); ++ringIt) {
+      const QVector<UploadSlot> &slots = ringIt.value().slots;
+      for (int ix = 0; ix < slots.size(); ix++) {
+        if ((slots[ix].state == SlotQueued) && (!found || (slots[ix].seq < oldestSeq))) {
+          vidIx = ringIt.key();
+          slotIx = ix;
+          oldestSeq = slots[ix].seq;
+          found = true;
+        }
+      }
+    }
+
+    if (found) {
+      m_rings[vidIx].slots[slotIx].state = SlotUploading;
+      return true;
+    }
+
+    m_jobQueued.wait(&m_mutex);
+  }
+
+  return false;
+}
+
+void
+AsyncTexUploader::uploadSlot(int vidIx, int slotIx)
+{
+  // Ring can't be removed while a slot is uploading, but take copies rather
+  // than hold the lock through the upload
+  m_mutex.lock();
+  const VidRing &ring = m_rings[vidIx];
+  UploadSlot slot = ring.slots[slotIx];
+  GLenum format = ring.format;
+  GLenum type = ring.type;
+  int width = ring.width;
+  int height = ring.height;
+  m_mutex.unlock();
+
+  if (slot.drawFence) {
+    m_glExt.glWaitSync(slot.drawFence, 0, GL_TIMEOUT_IGNORED);
+    m_glExt.glDeleteSync(slot.drawFence);
+  }
+
+  bool uploaded = false;
+  GstMapInfo info;
+  if (gst_buffer_map((GstBuffer *)slot.buf, &info, GST_MAP_READ)) {
+    glBindTexture(m_target, slot.texId);
+    glTexSubImage2D(m_target, 0, 0, 0, width, height, format, type, info.data);
+    glBindTexture(m_target, 0);
+    gst_buffer_unmap((GstBuffer *)slot.buf, &info);
+    uploaded = true;
+  }
+
+  GLsync uploadFence = NULL;
+  if (uploaded) {
+    uploadFence = m_glExt.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+  }
+
+  m_mutex.lock();
+  VidRing &doneRing = m_rings[vidIx];
+  UploadSlot &doneSlot = doneRing.slots[slotIx];
+  doneSlot.drawFence = NULL;
+  doneSlot.uploadFence = uploadFence;
+  doneSlot.state = uploaded ? SlotReady : SlotFree;
+  // GL has its own copy of the data now
+  doneRing.doneBufs.append(doneSlot.buf);
+  doneSlot.buf = NULL;
+  m_uploadDone.wakeAll();
+  m_mutex.unlock();
+
+  if (!uploaded) {
+    LOG(LOG_GL, Logger::Warning, "vid %d couldn't map buffer for upload", vidIx);
+  }
+}
+
+void
+AsyncTexUploader::removeRing(int vidIx, QList<void *> &droppedBufs)
+{
+  if (!m_rings.contains(vidIx)) {
+    return;
+  }
+
+  // Upload thread has to finish with its texture first
+  bool uploading = true;
+  while (uploading) {
+    uploading = false;
+    const QVector<UploadSlot> &slots = m_rings[vidIx].slots;
+    for (int slotIx = 0; slotIx < slots.size(); slotIx++) {
+      uploading = uploading || (slots[slotIx].state == SlotUploading);
+    }
+    if (uploading) {
+      m_uploadDone.wait(&m_mutex);
+    }
+  }
+
+  releaseRing(m_rings[vidIx], droppedBufs);
+  m_rings.remove(vidIx);
+}
+
+void
+AsyncTexUploader::releaseRing(VidRing &ring, QList<void *> &droppedBufs)
+{
+  for (int slotIx = 0; slotIx < ring.slots.size(); slotIx++) {
+    UploadSlot &slot = ring.slots[slotIx];
+    if (slot.buf) {
+      droppedBufs.append(slot.buf);
+      slot.buf = NULL;
+    }
+    deleteFence(slot.uploadFence);
+    deleteFence(slot.drawFence);
+    m_texturePool->Release(slot.texId);
+  }
+  ring.slots.clear();
+
+  droppedBufs.append(ring.doneBufs);
+  ring.doneBufs.clear();
+}
+
+void
+AsyncTexUploader::deleteFence(GLsync &fence)
+{
+  if (fence) {
+    m_glExt.glDeleteSync(fence);
+    fence = NULL;
+  }
+}
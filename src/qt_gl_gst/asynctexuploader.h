@@ -0,0 +1,127 @@
+#ifndef ASYNCTEXUPLOADER_H
+#define ASYNCTEXUPLOADER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QGLContext>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QVector>
+#include <QList>
+#include <QMap>
+
+#include "texturepool.h"
+#include "glextfunctions.h"
+
+#define ASYNCUPLOAD_MIN_BUFFERS              2
+#define ASYNCUPLOAD_MAX_BUFFERS              3
+
+// Uploads video frames on its own thread, with a GL context shared with the
+// renderer's. Each vid gets a ring of double or triple buffered textures
+// from the texture pool: one being shown, one ready, one being uploaded to.
+// The renderer just swaps to the newest ready texture when told one is done.
+//
+// Fences order the upload before the renderer's use of a texture and the
+// renderer's last draw before the next upload into it, so ARB_sync is
+// needed.
+class AsyncTexUploader : public QThread
+{
+  Q_OBJECT
+
+public:
+  AsyncTexUploader(GLenum target, TexturePool *texturePool);
+  ~AsyncTexUploader();
+
+  // Renderer's context must be current. Returns false if there's no
+  // ARB_sync or a shared context can't be made, in which case uploads
+  // should be done as before.
+  bool Start(const QGLContext *shareContext, int numBuffers);
+  void Stop();
+  bool IsAvailable() const { return m_available; }
+
+  // (Re)allocate the vid's textures for frames of this format and size,
+  // waiting for any upload in progress first. Frames which were queued come
+  // back in droppedBufs. Renderer's context must be current.
+  bool ConfigureVid(int vidIx, GLint internalFormat, GLenum format, GLenum type,
+                    int width, int height, QList<void *> &droppedBufs);
+  void RemoveVid(int vidIx, QList<void *> &droppedBufs);
+
+  // Queue a frame to be uploaded. If every texture is busy a frame is
+  // dropped, either an older queued one or this one, and comes back in
+  // droppedBuf to be returned to its pipeline.
+  void Submit(int vidIx, void *buf, void **droppedBuf);
+
+  // Renderer side when uploaded() comes in. Returns the texture to draw the
+  // vid with from now on, or 0 if there's nothing new. Frames which have
+  // been uploaded come back in doneBufs. Renderer's context must be current.
+  GLuint TakeReady(int vidIx, QList<void *> &doneBufs);
+
+Q_SIGNALS:
+  void uploaded(int vidIx);
+
+protected:
+  void run();
+
+private:
+  typedef enum
+  {
+    SlotFree,
+    SlotQueued,
+    SlotUploading,
+    SlotReady,
+    SlotShown
+  } SlotState;
+
+  typedef struct _UploadSlot
+  {
+    GLuint texId;
+    SlotState state;
+    void *buf;
+    // Order frames were queued in, oldest uploaded first
+    quint64 seq;
+    // Upload done, set by the upload thread
+    GLsync uploadFence;
+    // Renderer's last draw with the texture, set when it stops being shown
+    GLsync drawFence;
+  } UploadSlot;
+
+  typedef struct _VidRing
+  {
+    GLint internalFormat;
+    GLenum format;
+    GLenum type;
+    int width;
+    int height;
+    QVector<UploadSlot> slots;
+    QList<void *> doneBufs;
+  } VidRing;
+
+  bool takeNextJob(int &vidIx, int &slotIx);
+  void uploadSlot(int vidIx, int slotIx);
+  // These need the mutex held
+  void removeRing(int vidIx, QList<void *> &droppedBufs);
+  void releaseRing(VidRing &ring, QList<void *> &droppedBufs);
+  void deleteFence(GLsync &fence);
+
+  GLenum m_target;
+  TexturePool *m_texturePool;
+  bool m_available;
+  bool m_keepRunning;
+  int m_numBuffers;
+  quint64 m_nextSeq;
+
+  QOpenGLContext *m_uploadContext;
+  QOffscreenSurface *m_uploadSurface;
+
+  // Sync group only
+  GLExtFunctions m_glExt;
+
+  // Everything below is shared with the upload thread
+  QMutex m_mutex;
+  QWaitCondition m_jobQueued;
+  QWaitCondition m_uploadDone;
+  QMap<int, VidRing> m_rings;
+};
+
+#endif // ASYNCTEXUPLOADER_H
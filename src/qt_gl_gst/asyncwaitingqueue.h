@@ -7,13 +7,13 @@
 
 /* Thread safe queue implementation which can block (with timeout)
    on get until an item arrives in the queue, at which point thread
-   is woken up.
+   is woken up. Writers can likewise block until there's room.
 */
 template<class T>
 class AsyncQueue
 {
 public:
-  AsyncQueue() : m_waitingReaders(0) {}
+  AsyncQueue() : m_waitingReaders(0), m_waitingWriters(0) {}
 
   int size() {
     QMutexLocker locker(&m_mutex);
@@ -42,6 +42,8 @@ public:
       T item = this->m_buffer.front();
       this->m_buffer.pop_front();
       *itemDestPtr = item;
+      if (this->m_waitingWriters)
+        this->m_bufferHasRoom.wakeAll();
       return true;
     }
     else {
@@ -49,12 +51,43 @@ public:
     }
   }
 
+  // Block until there are fewer than maxItems, or wakeWriters is called.
+  // Returns false if there still isn't room.
+  bool waitForRoom(int maxItems, unsigned long time_ms) {
+    QMutexLocker locker(&m_mutex);
+    if (this->m_buffer.size() < maxItems)
+      return true;
+
+    ++(this->m_waitingWriters);
+    this->m_bufferHasRoom.wait(&m_mutex, time_ms);
+    --(this->m_waitingWriters);
+    return this->m_buffer.size() < maxItems;
+  }
+
+  // Lets anything in waitForRoom give up waiting
+  void wakeWriters() {
+    QMutexLocker locker(&m_mutex);
+    this->m_bufferHasRoom.wakeAll();
+  }
+
+  // Look at the item get would return next without taking it
+  bool peek(T *itemDestPtr) {
+    QMutexLocker locker(&m_mutex);
+    if (this->m_buffer.size()) {
+      *itemDestPtr = this->m_buffer.front();
+      return true;
+    }
+    return false;
+  }
+
 private:
   typedef QList<T> Container;
   QMutex m_mutex;
   QWaitCondition m_bufferIsNotEmpty;
+  QWaitCondition m_bufferHasRoom;
   Container m_buffer;
   short m_waitingReaders;
+  short m_waitingWriters;
 };
 
 
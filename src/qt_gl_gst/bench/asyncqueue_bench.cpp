@@ -0,0 +1,167 @@
+// Microbenchmarks for AsyncQueue, the handoff between the pipeline
+// threads and the renderer. Any replacement queue should beat these.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "asyncwaitingqueue.h"
+
+// Same as QUEUE_THREADBLOCK_WAITTIME_MS in gstpipeline.h, not included
+// here to keep GStreamer out of the benchmark build
+#define BENCH_THREADBLOCK_WAITTIME_MS     50
+
+typedef std::chrono::steady_clock BenchClock;
+
+// put then get on one thread, i.e. the cost of the locking alone
+static void
+BM_PutGetUncontended(benchmark::State &state)
+{
+  AsyncQueue<void *> queue;
+  void *item = &queue;
+  void *gotItem = NULL;
+
+  for (auto _ : state) {
+    queue.put(item);
+    queue.get(&gotItem);
+    benchmark::DoNotOptimize(gotItem);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PutGetUncontended);
+
+// One producer thread, consumer blocks in get like the outgoing buffer thread
+static void
+BM_SpscThroughput(benchmark::State &state)
+{
+  const int batchSize = 1000;
+  AsyncQueue<void *> queue;
+  void *item = &queue;
+
+  for (auto _ : state) {
+    std::thread producer([&queue, item]() {
+      for (int i = 0; i < batchSize; i++) {
+        queue.put(item);
+      }
+    });
+
+    void *gotItem = NULL;
+    for (int i = 0; i < batchSize; i++) {
+      while (!queue.get(&gotItem, BENCH_THREADBLOCK_WAITTIME_MS)) {
+      }
+    }
+
+    producer.join();
+  }
+
+  state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_SpscThroughput)->UseRealTime();
+
+// Time from put to a reader blocked in get waking up with the item
+static void
+BM_WakeLatency(benchmark::State &state)
+{
+  AsyncQueue<BenchClock::time_point> queue;
+  std::atomic<bool> readerWaiting(false);
+  std::atomic<bool> keepRunning(true);
+  AsyncQueue<BenchClock::duration> latencies;
+
+  std::thread reader([&]() {
+    BenchClock::time_point putTime;
+    while (keepRunning) {
+      readerWaiting = true;
+      if (queue.get(&putTime, BENCH_THREADBLOCK_WAITTIME_MS)) {
+        latencies.put(BenchClock::now() - putTime);
+      }
+    }
+  });
+
+  for (auto _ : state) {
+    // Give the reader a chance to actually block first
+    while (!readerWaiting) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    readerWaiting = false;
+
+    queue.put(BenchClock::now());
+
+    BenchClock::duration latency;
+    while (!latencies.get(&latency, BENCH_THREADBLOCK_WAITTIME_MS)) {
+    }
+    state.SetIterationTime(std::chrono::duration<double>(latency).count());
+  }
+
+  keepRunning = false;
+  reader.join();
+}
+BENCHMARK(BM_WakeLatency)->UseManualTime();
+
+// N streams each with their own decode thread putting into its queue, one
+// consumer polling all of them without blocking like newFrame does
+static void
+BM_MultiStreamContention(benchmark::State &state)
+{
+  const int numStreams = state.range(0);
+  const int framesPerStream = 200;
+  std::vector<AsyncQueue<void *> *> queues;
+  for (int streamIx = 0; streamIx < numStreams; streamIx++) {
+    queues.push_back(new AsyncQueue<void *>());
+  }
+
+  for (auto _ : state) {
+    std::vector<std::thread> producers;
+    for (int streamIx = 0; streamIx < numStreams; streamIx++) {
+      AsyncQueue<void *> *queue = queues[streamIx];
+      producers.push_back(std::thread([queue]() {
+        for (int i = 0; i < framesPerStream; i++) {
+          queue->put(queue);
+        }
+      }));
+    }
+
+    int remaining = numStreams * framesPerStream;
+    void *gotItem = NULL;
+    while (remaining) {
+      for (int streamIx = 0; streamIx < numStreams; streamIx++) {
+        if (queues[streamIx]->get(&gotItem)) {
+          --remaining;
+        }
+      }
+    }
+
+    for (size_t threadIx = 0; threadIx < producers.size(); threadIx++) {
+      producers[threadIx].join();
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * numStreams * framesPerStream);
+
+  for (int streamIx = 0; streamIx < numStreams; streamIx++) {
+    delete queues[streamIx];
+  }
+}
+BENCHMARK(BM_MultiStreamContention)->Arg(1)->Arg(5)->Arg(16)->UseRealTime();
+
+// get on an empty queue with a timeout, arg is the timeout in ms. Checks the
+// wait really lasts as long as asked, and what that costs in CPU.
+static void
+BM_TimedWaitEmpty(benchmark::State &state)
+{
+  AsyncQueue<void *> queue;
+  void *gotItem = NULL;
+
+  for (auto _ : state) {
+    bool gotOne = queue.get(&gotItem, state.range(0));
+    benchmark::DoNotOptimize(gotOne);
+  }
+}
+BENCHMARK(BM_TimedWaitEmpty)->Arg(1)->Arg(BENCH_THREADBLOCK_WAITTIME_MS)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
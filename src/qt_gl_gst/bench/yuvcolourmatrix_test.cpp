@@ -0,0 +1,155 @@
+// CPU reference for YuvColourMatrix, the same sums the conversion shaders
+// do, against the published BT.601 and BT.709 figures
+
+#include <gtest/gtest.h>
+
+#include "yuvcolourmatrix.h"
+
+// Published coefficients are to 3 or 4 places
+#define COEFF_TOLERANCE     0.001f
+// 8 bit samples only get within a step or so of a colour
+#define SAMPLE_TOLERANCE    (2.0f/255.0f)
+
+static Colorimetry
+colorimetry(ColMatrix matrix, bool fullRange)
+{
+  Colorimetry col;
+  col.matrix = matrix;
+  col.fullRange = fullRange;
+  return col;
+}
+
+static QVector3D
+toRgb8(const YuvToRgbCoeffs &coeffs, int y, int u, int v)
+{
+  return YuvColourMatrix::ToRgb(coeffs, QVector3D(y/255.0f, u/255.0f, v/255.0f));
+}
+
+static void
+expectRgb(const QVector3D &rgb, float r, float g, float b)
+{
+  EXPECT_NEAR(rgb.x(), r, SAMPLE_TOLERANCE);
+  EXPECT_NEAR(rgb.y(), g, SAMPLE_TOLERANCE);
+  EXPECT_NEAR(rgb.z(), b, SAMPLE_TOLERANCE);
+}
+
+TEST(YuvColourMatrixTest, Bt601LimitedCoeffs)
+{
+  YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT601, false), 480);
+
+  EXPECT_FLOAT_EQ(coeffs.offset.x(), -16.0f/255.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.y(), -128.0f/255.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.z(), -128.0f/255.0f);
+
+  EXPECT_NEAR(coeffs.rCoeff.x(), 1.164f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.rCoeff.y(), 0.0f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.rCoeff.z(), 1.596f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.x(), 1.164f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.y(), -0.392f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.z(), -0.813f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.x(), 1.164f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.y(), 2.017f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.z(), 0.0f, COEFF_TOLERANCE);
+}
+
+TEST(YuvColourMatrixTest, Bt601FullCoeffs)
+{
+  YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT601, true), 480);
+
+  EXPECT_FLOAT_EQ(coeffs.offset.x(), 0.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.y(), -128.0f/255.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.z(), -128.0f/255.0f);
+
+  EXPECT_NEAR(coeffs.rCoeff.x(), 1.0f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.rCoeff.z(), 1.402f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.y(), -0.344f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.z(), -0.714f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.y(), 1.772f, COEFF_TOLERANCE);
+}
+
+TEST(YuvColourMatrixTest, Bt709LimitedCoeffs)
+{
+  YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT709, false), 1080);
+
+  EXPECT_FLOAT_EQ(coeffs.offset.x(), -16.0f/255.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.y(), -128.0f/255.0f);
+  EXPECT_FLOAT_EQ(coeffs.offset.z(), -128.0f/255.0f);
+
+  EXPECT_NEAR(coeffs.rCoeff.x(), 1.164f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.rCoeff.z(), 1.793f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.y(), -0.213f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.z(), -0.533f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.y(), 2.112f, COEFF_TOLERANCE);
+}
+
+TEST(YuvColourMatrixTest, Bt709FullCoeffs)
+{
+  YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT709, true), 1080);
+
+  EXPECT_FLOAT_EQ(coeffs.offset.x(), 0.0f);
+
+  EXPECT_NEAR(coeffs.rCoeff.x(), 1.0f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.rCoeff.z(), 1.5748f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.y(), -0.1873f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.gCoeff.z(), -0.4681f, COEFF_TOLERANCE);
+  EXPECT_NEAR(coeffs.bCoeff.y(), 1.8556f, COEFF_TOLERANCE);
+}
+
+// Unknown matrices go by frame height
+TEST(YuvColourMatrixTest, UnknownMatrixGuessedFromHeight)
+{
+  YuvToRgbCoeffs sd = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_Unknown, false), 576);
+  YuvToRgbCoeffs hd = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_Unknown, false), 720);
+
+  EXPECT_NEAR(sd.rCoeff.z(), 1.596f, COEFF_TOLERANCE);
+  EXPECT_NEAR(hd.rCoeff.z(), 1.793f, COEFF_TOLERANCE);
+}
+
+// Limited range black and white are stretched out to 0 and 1
+TEST(YuvColourMatrixTest, LimitedRangeBlackAndWhite)
+{
+  ColMatrix matrices[] = { ColMatrix_BT601, ColMatrix_BT709 };
+  for (int matIx = 0; matIx < 2; matIx++) {
+    YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(matrices[matIx], false), 480);
+    expectRgb(toRgb8(coeffs, 16, 128, 128), 0.0f, 0.0f, 0.0f);
+    expectRgb(toRgb8(coeffs, 235, 128, 128), 1.0f, 1.0f, 1.0f);
+  }
+}
+
+// Full range greys come out as they went in
+TEST(YuvColourMatrixTest, FullRangeGreysUnchanged)
+{
+  ColMatrix matrices[] = { ColMatrix_BT601, ColMatrix_BT709 };
+  for (int matIx = 0; matIx < 2; matIx++) {
+    YuvToRgbCoeffs coeffs = YuvColourMatrix::Coeffs(colorimetry(matrices[matIx], true), 480);
+    for (int y = 0; y <= 255; y += 51) {
+      QVector3D rgb = toRgb8(coeffs, y, 128, 128);
+      EXPECT_FLOAT_EQ(rgb.x(), y/255.0f);
+      EXPECT_FLOAT_EQ(rgb.y(), y/255.0f);
+      EXPECT_FLOAT_EQ(rgb.z(), y/255.0f);
+    }
+  }
+}
+
+// 100% colour bars in 8 bit limited range
+TEST(YuvColourMatrixTest, LimitedRangePrimaries)
+{
+  YuvToRgbCoeffs bt601 = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT601, false), 480);
+  expectRgb(toRgb8(bt601, 82, 90, 240), 1.0f, 0.0f, 0.0f);
+  expectRgb(toRgb8(bt601, 145, 54, 34), 0.0f, 1.0f, 0.0f);
+  expectRgb(toRgb8(bt601, 41, 240, 110), 0.0f, 0.0f, 1.0f);
+
+  YuvToRgbCoeffs bt709 = YuvColourMatrix::Coeffs(colorimetry(ColMatrix_BT709, false), 1080);
+  expectRgb(toRgb8(bt709, 63, 102, 240), 1.0f, 0.0f, 0.0f);
+  expectRgb(toRgb8(bt709, 173, 42, 26), 0.0f, 1.0f, 0.0f);
+  expectRgb(toRgb8(bt709, 32, 240, 118), 0.0f, 0.0f, 1.0f);
+}
+
+TEST(YuvColourMatrixTest, PassthroughLeavesSamples)
+{
+  QVector3D yuv(0.25f, 0.5f, 0.75f);
+  QVector3D out = YuvColourMatrix::ToRgb(YuvColourMatrix::Passthrough(), yuv);
+  EXPECT_FLOAT_EQ(out.x(), yuv.x());
+  EXPECT_FLOAT_EQ(out.y(), yuv.y());
+  EXPECT_FLOAT_EQ(out.z(), yuv.z());
+}
@@ -0,0 +1,305 @@
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QElapsedTimer>
+#include "colourlut.h"
+#include "applogger.h"
+
+ColourLut::ColourLut() :
+  m_available(false), m_size(0), m_bakes(0), m_gradeSize(0),
+  m_gradeDomainMin(0.0f, 0.0f, 0.0f), m_gradeDomainMax(1.0f, 1.0f, 1.0f)
+{
+}
+
+ColourLut::~ColourLut()
+{
+}
+
+void
+ColourLut::Cleanup()
+{
+  for (int lutIx = 0; lutIx < m_luts.size(); lutIx++) {
+    glDeleteTextures(1, &m_luts[lutIx].texId);
+  }
+  m_luts.clear();
+}
+
+bool
+ColourLut::Init(const QGLContext *context, int size)
+{
+  if (!m_glExt.ResolveTexture3D(context)) {
+    LOG(LOG_GL, Logger::Info, "No 3D texture support, colour LUT not used");
+    return false;
+  }
+
+  m_size = size;
+  m_available = true;
+  LOG(LOG_GL, Logger::Info, "Colour conversion and effects done with %d^3 LUTs", m_size);
+  return true;
+}
+
+// "LUT_3D_SIZE N", optional "DOMAIN_MIN/MAX r g b" and "TITLE", then N^3
+// lines of "r g b" with red changing fastest
+bool
+ColourLut::LoadCubeFile(const QString &fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    LOG(LOG_GL, Logger::Error, "Couldn't open LUT file %s", fileName.toUtf8().constData());
+    return false;
+  }
+
+  int size = 0;
+  QVector<QVector3D> entries;
+  QVector3D domainMin(0.0f, 0.0f, 0.0f);
+  QVector3D domainMax(1.0f, 1.0f, 1.0f);
+  QTextStream stream(&file);
+  int lineNum = 0;
+  while (!stream.atEnd()) {
+    QString line = stream.readLine().trimmed();
+    lineNum++;
+    if (line.isEmpty() || line.startsWith('#') || line.startsWith("TITLE")) {
+      continue;
+    }
+
+    QStringList fields = line.split(QRegExp("\\s+"));
+    bool ok = true;
+    if (fields[0] == "LUT_3D_SIZE") {
+      size = (fields.size() == 2) ? fields[1].toInt(&ok) : 0;
+      ok = ok && (size >= 2) && (size <= COLOURLUT_MAX_CUBE_SIZE);
+      entries.reserve(size * size * size);
+    }
+    else if ((fields[0] == "DOMAIN_MIN") || (fields[0] == "DOMAIN_MAX")) {
+      ok = (fields.size() == 4);
+      QVector3D domain;
+      for (int compIx = 0; ok && (compIx < 3); compIx++) {
+        domain[compIx] = fields[compIx + 1].toFloat(&ok);
+      }
+      if (fields[0] == "DOMAIN_MIN") {
+        domainMin = domain;
+      }
+      else {
+        domainMax = domain;
+      }
+    }
+    else if (fields[0] == "LUT_1D_SIZE") {
+      LOG(LOG_GL, Logger::Error, "%s is a 1D LUT, only 3D ones are supported", fileName.toUtf8().constData());
+      return false;
+    }
+    else {
+      ok = (size > 0) && (fields.size() == 3);
+      QVector3D entry;
+      for (int compIx = 0; ok && (compIx < 3); compIx++) {
+        entry[compIx] = fields[compIx].toFloat(&ok);
+      }
+      entries.append(entry);
+    }
+
+    if (!ok) {
+      LOG(LOG_GL, Logger::Error, "%s line %d not understood: %s", fileName.toUtf8().constData(), lineNum,
+          line.toUtf8().constData());
+      return false;
+    }
+  }
+
+  if ((size == 0) || (entries.size() != size * size * size)) {
+    LOG(LOG_GL, Logger::Error, "%s has %d entries, expected %d", fileName.toUtf8().constData(),
+        entries.size(), size * size * size);
+    return false;
+  }
+  for (int compIx = 0; compIx < 3; compIx++) {
+    if (domainMax[compIx] <= domainMin[compIx]) {
+      LOG(LOG_GL, Logger::Error, "%s domain is empty", fileName.toUtf8().constData());
+      return false;
+    }
+  }
+
+  m_gradeSize = size;
+  m_grade = entries;
+  m_gradeDomainMin = domainMin;
+  m_gradeDomainMax = domainMax;
+
+  // Anything already baked was without it
+  for (int lutIx = 0; lutIx < m_luts.size(); lutIx++) {
+    m_luts[lutIx].baked = false;
+  }
+
+  LOG(LOG_GL, Logger::Info, "Loaded %d^3 grading LUT %s", m_gradeSize, fileName.toUtf8().constData());
+  return true;
+}
+
+GLuint
+ColourLut::Bind(const YuvToRgbCoeffs &coeffs, ColourLutEffect effect, const ColourLutParams &params)
+{
+  int matchIx = -1;
+  for (int lutIx = 0; lutIx < m_luts.size(); lutIx++) {
+    const LutEntry &lut = m_luts[lutIx];
+    if ((lut.effect == effect) && (lut.coeffs.offset == coeffs.offset) &&
+        (lut.coeffs.rCoeff == coeffs.rCoeff) && (lut.coeffs.gCoeff == coeffs.gCoeff) &&
+        (lut.coeffs.bCoeff == coeffs.bCoeff)) {
+      matchIx = lutIx;
+      break;
+    }
+  }
+
+  if (matchIx < 0) {
+    LutEntry newLut;
+    newLut.coeffs = coeffs;
+    newLut.effect = effect;
+    newLut.baked = false;
+
+    glGenTextures(1, &newLut.texId);
+    glBindTexture(GL_TEXTURE_3D, newLut.texId);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    m_glExt.glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, m_size, m_size, m_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    m_luts.append(newLut);
+    matchIx = m_luts.size() - 1;
+  }
+
+  LutEntry &lut = m_luts[matchIx];
+  glBindTexture(GL_TEXTURE_3D, lut.texId);
+  if (!lut.baked || paramsChanged(lut, params)) {
+    bake(lut, params);
+  }
+
+  return lut.texId;
+}
+
+void
+ColourLut::SetUniforms(QGLShaderProgram *prog)
+{
+  // YUV 0..1 onto the centres of the first and last entries
+  prog->setUniformValue("u_lutTexture", COLOURLUT_TEXTURE_UNIT);
+  prog->setUniformValue("u_lutScale", (GLfloat)(m_size - 1) / m_size);
+  prog->setUniformValue("u_lutOffset", 0.5f / m_size);
+}
+
+void
+ColourLut::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("colourlut_luts", m_luts.size());
+  stats.SetCounter("colourlut_bakes", m_bakes);
+}
+
+// Only what the effect uses counts, so plain conversion LUTs are never
+// rebaked and the animated swap doesn't rebake the hilight ones
+bool
+ColourLut::paramsChanged(const LutEntry &entry, const ColourLutParams &params) const
+{
+  switch (entry.effect) {
+  case ColourLutHilightSwap:
+    if ((entry.bakedParams.swapR != params.swapR) || (entry.bakedParams.swapG != params.swapG) ||
+        (entry.bakedParams.swapB != params.swapB)) {
+      return true;
+    }
+    // Fall through, the range applies as well
+  case ColourLutHilight:
+    return (entry.bakedParams.hilightMin != params.hilightMin) ||
+           (entry.bakedParams.hilightMax != params.hilightMax);
+  default:
+    return false;
+  }
+}
+
+// Texture must be bound
+void
+ColourLut::bake(LutEntry &entry, const ColourLutParams &params)
+{
+  QElapsedTimer bakeTimer;
+  bakeTimer.start();
+
+  QVector<GLubyte> texels(m_size * m_size * m_size * 4);
+  GLubyte *texel = texels.data();
+  float step = 1.0f / (m_size - 1);
+
+  // Y along s, U along t and V along r, as the shader looks them up
+  for (int vIx = 0; vIx < m_size; vIx++) {
+    for (int uIx = 0; uIx < m_size; uIx++) {
+      for (int yIx = 0; yIx < m_size; yIx++) {
+        QVector3D rgb = YuvColourMatrix::ToRgb(entry.coeffs, QVector3D(yIx * step, uIx * step, vIx * step));
+        rgb = applyEffect(rgb, entry.effect, params);
+        if (m_gradeSize > 0) {
+          rgb = applyGrade(rgb);
+        }
+
+        for (int compIx = 0; compIx < 3; compIx++) {
+          *texel++ = (GLubyte)(qBound(0.0f, rgb[compIx], 1.0f) * 255.0f + 0.5f);
+        }
+        *texel++ = 255;
+      }
+    }
+  }
+
+  m_glExt.glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_size, m_size, m_size, GL_RGBA, GL_UNSIGNED_BYTE, texels.constData());
+
+  entry.baked = true;
+  entry.bakedParams = params;
+  m_bakes++;
+
+  LOG(LOG_GL, Logger::Debug2, "Baked colour LUT %u, effect %d, in %lld us", entry.texId, entry.effect,
+      bakeTimer.nsecsElapsed() / 1000);
+}
+
+// Same sums as colourhilight.frag and colourhilightswap.frag, including the
+// range test only looking at red
+QVector3D
+ColourLut::applyEffect(const QVector3D &rgb, ColourLutEffect effect, const ColourLutParams &params) const
+{
+  if (effect == ColourLutNoEffect) {
+    return rgb;
+  }
+
+  float red = rgb.x();
+  bool inRange = (red > params.hilightMin.x()) && (red < params.hilightMax.x()) &&
+                 (red > params.hilightMin.y()) && (red < params.hilightMax.y()) &&
+                 (red > params.hilightMin.z()) && (red < params.hilightMax.z());
+  if (!inRange) {
+    float mono = (rgb.x() + rgb.y() + rgb.z()) / 3.0f;
+    return QVector3D(mono, mono, mono);
+  }
+  if (effect == ColourLutHilight) {
+    return rgb;
+  }
+
+  QVector4D rgba(rgb, 1.0f);
+  return QVector3D(qBound(0.0f, QVector4D::dotProduct(rgba, params.swapR), 1.0f),
+                   qBound(0.0f, QVector4D::dotProduct(rgba, params.swapG), 1.0f),
+                   qBound(0.0f, QVector4D::dotProduct(rgba, params.swapB), 1.0f));
+}
+
+// Trilinear lookup into the loaded .cube
+QVector3D
+ColourLut::applyGrade(const QVector3D &rgb) const
+{
+  int index[3];
+  float frac[3];
+  for (int compIx = 0; compIx < 3; compIx++) {
+    float pos = (rgb[compIx] - m_gradeDomainMin[compIx]) / (m_gradeDomainMax[compIx] - m_gradeDomainMin[compIx]);
+    pos = qBound(0.0f, pos, 1.0f) * (m_gradeSize - 1);
+    index[compIx] = qMin((int)pos, m_gradeSize - 2);
+    frac[compIx] = pos - index[compIx];
+  }
+
+  QVector3D result;
+  for (int corner = 0; corner < 8; corner++) {
+    int rIx = index[0] + (corner & 1);
+    int gIx = index[1] + ((corner >> 1) & 1);
+    int bIx = index[2] + ((corner >> 2) & 1);
+    float weight = ((corner & 1) ? frac[0] : 1.0f - frac[0]) *
+                   (((corner >> 1) & 1) ? frac[1] : 1.0f - frac[1]) *
+                   (((corner >> 2) & 1) ? frac[2] : 1.0f - frac[2]);
+    result += gradeEntry(rIx, gIx, bIx) * weight;
+  }
+  return result;
+}
+
+QVector3D
+ColourLut::gradeEntry(int rIx, int gIx, int bIx) const
+{
+  return m_grade[(bIx * m_gradeSize + gIx) * m_gradeSize + rIx];
+}
@@ -0,0 +1,108 @@
+#ifndef COLOURLUT_H
+#define COLOURLUT_H
+
+#include <QGLContext>
+#include <QGLShaderProgram>
+#include <QVector4D>
+#include <QVector>
+#include <QList>
+#include <QString>
+
+#include "yuvcolourmatrix.h"
+#include "renderstats.h"
+#include "glextfunctions.h"
+
+// Entries along each side of the LUT. 33 is what grading tools tend to
+// export, and keeps each LUT at 140KB.
+#define COLOURLUT_SIZE                       33
+// Unit the LUT is bound to while a vid using it is drawn. The alpha mask
+// uses the same one, but never with a LUT.
+#define COLOURLUT_TEXTURE_UNIT               1
+// Biggest LUT_3D_SIZE taken from .cube files
+#define COLOURLUT_MAX_CUBE_SIZE              256
+
+// Colour effects which can be baked in, as colourhilight.frag and
+// colourhilightswap.frag do them
+typedef enum _ColourLutEffect
+{
+  ColourLutNoEffect,
+  ColourLutHilight,
+  ColourLutHilightSwap
+} ColourLutEffect;
+
+typedef struct _ColourLutParams
+{
+  QVector4D hilightMin;
+  QVector4D hilightMax;
+  QVector4D swapR;
+  QVector4D swapG;
+  QVector4D swapB;
+} ColourLutParams;
+
+// Bakes YUV to RGB conversion, the colour effects and an optional grading
+// LUT from a .cube file into one 3D texture indexed by YUV, so the fragment
+// shader does a single lookup instead of the conversion sums and effect
+// tests. The vid's conversion shader is left passing YUV straight through.
+//
+// There's a LUT for each colorimetry and effect in use, each rebaked on the
+// CPU only when the effect parameters it was baked with change.
+//
+// Needs 3D textures, which GL 1.2 and up have.
+class ColourLut
+{
+public:
+  ColourLut();
+  ~ColourLut();
+
+  // Context must be current. Returns false if there are no 3D textures,
+  // in which case vids are converted and have effects applied as before.
+  bool Init(const QGLContext *context, int size);
+  bool IsAvailable() const { return m_available; }
+  // Context must be current. Deletes every LUT texture.
+  void Cleanup();
+
+  // Grading applied after conversion and effects, in the .cube format's
+  // RGB 0..1 domain. Returns false if the file can't be read or parsed.
+  bool LoadCubeFile(const QString &fileName);
+  bool HasGrade() const { return m_gradeSize > 0; }
+
+  // LUT texture for frames with these conversion coefficients and effect,
+  // baked first if it's new or the parameters have changed. Binds it to the
+  // current texture unit.
+  GLuint Bind(const YuvToRgbCoeffs &coeffs, ColourLutEffect effect, const ColourLutParams &params);
+  // Uniforms of colourlut.frag, prog must be bound
+  void SetUniforms(QGLShaderProgram *prog);
+
+  void ReportStats(RenderStats &stats) const;
+
+private:
+  typedef struct _LutEntry
+  {
+    YuvToRgbCoeffs coeffs;
+    ColourLutEffect effect;
+    GLuint texId;
+    bool baked;
+    ColourLutParams bakedParams;
+  } LutEntry;
+
+  bool paramsChanged(const LutEntry &entry, const ColourLutParams &params) const;
+  void bake(LutEntry &entry, const ColourLutParams &params);
+  QVector3D applyEffect(const QVector3D &rgb, ColourLutEffect effect, const ColourLutParams &params) const;
+  QVector3D applyGrade(const QVector3D &rgb) const;
+  QVector3D gradeEntry(int rIx, int gIx, int bIx) const;
+
+  bool m_available;
+  int m_size;
+  QList<LutEntry> m_luts;
+  qint64 m_bakes;
+
+  // Loaded .cube, red changing fastest
+  int m_gradeSize;
+  QVector<QVector3D> m_grade;
+  QVector3D m_gradeDomainMin;
+  QVector3D m_gradeDomainMax;
+
+  GLExtFunctions m_glExt;
+};
+
+#endif // COLOURLUT_H
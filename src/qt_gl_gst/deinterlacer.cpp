@@ -0,0 +1,212 @@
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include "deinterlacer.h"
+#include "glwidget.h"
+#include "applogger.h"
+
+// Whole target in clip space, as a triangle strip
+static const GLfloat DeinterlaceQuadVertices[] =
+{
+  -1.0f, -1.0f,
+   1.0f, -1.0f,
+  -1.0f,  1.0f,
+   1.0f,  1.0f
+};
+
+Deinterlacer::Deinterlacer(GLenum target, TexturePool *texturePool) :
+  m_target(target), m_texturePool(texturePool), m_available(false), m_mode(DeinterlaceOff),
+  m_program(NULL), m_framesDone(0)
+{
+}
+
+Deinterlacer::~Deinterlacer()
+{
+}
+
+void
+Deinterlacer::Cleanup()
+{
+  QList<int> vidIxs = m_vids.keys();
+  for (int keyIx = 0; keyIx < vidIxs.size(); keyIx++) {
+    RemoveVid(vidIxs[keyIx]);
+  }
+}
+
+bool
+Deinterlacer::Init(QGLShaderProgram *program, DeinterlaceMode mode)
+{
+  if (mode == DeinterlaceOff) {
+    return false;
+  }
+
+#ifndef RECTTEX_EXT_NEEDED
+  Q_UNUSED(program);
+  LOG(LOG_GL, Logger::Info, "Deinterlacing needs rectangle textures, interlaced frames shown as they are");
+  return false;
+#else
+  if (!QGLFramebufferObject::hasOpenGLFramebufferObjects() || !program->isLinked()) {
+    LOG(LOG_GL, Logger::Info, "No FBO support, interlaced frames shown as they are");
+    return false;
+  }
+
+  program->bind();
+  program->setUniformValue("u_frameTexture", 0);
+  program->setUniformValue("u_prevTexture", 1);
+  program->setUniformValue("u_motionLow", DEINTERLACE_MOTION_LOW);
+  program->setUniformValue("u_motionHigh", DEINTERLACE_MOTION_HIGH);
+  program->release();
+
+  m_program = program;
+  m_mode = mode;
+  m_available = true;
+  return true;
+#endif
+}
+
+GLuint
+Deinterlacer::Process(int vidIx, GLuint &frameTexId, ColFormat colFormat, int width, int height,
+                      int texWidth, int texHeight, bool topFieldFirst)
+{
+  GLfloat format;
+  switch (colFormat) {
+  case ColFmt_I420:
+    format = 0.0f;
+    break;
+  case ColFmt_NV12:
+    format = 1.0f;
+    break;
+  case ColFmt_UYVY:
+    format = 2.0f;
+    break;
+  default:
+    return 0;
+  }
+
+  if (!m_available || (frameTexId == 0)) {
+    return 0;
+  }
+
+  if (m_vids.contains(vidIx) &&
+      ((m_vids[vidIx].texWidth != texWidth) || (m_vids[vidIx].texHeight != texHeight))) {
+    RemoveVid(vidIx);
+  }
+
+  if (!m_vids.contains(vidIx)) {
+    VidFields fields;
+    fields.fbo = new QGLFramebufferObject(texWidth, texHeight, QGLFramebufferObject::NoAttachment, m_target, GL_R8);
+    fields.prevTexId = 0;
+    fields.texWidth = texWidth;
+    fields.texHeight = texHeight;
+    if (!fields.fbo->isValid()) {
+      LOG(LOG_GL, Logger::Warning, "Couldn't make %dx%d deinterlace target, vid %d shown interlaced",
+          texWidth, texHeight, vidIx);
+      delete fields.fbo;
+      return 0;
+    }
+    m_vids.insert(vidIx, fields);
+  }
+
+  VidFields &fields = m_vids[vidIx];
+  QOpenGLFunctions *glFuncs = QOpenGLContext::currentContext()->functions();
+
+  // Everything the pass changes goes back as it was
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  GLboolean blend = glIsEnabled(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+
+  fields.fbo->bind();
+  glViewport(0, 0, texWidth, texHeight);
+
+  // No previous frame yet, so nothing to tell motion from
+  DeinterlaceMode mode = m_mode;
+  if ((mode == DeinterlaceAdaptive) && (fields.prevTexId == 0)) {
+    mode = DeinterlaceLinear;
+  }
+
+  glFuncs->glActiveTexture(GL_TEXTURE1);
+  glBindTexture(m_target, fields.prevTexId);
+  glFuncs->glActiveTexture(GL_TEXTURE0);
+  glBindTexture(m_target, frameTexId);
+
+  m_program->bind();
+  m_program->setUniformValue("u_yWidth", (GLfloat)width);
+  m_program->setUniformValue("u_yHeight", (GLfloat)height);
+  m_program->setUniformValue("u_format", format);
+  m_program->setUniformValue("u_mode", (GLfloat)(mode - DeinterlaceBob));
+  m_program->setUniformValue("u_keepParity", topFieldFirst ? 0.0f : 1.0f);
+
+  glFuncs->glVertexAttribPointer(VID_ATTRIB_VERTEX, 2, GL_FLOAT, GL_FALSE, 0, DeinterlaceQuadVertices);
+  glFuncs->glEnableVertexAttribArray(VID_ATTRIB_VERTEX);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glFuncs->glDisableVertexAttribArray(VID_ATTRIB_VERTEX);
+
+  m_program->release();
+  fields.fbo->release();
+
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (depthTest) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  if (blend) {
+    glEnable(GL_BLEND);
+  }
+
+  // This frame is the next one's previous, and the old previous gets the
+  // next upload
+  if (m_mode == DeinterlaceAdaptive) {
+    GLuint nextTexId = fields.prevTexId;
+    fields.prevTexId = frameTexId;
+    frameTexId = nextTexId;
+  }
+
+  m_framesDone++;
+  return fields.fbo->texture();
+}
+
+void
+Deinterlacer::RemoveVid(int vidIx)
+{
+  if (!m_vids.contains(vidIx)) {
+    return;
+  }
+
+  VidFields fields = m_vids.take(vidIx);
+  delete fields.fbo;
+  m_texturePool->Release(fields.prevTexId);
+}
+
+void
+Deinterlacer::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("deinterlaced_frames", m_framesDone);
+}
+
+bool
+Deinterlacer::ParseMode(const QString &name, DeinterlaceMode &mode)
+{
+  if (name == "off") {
+    mode = DeinterlaceOff;
+  }
+  else if (name == "bob") {
+    mode = DeinterlaceBob;
+  }
+  else if (name == "linear") {
+    mode = DeinterlaceLinear;
+  }
+  else if (name == "adaptive") {
+    mode = DeinterlaceAdaptive;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+const char *
+Deinterlacer::ModeNames()
+{
+  return "off, bob, linear or adaptive";
+}
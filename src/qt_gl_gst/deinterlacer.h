@@ -0,0 +1,85 @@
+#ifndef DEINTERLACER_H
+#define DEINTERLACER_H
+
+#include <QGLContext>
+#include <QGLShaderProgram>
+#include <QGLFramebufferObject>
+#include <QString>
+#include <QMap>
+
+#include "pipeline.h"
+#include "texturepool.h"
+#include "renderstats.h"
+#include "glextfunctions.h"
+
+// Motion adaptive weaves where the missing field changed by less than the
+// low threshold since the previous frame, interpolates above the high one
+// and blends in between. 0..1 texel values.
+#define DEINTERLACE_MOTION_LOW               (6.0f / 255.0f)
+#define DEINTERLACE_MOTION_HIGH              (18.0f / 255.0f)
+
+typedef enum _DeinterlaceMode
+{
+  DeinterlaceOff,
+  DeinterlaceBob,
+  DeinterlaceLinear,
+  DeinterlaceAdaptive
+} DeinterlaceMode;
+
+// Deinterlaces uploaded frames on the GPU with a pass into a texture of
+// the same size and layout, which is then drawn in place of the uploaded
+// one. Output is at the frame rate, keeping the first field and rebuilding
+// the other's lines, so there's no field rate doubling.
+//
+// Motion adaptive keeps the previous frame's uploaded texture by swapping
+// it for the new one, rather than copying.
+//
+// Needs FBOs, GL_R8 render targets and rectangle textures.
+class Deinterlacer
+{
+public:
+  Deinterlacer(GLenum target, TexturePool *texturePool);
+  ~Deinterlacer();
+
+  // Context must be current and program linked from the deinterlace shader
+  // list. Returns false if frames can't be deinterlaced here.
+  bool Init(QGLShaderProgram *program, DeinterlaceMode mode);
+  bool IsAvailable() const { return m_available; }
+
+  // Renderer's context must be current. Deinterlaces the frame just
+  // uploaded into frameTexId, of texWidth x texHeight in the vid texture
+  // layout, and returns the texture to draw it with, or 0 if it couldn't be.
+  // frameTexId may be swapped for another pool texture of the same size, or
+  // 0 to get a new one, to upload the next frame into.
+  GLuint Process(int vidIx, GLuint &frameTexId, ColFormat colFormat, int width, int height,
+                 int texWidth, int texHeight, bool topFieldFirst);
+  // Vid's textures go back to the pool, e.g. when its size changes
+  void RemoveVid(int vidIx);
+  // Context must be current. Removes every vid, before the pool goes.
+  void Cleanup();
+
+  void ReportStats(RenderStats &stats) const;
+
+  static bool ParseMode(const QString &name, DeinterlaceMode &mode);
+  static const char *ModeNames();
+
+private:
+  typedef struct _VidFields
+  {
+    QGLFramebufferObject *fbo;
+    // Previous frame's upload, motion adaptive only
+    GLuint prevTexId;
+    int texWidth;
+    int texHeight;
+  } VidFields;
+
+  GLenum m_target;
+  TexturePool *m_texturePool;
+  bool m_available;
+  DeinterlaceMode m_mode;
+  QGLShaderProgram *m_program;
+  QMap<int, VidFields> m_vids;
+  qint64 m_framesDone;
+};
+
+#endif // DEINTERLACER_H
@@ -0,0 +1,167 @@
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#ifdef EGL_DMABUF_IMPORT
+ #include <gst/allocators/gstdmabuf.h>
+#endif
+#include "dmabufimporter.h"
+#include "applogger.h"
+
+DmaBufImporter::DmaBufImporter() :
+  m_available(false), m_importTexId(0),
+#ifdef EGL_DMABUF_IMPORT
+  m_display(EGL_NO_DISPLAY), m_eglCreateImage(NULL), m_eglDestroyImage(NULL),
+#endif
+  m_glEGLImageTargetTexture2D(NULL), m_glCopyImageSubData(NULL)
+{
+}
+
+DmaBufImporter::~DmaBufImporter()
+{
+}
+
+void
+DmaBufImporter::Cleanup()
+{
+  if (m_available) {
+    glDeleteTextures(1, &m_importTexId);
+    m_importTexId = 0;
+    m_available = false;
+  }
+}
+
+bool
+DmaBufImporter::Init(const QGLContext *context)
+{
+#ifndef EGL_DMABUF_IMPORT
+  Q_UNUSED(context);
+  LOG(LOG_GL, Logger::Info, "Built without dmabuf import, frames will be copied");
+  return false;
+#else
+  // Under GLX there's no EGL display to import with
+  m_display = eglGetCurrentDisplay();
+  if (m_display == EGL_NO_DISPLAY) {
+    LOG(LOG_GL, Logger::Info, "GL context isn't EGL based, frames will be copied");
+    return false;
+  }
+
+  const char *eglExtensions = eglQueryString(m_display, EGL_EXTENSIONS);
+  const char *glExtensions = (const char *)glGetString(GL_EXTENSIONS);
+  if ((eglExtensions == NULL) || (glExtensions == NULL)) {
+    LOG(LOG_GL, Logger::Warning, "Can't get EGL/GL extensions, frames will be copied");
+    return false;
+  }
+
+  if (!strstr(eglExtensions, "EGL_EXT_image_dma_buf_import") ||
+      !strstr(glExtensions, "GL_OES_EGL_image") ||
+      !strstr(glExtensions, "GL_ARB_copy_image") ||
+      !strstr(glExtensions, "GL_ARB_texture_rg")) {
+    LOG(LOG_GL, Logger::Info, "No dmabuf import support, frames will be copied");
+    return false;
+  }
+
+  m_eglCreateImage = (DmaBufCreateImageProc)eglGetProcAddress("eglCreateImageKHR");
+  m_eglDestroyImage = (DmaBufDestroyImageProc)eglGetProcAddress("eglDestroyImageKHR");
+  m_glEGLImageTargetTexture2D = (DmaBufImageTargetTextureProc)context->getProcAddress("glEGLImageTargetTexture2DOES");
+  m_glCopyImageSubData = (DmaBufCopyImageSubDataProc)context->getProcAddress("glCopyImageSubData");
+
+  if (!m_eglCreateImage || !m_eglDestroyImage || !m_glEGLImageTargetTexture2D || !m_glCopyImageSubData) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't get dmabuf import functions, frames will be copied");
+    return false;
+  }
+
+  // Each frame's image is bound to this in turn, then copied out
+  glGenTextures(1, &m_importTexId);
+  glBindTexture(GL_TEXTURE_2D, m_importTexId);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  LOG(LOG_GL, Logger::Info, "dmabuf frames will be imported without copying on the CPU");
+  m_available = true;
+  return true;
+#endif
+}
+
+bool
+DmaBufImporter::CanImport(void *buf)
+{
+#ifdef EGL_DMABUF_IMPORT
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  return m_available && (gstBuf != NULL) && (gst_buffer_n_memory(gstBuf) == 1) &&
+         gst_is_dmabuf_memory(gst_buffer_peek_memory(gstBuf, 0));
+#else
+  Q_UNUSED(buf);
+  return false;
+#endif
+}
+
+bool
+DmaBufImporter::Import(void *buf, GLuint destTexId, GLenum destTarget, int texWidth, int texHeight)
+{
+#ifndef EGL_DMABUF_IMPORT
+  Q_UNUSED(buf);
+  Q_UNUSED(destTexId);
+  Q_UNUSED(destTarget);
+  Q_UNUSED(texWidth);
+  Q_UNUSED(texHeight);
+  return false;
+#else
+  if (!CanImport(buf)) {
+    return false;
+  }
+
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if (gst_buffer_get_size(gstBuf) < (gsize)texWidth * texHeight) {
+    return false;
+  }
+
+  // Planes have to be packed one after the other the way the copy path
+  // expects, decoders padding them out can't go in as one image
+  GstVideoMeta *meta = gst_buffer_get_video_meta(gstBuf);
+  if (meta) {
+    GstVideoInfo packedInfo;
+    gst_video_info_set_format(&packedInfo, meta->format, meta->width, meta->height);
+    for (guint planeIx = 0; planeIx < meta->n_planes; planeIx++) {
+      if ((meta->offset[planeIx] != GST_VIDEO_INFO_PLANE_OFFSET(&packedInfo, planeIx)) ||
+          (meta->stride[planeIx] != GST_VIDEO_INFO_PLANE_STRIDE(&packedInfo, planeIx))) {
+        LOG(LOG_GL, Logger::Debug1, "dmabuf plane %u isn't packed, can't import", planeIx);
+        return false;
+      }
+    }
+  }
+
+  GstMemory *mem = gst_buffer_peek_memory(gstBuf, 0);
+  gsize memOffset;
+  gst_memory_get_sizes(mem, &memOffset, NULL);
+
+  EGLint attribs[] = {
+    EGL_WIDTH, texWidth,
+    EGL_HEIGHT, texHeight,
+    EGL_LINUX_DRM_FOURCC_EXT, DMABUF_DRM_FORMAT_R8,
+    EGL_DMA_BUF_PLANE0_FD_EXT, gst_dmabuf_memory_get_fd(mem),
+    EGL_DMA_BUF_PLANE0_OFFSET_EXT, (EGLint)memOffset,
+    EGL_DMA_BUF_PLANE0_PITCH_EXT, texWidth,
+    EGL_NONE
+  };
+
+  DmaBufEGLImage image = m_eglCreateImage(m_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+  if (image == NULL) {
+    LOG(LOG_GL, Logger::Debug1, "eglCreateImage failed for dmabuf, error 0x%x", eglGetError());
+    return false;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, m_importTexId);
+  m_glEGLImageTargetTexture2D(GL_TEXTURE_2D, image);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  m_glCopyImageSubData(m_importTexId, GL_TEXTURE_2D, 0, 0, 0, 0,
+                       destTexId, destTarget, 0, 0, 0, 0,
+                       texWidth, texHeight, 1);
+
+  // Import texture keeps the storage referenced until it's next respecified
+  m_eglDestroyImage(m_display, image);
+
+  return true;
+#endif
+}
@@ -0,0 +1,92 @@
+#ifndef DMABUFIMPORTER_H
+#define DMABUFIMPORTER_H
+
+#include <QGLContext>
+
+#ifdef EGL_DMABUF_IMPORT
+ #include <EGL/egl.h>
+ #include <EGL/eglext.h>
+#endif
+
+// Not all GL/EGL headers have these
+#ifndef GL_RED
+ #define GL_RED                              0x1903
+#endif
+#ifndef GL_R8
+ #define GL_R8                               0x8229
+#endif
+#ifndef APIENTRY
+ #define APIENTRY
+#endif
+
+#ifdef EGL_DMABUF_IMPORT
+ #ifndef EGL_LINUX_DMA_BUF_EXT
+  #define EGL_LINUX_DMA_BUF_EXT              0x3270
+  #define EGL_LINUX_DRM_FOURCC_EXT           0x3271
+  #define EGL_DMA_BUF_PLANE0_FD_EXT          0x3272
+  #define EGL_DMA_BUF_PLANE0_OFFSET_EXT      0x3273
+  #define EGL_DMA_BUF_PLANE0_PITCH_EXT       0x3274
+ #endif
+
+typedef void *DmaBufEGLImage;
+typedef DmaBufEGLImage (EGLAPIENTRY *DmaBufCreateImageProc)(EGLDisplay dpy, EGLContext ctx, EGLenum target,
+                                                            EGLClientBuffer buffer, const EGLint *attribList);
+typedef EGLBoolean (EGLAPIENTRY *DmaBufDestroyImageProc)(EGLDisplay dpy, DmaBufEGLImage image);
+#endif
+
+typedef void (APIENTRY *DmaBufImageTargetTextureProc)(GLenum target, void *image);
+typedef void (APIENTRY *DmaBufCopyImageSubDataProc)(GLuint srcName, GLenum srcTarget, GLint srcLevel,
+                                                    GLint srcX, GLint srcY, GLint srcZ,
+                                                    GLuint dstName, GLenum dstTarget, GLint dstLevel,
+                                                    GLint dstX, GLint dstY, GLint dstZ,
+                                                    GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+
+// DRM_FORMAT_R8, the frame goes in as one 8 bit plane
+#define DMABUF_DRM_FORMAT_R8                 0x20203852
+
+// Gets frames which are in dmabuf memory, e.g. from V4L2 or VA-API
+// decoders, into video textures without mapping them on the CPU. Each
+// frame's dmabuf is imported as an EGLImage with EGL_EXT_image_dma_buf_import
+// then copied on the GPU into the vid's texture, as rectangle and stream
+// textures can't be EGLImage targets themselves.
+//
+// Frames are imported whole as a single channel image, the same layout the
+// copy path uploads, so the conversion shaders don't change. Destination
+// textures must be GL_R8 to be copy compatible.
+//
+// Needs an EGL based GL context, OES_EGL_image, ARB_copy_image and
+// ARB_texture_rg, and a build with EGL_DMABUF_IMPORT defined.
+class DmaBufImporter
+{
+public:
+  DmaBufImporter();
+  ~DmaBufImporter();
+
+  // Context must be current. Returns false if frames can't be imported,
+  // in which case they should be copied as before.
+  bool Init(const QGLContext *context);
+  bool IsAvailable() const { return m_available; }
+  // Context must be current. Unavailable after this.
+  void Cleanup();
+
+  // Cheap check of whether the buffer is a single dmabuf
+  bool CanImport(void *buf);
+  // Import the frame into destTexId, which must be texWidth x texHeight
+  // GL_R8. Returns false if it couldn't be, so it should be copied instead.
+  // The buffer must be kept until the GPU has done the copy.
+  bool Import(void *buf, GLuint destTexId, GLenum destTarget, int texWidth, int texHeight);
+
+private:
+  bool m_available;
+  GLuint m_importTexId;
+
+#ifdef EGL_DMABUF_IMPORT
+  EGLDisplay m_display;
+  DmaBufCreateImageProc m_eglCreateImage;
+  DmaBufDestroyImageProc m_eglDestroyImage;
+#endif
+  DmaBufImageTargetTextureProc m_glEGLImageTargetTexture2D;
+  DmaBufCopyImageSubDataProc m_glCopyImageSubData;
+};
+
+#endif // DMABUFIMPORTER_H
@@ -0,0 +1,199 @@
+#include "effectchain.h"
+
+EffectChain::EffectChain()
+{
+}
+
+bool
+EffectChain::Parse(const QString &chainDesc)
+{
+  QStringList names = chainDesc.split(',', QString::SkipEmptyParts);
+  if (names.isEmpty() || (names.size() > EFFECTCHAIN_MAX_PASSES)) {
+    return false;
+  }
+
+  QList<QList<EffectPassType> > stages;
+  stages.append(QList<EffectPassType>());
+
+  for (int nameIx = 0; nameIx < names.size(); nameIx++) {
+    EffectPassType pass;
+    if (!parsePassName(names[nameIx].trimmed(), pass)) {
+      return false;
+    }
+
+    // Whatever came before has to be in a texture to be sampled around,
+    // even if that's just the converted frame
+    if (IsNeighbourhoodPass(pass)) {
+      stages.append(QList<EffectPassType>());
+    }
+    stages.last().append(pass);
+  }
+
+  m_stages = stages;
+  return true;
+}
+
+QString
+EffectChain::Description() const
+{
+  QStringList names;
+  for (int stageIx = 0; stageIx < m_stages.size(); stageIx++) {
+    for (int passIx = 0; passIx < m_stages[stageIx].size(); passIx++) {
+      names.append(passName(m_stages[stageIx][passIx]));
+    }
+  }
+  return names.join(",");
+}
+
+bool
+EffectChain::UsesAlphaMask() const
+{
+  for (int stageIx = 0; stageIx < m_stages.size(); stageIx++) {
+    if (StageUsesAlphaMask(stageIx)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QStringList
+EffectChain::StageSourceFiles(int stageIx, const QString &texSuffix) const
+{
+  QStringList fileNames;
+
+  for (int passIx = 0; passIx < m_stages[stageIx].size(); passIx++) {
+    QString fileName;
+    switch (m_stages[stageIx][passIx]) {
+    case EffectPassColour:
+    case EffectPassColourSwap:
+      fileName = "shaders/pass-colour.frag";
+      break;
+    case EffectPassAlphaMask:
+      // Only rectangle textures sample differently, imgstream masks are
+      // plain 2D textures like any other
+      if (texSuffix == "-recttex") {
+        fileName = "shaders/pass-alphamask-recttex.frag";
+      }
+      else {
+        fileName = "shaders/pass-alphamask.frag";
+      }
+      break;
+    case EffectPassBlur:
+      fileName = "shaders/pass-blur.frag";
+      break;
+    case EffectPassSharpen:
+      fileName = "shaders/pass-sharpen.frag";
+      break;
+    }
+
+    if (!fileNames.contains(fileName)) {
+      fileNames.append(fileName);
+    }
+  }
+
+  return fileNames;
+}
+
+QString
+EffectChain::StageMainSource(int stageIx) const
+{
+  const QList<EffectPassType> &passes = m_stages[stageIx];
+  QString source = "\nvoid main(void)\n{\n";
+  int passIx = 0;
+
+  // Neighbourhood passes only ever start a stage, and make the colour
+  // rather than take it
+  if ((passes.size() > 0) && IsNeighbourhoodPass(passes[0])) {
+    source += QString("\tmediump vec4 colour = %1Pass();\n").arg(passName(passes[0]));
+    passIx++;
+  }
+  else {
+    source += "\tmediump vec4 colour = yuv2rgb();\n";
+  }
+
+  for (; passIx < passes.size(); passIx++) {
+    switch (passes[passIx]) {
+    case EffectPassColour:
+      source += "\tcolour = colourPass(colour);\n";
+      break;
+    case EffectPassColourSwap:
+      source += "\tcolour = colourSwapPass(colour);\n";
+      break;
+    case EffectPassAlphaMask:
+      source += "\tcolour = alphaMaskPass(colour);\n";
+      break;
+    default:
+      break;
+    }
+  }
+
+  source += "\tgl_FragColor = colour;\n}\n";
+  return source;
+}
+
+QString
+EffectChain::StageKey(int stageIx) const
+{
+  QStringList names;
+  if (stageIx == 0) {
+    names.append("yuv2rgb");
+  }
+  for (int passIx = 0; passIx < m_stages[stageIx].size(); passIx++) {
+    names.append(passName(m_stages[stageIx][passIx]));
+  }
+  return names.join(",");
+}
+
+bool
+EffectChain::IsNeighbourhoodPass(EffectPassType pass)
+{
+  return (pass == EffectPassBlur) || (pass == EffectPassSharpen);
+}
+
+const char *
+EffectChain::PassNames()
+{
+  return "colour, colourswap, alphamask, blur or sharpen";
+}
+
+bool
+EffectChain::parsePassName(const QString &name, EffectPassType &pass)
+{
+  if (name == "colour") {
+    pass = EffectPassColour;
+  }
+  else if (name == "colourswap") {
+    pass = EffectPassColourSwap;
+  }
+  else if (name == "alphamask") {
+    pass = EffectPassAlphaMask;
+  }
+  else if (name == "blur") {
+    pass = EffectPassBlur;
+  }
+  else if (name == "sharpen") {
+    pass = EffectPassSharpen;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+const char *
+EffectChain::passName(EffectPassType pass)
+{
+  switch (pass) {
+  case EffectPassColour:
+    return "colour";
+  case EffectPassColourSwap:
+    return "colourswap";
+  case EffectPassAlphaMask:
+    return "alphamask";
+  case EffectPassBlur:
+    return "blur";
+  case EffectPassSharpen:
+    return "sharpen";
+  }
+  return "";
+}
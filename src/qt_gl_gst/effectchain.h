@@ -0,0 +1,64 @@
+#ifndef EFFECTCHAIN_H
+#define EFFECTCHAIN_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+// Most passes in one vid's chain
+#define EFFECTCHAIN_MAX_PASSES               8
+
+typedef enum _EffectPassType
+{
+  EffectPassColour,
+  EffectPassColourSwap,
+  EffectPassAlphaMask,
+  EffectPassBlur,
+  EffectPassSharpen
+} EffectPassType;
+
+// Chain of post processing passes applied to a vid, given as a comma
+// separated list of pass names, e.g. "colour,blur,alphamask".
+//
+// Per pixel passes (colour, colourswap, alphamask) only need the fragment
+// they're working on, so runs of them are fused into one shader, calling
+// each pass in turn. Neighbourhood passes (blur, sharpen) sample around the
+// fragment, so the chain is cut into stages at each one: the stage before
+// renders into an FBO, and the stage starting with the neighbourhood pass
+// samples that. The first stage converts the frame, the last one draws the
+// tile, so a chain without neighbourhood passes needs no FBOs at all.
+class EffectChain
+{
+public:
+  EffectChain();
+
+  // Returns false, leaving the chain as it was, if a pass name isn't known
+  bool Parse(const QString &chainDesc);
+  bool IsEmpty() const { return m_stages.isEmpty(); }
+  QString Description() const;
+
+  int NumStages() const { return m_stages.size(); }
+  const QList<EffectPassType> &StagePasses(int stageIx) const { return m_stages[stageIx]; }
+  bool StageUsesAlphaMask(int stageIx) const { return m_stages[stageIx].contains(EffectPassAlphaMask); }
+  bool UsesAlphaMask() const;
+
+  // Fragment shader files the stage's passes are in, each once. The first
+  // stage's are linked after a yuv2rgb conversion shader. texSuffix is the
+  // alpha mask texture type's, as VIDCONV_FRAG_SHADER_SUFFIX.
+  QStringList StageSourceFiles(int stageIx, const QString &texSuffix) const;
+  // main() calling the stage's passes in order
+  QString StageMainSource(int stageIx) const;
+  // Same for stages any vid could share a program for
+  QString StageKey(int stageIx) const;
+
+  static bool IsNeighbourhoodPass(EffectPassType pass);
+  static const char *PassNames();
+
+private:
+  static bool parsePassName(const QString &name, EffectPassType &pass);
+  static const char *passName(EffectPassType pass);
+
+  QList<QList<EffectPassType> > m_stages;
+};
+
+#endif // EFFECTCHAIN_H
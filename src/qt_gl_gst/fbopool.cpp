@@ -0,0 +1,78 @@
+#include "fbopool.h"
+#include "applogger.h"
+
+FboPool::FboPool() :
+  m_acquires(0), m_created(0), m_lastAcquireFailed(false)
+{
+}
+
+FboPool::~FboPool()
+{
+}
+
+void
+FboPool::Cleanup()
+{
+  qDeleteAll(m_inUse);
+  qDeleteAll(m_free);
+  m_inUse.clear();
+  m_free.clear();
+}
+
+QGLFramebufferObject *
+FboPool::Acquire(const QSize &size)
+{
+  m_acquires++;
+
+  for (int freeIx = 0; freeIx < m_free.size(); freeIx++) {
+    if (m_free[freeIx]->size() == size) {
+      QGLFramebufferObject *fbo = m_free.takeAt(freeIx);
+      m_inUse.append(fbo);
+      return fbo;
+    }
+  }
+
+  QGLFramebufferObject *fbo = new QGLFramebufferObject(size, QGLFramebufferObject::NoAttachment, GL_TEXTURE_2D);
+  if (!fbo->isValid()) {
+    if (!m_lastAcquireFailed) {
+      LOG(LOG_GL, Logger::Warning, "Couldn't make %dx%d effect chain target", size.width(), size.height());
+    }
+    m_lastAcquireFailed = true;
+    delete fbo;
+    return NULL;
+  }
+  m_lastAcquireFailed = false;
+
+  // Next stage samples around each texel, and the last one is scaled onto
+  // the tile
+  glBindTexture(GL_TEXTURE_2D, fbo->texture());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  m_created++;
+  m_inUse.append(fbo);
+
+  LOG(LOG_GL, Logger::Debug1, "New %dx%d effect chain FBO, %d in pool",
+      size.width(), size.height(), m_inUse.size() + m_free.size());
+
+  return fbo;
+}
+
+void
+FboPool::Release(QGLFramebufferObject *fbo)
+{
+  if (m_inUse.removeOne(fbo)) {
+    m_free.append(fbo);
+  }
+}
+
+void
+FboPool::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("fbopool_fbos", m_inUse.size() + m_free.size());
+  stats.SetCounter("fbopool_created", m_created);
+  stats.SetCounter("fbopool_acquires", m_acquires);
+}
@@ -0,0 +1,39 @@
+#ifndef FBOPOOL_H
+#define FBOPOOL_H
+
+#include <QGLContext>
+#include <QGLFramebufferObject>
+#include <QList>
+#include <QSize>
+
+#include "renderstats.h"
+
+// Hands out RGBA render targets for the effect chain stages, keyed by size.
+// They're only held while a vid's chain is being drawn, so vids drawn one
+// after the other with the same size share the same few FBOs, and a chain
+// of stages ping-pongs between two.
+class FboPool
+{
+public:
+  FboPool();
+  ~FboPool();
+
+  // Context must be current. Returns NULL if an FBO of this size can't be
+  // made.
+  QGLFramebufferObject *Acquire(const QSize &size);
+  void Release(QGLFramebufferObject *fbo);
+  // Context must be current. Deletes every FBO, held or not.
+  void Cleanup();
+
+  // FBO count and reuse as counters named fbopool_*
+  void ReportStats(RenderStats &stats) const;
+
+private:
+  QList<QGLFramebufferObject *> m_inUse;
+  QList<QGLFramebufferObject *> m_free;
+  qint64 m_acquires;
+  qint64 m_created;
+  bool m_lastAcquireFailed;
+};
+
+#endif // FBOPOOL_H
@@ -0,0 +1,164 @@
+#include "framegrabtask.h"
+#include "applogger.h"
+
+FrameGrabTask::FrameGrabTask(int grabId, GstBuffer *buf, const QSize &size, const QString &fileName) :
+  m_grabId(grabId), m_buf(buf), m_size(size), m_isReadback(true), m_colFormat(ColFmt_Unknown),
+  m_fileName(fileName)
+{
+  m_colorimetry.matrix = ColMatrix_Unknown;
+  m_colorimetry.fullRange = false;
+}
+
+FrameGrabTask::FrameGrabTask(int grabId, GstBuffer *buf, const QSize &size, ColFormat colFormat,
+                             const Colorimetry &colorimetry, const QString &fileName) :
+  m_grabId(grabId), m_buf(buf), m_size(size), m_isReadback(false), m_colFormat(colFormat),
+  m_colorimetry(colorimetry), m_fileName(fileName)
+{
+}
+
+FrameGrabTask::~FrameGrabTask()
+{
+  if (m_buf) {
+    gst_buffer_unref(m_buf);
+  }
+}
+
+void
+FrameGrabTask::run()
+{
+  QImage image = m_isReadback ? readbackImage() : videoFrameImage();
+
+  // Decoders and the readback ring can have it back straight away
+  gst_buffer_unref(m_buf);
+  m_buf = NULL;
+
+  if (!image.isNull() && !m_fileName.isEmpty() && !image.save(m_fileName)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't save grabbed frame to %s", m_fileName.toUtf8().constData());
+  }
+
+  emit finished(m_grabId, image);
+}
+
+QImage
+FrameGrabTask::readbackImage()
+{
+  GstMapInfo info;
+  if (!gst_buffer_map(m_buf, &info, GST_MAP_READ)) {
+    return QImage();
+  }
+
+  // mirrored copies, so nothing points into the buffer after it's unmapped.
+  // What's shown is opaque whatever alpha was left in the framebuffer.
+  QImage image = QImage(info.data, m_size.width(), m_size.height(), m_size.width() * 4,
+                        QImage::Format_RGBA8888).mirrored().convertToFormat(QImage::Format_RGB32);
+
+  gst_buffer_unmap(m_buf, &info);
+  return image;
+}
+
+// GStreamer's converter does the YUV formats at whatever stride the decoder
+// used, with the matrix and range the caps gave
+QImage
+FrameGrabTask::videoFrameImage()
+{
+  GstVideoFormat inFormat = gstVideoFormat(m_colFormat);
+  if (inFormat == GST_VIDEO_FORMAT_UNKNOWN) {
+    LOG(LOG_VIDPIPELINE, Logger::Warning, "Can't grab frames in format 0x%x", m_colFormat);
+    return QImage();
+  }
+
+  GstVideoInfo inInfo;
+  gst_video_info_set_format(&inInfo, inFormat, m_size.width(), m_size.height());
+  switch (m_colorimetry.matrix) {
+  case ColMatrix_BT601:
+    inInfo.colorimetry.matrix = GST_VIDEO_COLOR_MATRIX_BT601;
+    break;
+  case ColMatrix_BT709:
+    inInfo.colorimetry.matrix = GST_VIDEO_COLOR_MATRIX_BT709;
+    break;
+  case ColMatrix_BT2020:
+    inInfo.colorimetry.matrix = GST_VIDEO_COLOR_MATRIX_BT2020;
+    break;
+  case ColMatrix_SMPTE240M:
+    inInfo.colorimetry.matrix = GST_VIDEO_COLOR_MATRIX_SMPTE240M;
+    break;
+  case ColMatrix_FCC:
+    inInfo.colorimetry.matrix = GST_VIDEO_COLOR_MATRIX_FCC;
+    break;
+  default:
+    // Left as the default for the format and size
+    break;
+  }
+  if (GST_VIDEO_INFO_IS_YUV(&inInfo)) {
+    inInfo.colorimetry.range = m_colorimetry.fullRange ? GST_VIDEO_COLOR_RANGE_0_255 : GST_VIDEO_COLOR_RANGE_16_235;
+  }
+
+  // Maps with the buffer's video meta where it has one, for the strides
+  GstVideoFrame inFrame;
+  if (!gst_video_frame_map(&inFrame, &inInfo, m_buf, GST_MAP_READ)) {
+    LOG(LOG_VIDPIPELINE, Logger::Warning, "Couldn't map grabbed video frame");
+    return QImage();
+  }
+
+  // Converted straight into the image's pixels
+  QImage image(m_size, QImage::Format_RGBX8888);
+  GstVideoInfo outInfo;
+  gst_video_info_set_format(&outInfo, GST_VIDEO_FORMAT_RGBx, m_size.width(), m_size.height());
+  outInfo.stride[0] = image.bytesPerLine();
+  outInfo.size = (gsize)image.byteCount();
+  GstBuffer *outBuf = gst_buffer_new_wrapped_full((GstMemoryFlags)0, image.bits(), image.byteCount(),
+                                                  0, image.byteCount(), NULL, NULL);
+
+  GstVideoFrame outFrame;
+  bool converted = false;
+  if (gst_video_frame_map(&outFrame, &outInfo, outBuf, GST_MAP_WRITE)) {
+    GstVideoConverter *converter = gst_video_converter_new(&inInfo, &outInfo, NULL);
+    if (converter) {
+      gst_video_converter_frame(converter, &inFrame, &outFrame);
+      gst_video_converter_free(converter);
+      converted = true;
+    }
+    gst_video_frame_unmap(&outFrame);
+  }
+  gst_buffer_unref(outBuf);
+  gst_video_frame_unmap(&inFrame);
+
+  return converted ? image : QImage();
+}
+
+GstVideoFormat
+FrameGrabTask::gstVideoFormat(ColFormat colFormat)
+{
+  switch (colFormat) {
+  case ColFmt_NV12:
+    return GST_VIDEO_FORMAT_NV12;
+  case ColFmt_I420:
+  case ColFmt_IYUV:
+    return GST_VIDEO_FORMAT_I420;
+  case ColFmt_YV12:
+    return GST_VIDEO_FORMAT_YV12;
+  case ColFmt_YUYV:
+  case ColFmt_YUY2:
+  case ColFmt_V422:
+  case ColFmt_YUNV:
+    return GST_VIDEO_FORMAT_YUY2;
+  case ColFmt_UYVY:
+  case ColFmt_Y422:
+  case ColFmt_UYNV:
+    return GST_VIDEO_FORMAT_UYVY;
+  case ColFmt_P010:
+    return GST_VIDEO_FORMAT_P010_10LE;
+  case ColFmt_I420_10LE:
+    return GST_VIDEO_FORMAT_I420_10LE;
+  case ColFmt_RGB888:
+    return GST_VIDEO_FORMAT_RGB;
+  case ColFmt_BGR888:
+    return GST_VIDEO_FORMAT_BGR;
+  case ColFmt_ARGB8888:
+    return GST_VIDEO_FORMAT_RGBA;
+  case ColFmt_BGRA8888:
+    return GST_VIDEO_FORMAT_BGRA;
+  default:
+    return GST_VIDEO_FORMAT_UNKNOWN;
+  }
+}
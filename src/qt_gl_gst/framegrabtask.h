@@ -0,0 +1,52 @@
+#ifndef FRAMEGRABTASK_H
+#define FRAMEGRABTASK_H
+
+#include <QObject>
+#include <QRunnable>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "pipeline.h"
+
+// Turns a grabbed frame into a QImage, and saves it if given a file name,
+// on a thread pool thread so none of it holds up rendering. Composited
+// frames come as read back from GL, video frames as they were decoded.
+class FrameGrabTask : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  // Composited frame, RGBA with the bottom row first. Takes the buffer
+  // reference.
+  FrameGrabTask(int grabId, GstBuffer *buf, const QSize &size, const QString &fileName);
+  // Decoded video frame, takes the buffer reference
+  FrameGrabTask(int grabId, GstBuffer *buf, const QSize &size, ColFormat colFormat,
+                const Colorimetry &colorimetry, const QString &fileName);
+  ~FrameGrabTask();
+
+  void run();
+
+Q_SIGNALS:
+  // Null image if the frame couldn't be converted
+  void finished(int grabId, const QImage &image);
+
+private:
+  QImage readbackImage();
+  QImage videoFrameImage();
+  static GstVideoFormat gstVideoFormat(ColFormat colFormat);
+
+  int m_grabId;
+  GstBuffer *m_buf;
+  QSize m_size;
+  bool m_isReadback;
+  ColFormat m_colFormat;
+  Colorimetry m_colorimetry;
+  // Format is from the extension, .png or .jpg
+  QString m_fileName;
+};
+
+#endif // FRAMEGRABTASK_H
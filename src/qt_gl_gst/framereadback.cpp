@@ -0,0 +1,137 @@
+#include <string.h>
+#include "framereadback.h"
+#include "applogger.h"
+
+FrameReadback::FrameReadback() :
+  m_available(false), m_oldestSlotIx(0), m_numPending(0)
+{
+}
+
+FrameReadback::~FrameReadback()
+{
+}
+
+void
+FrameReadback::Cleanup()
+{
+  if (!m_available) {
+    return;
+  }
+  Clear();
+  for (int slotIx = 0; slotIx < m_slots.size(); slotIx++) {
+    m_glExt.glDeleteBuffers(1, &m_slots[slotIx].pboId);
+  }
+  m_slots.clear();
+  m_available = false;
+}
+
+bool
+FrameReadback::Init(const QGLContext *context, int numBuffers)
+{
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  if (extensions == NULL) {
+    LOG(LOG_GL, Logger::Warning, "Can't get GL extensions, no asynchronous readback");
+    return false;
+  }
+
+  if (!strstr(extensions, "GL_ARB_pixel_buffer_object") || !strstr(extensions, "GL_ARB_sync")) {
+    LOG(LOG_GL, Logger::Info, "No pixel buffer object or sync support, no asynchronous readback");
+    return false;
+  }
+
+  if (!m_glExt.ResolveBuffers(context) || !m_glExt.ResolveSync(context)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't get pixel buffer functions, no asynchronous readback");
+    return false;
+  }
+
+  // Storage is allocated on first use, once the frame size is known
+  m_slots.resize(qMax(numBuffers, 2));
+  for (int slotIx = 0; slotIx < m_slots.size(); slotIx++) {
+    m_glExt.glGenBuffers(1, &m_slots[slotIx].pboId);
+    m_slots[slotIx].bytes = 0;
+    m_slots[slotIx].ptsNs = 0;
+    m_slots[slotIx].fence = NULL;
+  }
+
+  m_available = true;
+  return true;
+}
+
+bool
+FrameReadback::Start(const QSize &size, qint64 ptsNs)
+{
+  if (!m_available || (m_numPending == m_slots.size())) {
+    return false;
+  }
+
+  ReadbackSlot &slot = m_slots[(m_oldestSlotIx + m_numPending) % m_slots.size()];
+  qint64 bytes = (qint64)size.width() * size.height() * 4;
+
+  m_glExt.glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+  if (slot.bytes != bytes) {
+    m_glExt.glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+    slot.bytes = bytes;
+  }
+  // Into the buffer, so this only queues the copy
+  glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  m_glExt.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.size = size;
+  slot.ptsNs = ptsNs;
+  slot.fence = m_glExt.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_numPending++;
+  return true;
+}
+
+GstBuffer *
+FrameReadback::TakeFinished(bool wait, QSize *size)
+{
+  if (m_numPending == 0) {
+    return NULL;
+  }
+
+  ReadbackSlot &slot = m_slots[m_oldestSlotIx];
+
+  GLenum waitRet = m_glExt.glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? READBACK_WAIT_TIMEOUT_NS : 0);
+  if (waitRet == GL_TIMEOUT_EXPIRED) {
+    return NULL;
+  }
+
+  m_glExt.glDeleteSync(slot.fence);
+  slot.fence = NULL;
+  m_oldestSlotIx = (m_oldestSlotIx + 1) % m_slots.size();
+  m_numPending--;
+
+  if (waitRet == GL_WAIT_FAILED) {
+    LOG(LOG_GL, Logger::Warning, "Waiting for frame readback failed, dropping it");
+    return NULL;
+  }
+
+  GstBuffer *buf = NULL;
+  m_glExt.glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+  const void *pixels = m_glExt.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+  if (pixels) {
+    // Buffer has to be unmapped before it's read into again, so copied out
+    buf = gst_buffer_new_allocate(NULL, slot.bytes, NULL);
+    gst_buffer_fill(buf, 0, pixels, slot.bytes);
+    GST_BUFFER_PTS(buf) = slot.ptsNs;
+    m_glExt.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  m_glExt.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (size) {
+    *size = slot.size;
+  }
+  return buf;
+}
+
+void
+FrameReadback::Clear()
+{
+  while (m_numPending > 0) {
+    m_glExt.glDeleteSync(m_slots[m_oldestSlotIx].fence);
+    m_slots[m_oldestSlotIx].fence = NULL;
+    m_oldestSlotIx = (m_oldestSlotIx + 1) % m_slots.size();
+    m_numPending--;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef FRAMEREADBACK_H
+#define FRAMEREADBACK_H
+
+#include <QGLContext>
+#include <QVector>
+#include <QSize>
+
+#include <gst/gst.h>
+
+#include "glextfunctions.h"
+
+// Readbacks in flight at once. The GPU is normally done with a frame by
+// the time the next one is drawn, the rest are slack for when it's behind.
+#define READBACK_DFLT_BUFFERS                3
+// Longest to wait for a readback when told to, e.g. when stopping
+#define READBACK_WAIT_TIMEOUT_NS             (1000 * 1000 * 1000)
+
+// Reads rendered frames back without stalling the renderer. glReadPixels
+// goes into a ring of pixel pack buffers, so it returns straight away and
+// the GPU copies the frame out when it gets to it, then a fence says when
+// it has. Finished frames are only mapped once their fence has passed, a
+// frame or more later, so nothing ever waits on the GPU.
+//
+// Needs ARB_pixel_buffer_object and ARB_sync.
+class FrameReadback
+{
+public:
+  FrameReadback();
+  ~FrameReadback();
+
+  // Context must be current. Returns false if readback can't be done
+  // asynchronously.
+  bool Init(const QGLContext *context, int numBuffers);
+  bool IsAvailable() const { return m_available; }
+
+  // Starts reading size pixels from the bottom left of the bound
+  // framebuffer. Returns false if every buffer is still being read into,
+  // in which case the frame is dropped.
+  bool Start(const QSize &size, qint64 ptsNs);
+  // Oldest readback as an RGBA GstBuffer, bottom row first, with ptsNs as
+  // its PTS, or NULL if it isn't finished yet. If wait is set, waits for it
+  // instead. Caller owns the reference.
+  GstBuffer *TakeFinished(bool wait, QSize *size);
+  int NumPending() const { return m_numPending; }
+  bool IsFull() const { return m_numPending == m_slots.size(); }
+  // Any readbacks in flight are dropped
+  void Clear();
+  // Context must be current. Drops readbacks and deletes the buffers.
+  void Cleanup();
+
+private:
+  typedef struct _ReadbackSlot
+  {
+    GLuint pboId;
+    qint64 bytes;
+    QSize size;
+    qint64 ptsNs;
+    GLsync fence;
+  } ReadbackSlot;
+
+  bool m_available;
+  QVector<ReadbackSlot> m_slots;
+  // Ring of pending readbacks, oldest first
+  int m_oldestSlotIx;
+  int m_numPending;
+
+  GLExtFunctions m_glExt;
+};
+
+#endif // FRAMEREADBACK_H
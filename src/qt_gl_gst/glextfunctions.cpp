@@ -0,0 +1,115 @@
+#include "glextfunctions.h"
+
+GLExtFunctions::GLExtFunctions() :
+  glGenBuffers(NULL), glDeleteBuffers(NULL), glBindBuffer(NULL), glBufferData(NULL),
+  glMapBufferRange(NULL), glUnmapBuffer(NULL), glBufferStorage(NULL),
+  glFenceSync(NULL), glClientWaitSync(NULL), glWaitSync(NULL), glDeleteSync(NULL),
+  glTexImage3D(NULL), glTexSubImage3D(NULL),
+  glDrawArraysInstanced(NULL), glVertexAttribDivisor(NULL),
+  glGenQueries(NULL), glDeleteQueries(NULL), glBeginQuery(NULL), glEndQuery(NULL),
+  glGetQueryObjectiv(NULL), glGetQueryObjectui64v(NULL)
+{
+}
+
+bool
+GLExtFunctions::ResolveBuffers(const QGLContext *context)
+{
+  glGenBuffers = (GLExtGenBuffersProc)context->getProcAddress("glGenBuffers");
+  glDeleteBuffers = (GLExtDeleteBuffersProc)context->getProcAddress("glDeleteBuffers");
+  glBindBuffer = (GLExtBindBufferProc)context->getProcAddress("glBindBuffer");
+  glBufferData = (GLExtBufferDataProc)context->getProcAddress("glBufferData");
+  glMapBufferRange = (GLExtMapBufferRangeProc)context->getProcAddress("glMapBufferRange");
+  glUnmapBuffer = (GLExtUnmapBufferProc)context->getProcAddress("glUnmapBuffer");
+
+  if (!glGenBuffers || !glDeleteBuffers || !glBindBuffer || !glBufferData ||
+      !glMapBufferRange || !glUnmapBuffer) {
+    glGenBuffers = NULL;
+    glDeleteBuffers = NULL;
+    glBindBuffer = NULL;
+    glBufferData = NULL;
+    glMapBufferRange = NULL;
+    glUnmapBuffer = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool
+GLExtFunctions::ResolveBufferStorage(const QGLContext *context)
+{
+  glBufferStorage = (GLExtBufferStorageProc)context->getProcAddress("glBufferStorage");
+  return (glBufferStorage != NULL);
+}
+
+bool
+GLExtFunctions::ResolveSync(const QGLContext *context)
+{
+  glFenceSync = (GLExtFenceSyncProc)context->getProcAddress("glFenceSync");
+  glClientWaitSync = (GLExtClientWaitSyncProc)context->getProcAddress("glClientWaitSync");
+  glWaitSync = (GLExtWaitSyncProc)context->getProcAddress("glWaitSync");
+  glDeleteSync = (GLExtDeleteSyncProc)context->getProcAddress("glDeleteSync");
+
+  if (!glFenceSync || !glClientWaitSync || !glWaitSync || !glDeleteSync) {
+    glFenceSync = NULL;
+    glClientWaitSync = NULL;
+    glWaitSync = NULL;
+    glDeleteSync = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool
+GLExtFunctions::ResolveTexture3D(const QGLContext *context)
+{
+  glTexImage3D = (GLExtTexImage3DProc)context->getProcAddress("glTexImage3D");
+  glTexSubImage3D = (GLExtTexSubImage3DProc)context->getProcAddress("glTexSubImage3D");
+
+  if (!glTexImage3D || !glTexSubImage3D) {
+    glTexImage3D = NULL;
+    glTexSubImage3D = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool
+GLExtFunctions::ResolveInstancing(const QGLContext *context)
+{
+  glDrawArraysInstanced = (GLExtDrawArraysInstancedProc)context->getProcAddress("glDrawArraysInstancedARB");
+  glVertexAttribDivisor = (GLExtVertexAttribDivisorProc)context->getProcAddress("glVertexAttribDivisorARB");
+
+  if (!glDrawArraysInstanced || !glVertexAttribDivisor) {
+    glDrawArraysInstanced = NULL;
+    glVertexAttribDivisor = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool
+GLExtFunctions::ResolveTimerQueries(const QGLContext *context, const char *suffix)
+{
+  glGenQueries = (GLExtGenQueriesProc)context->getProcAddress(QString("glGenQueries") + suffix);
+  glDeleteQueries = (GLExtDeleteQueriesProc)context->getProcAddress(QString("glDeleteQueries") + suffix);
+  glBeginQuery = (GLExtBeginQueryProc)context->getProcAddress(QString("glBeginQuery") + suffix);
+  glEndQuery = (GLExtEndQueryProc)context->getProcAddress(QString("glEndQuery") + suffix);
+  glGetQueryObjectiv = (GLExtGetQueryObjectivProc)context->getProcAddress(QString("glGetQueryObjectiv") + suffix);
+  // Only EXT_timer_query and the GLES extension suffix the 64 bit result
+  glGetQueryObjectui64v = (GLExtGetQueryObjectui64vProc)context->getProcAddress("glGetQueryObjectui64vEXT");
+  if (glGetQueryObjectui64v == NULL) {
+    glGetQueryObjectui64v = (GLExtGetQueryObjectui64vProc)context->getProcAddress("glGetQueryObjectui64v");
+  }
+
+  if (!glGenQueries || !glDeleteQueries || !glBeginQuery || !glEndQuery ||
+      !glGetQueryObjectiv || !glGetQueryObjectui64v) {
+    glGenQueries = NULL;
+    glDeleteQueries = NULL;
+    glBeginQuery = NULL;
+    glEndQuery = NULL;
+    glGetQueryObjectiv = NULL;
+    glGetQueryObjectui64v = NULL;
+    return false;
+  }
+  return true;
+}
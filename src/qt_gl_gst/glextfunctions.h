@@ -0,0 +1,165 @@
+#ifndef GLEXTFUNCTIONS_H
+#define GLEXTFUNCTIONS_H
+
+#include <QGLContext>
+
+// Not all GL headers have these, they're only used once the extension
+// providing them has been checked for
+#ifndef APIENTRY
+ #define APIENTRY
+#endif
+
+// Buffer objects
+#ifndef GL_PIXEL_PACK_BUFFER
+ #define GL_PIXEL_PACK_BUFFER                0x88EB
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+ #define GL_PIXEL_UNPACK_BUFFER              0x88EC
+#endif
+#ifndef GL_STREAM_READ
+ #define GL_STREAM_READ                      0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+ #define GL_MAP_READ_BIT                     0x0001
+#endif
+#ifndef GL_MAP_WRITE_BIT
+ #define GL_MAP_WRITE_BIT                    0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+ #define GL_MAP_PERSISTENT_BIT               0x0040
+ #define GL_MAP_COHERENT_BIT                 0x0080
+#endif
+
+// Sync objects
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+ #define GL_SYNC_GPU_COMMANDS_COMPLETE       0x9117
+ typedef struct __GLsync *GLsync;
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+ #define GL_SYNC_FLUSH_COMMANDS_BIT          0x00000001
+#endif
+#ifndef GL_TIMEOUT_IGNORED
+ #define GL_TIMEOUT_IGNORED                  0xFFFFFFFFFFFFFFFFull
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+ #define GL_ALREADY_SIGNALED                 0x911A
+ #define GL_TIMEOUT_EXPIRED                  0x911B
+ #define GL_CONDITION_SATISFIED              0x911C
+ #define GL_WAIT_FAILED                      0x911D
+#endif
+
+// 3D textures and texture arrays
+#ifndef GL_TEXTURE_3D
+ #define GL_TEXTURE_3D                       0x806F
+#endif
+#ifndef GL_TEXTURE_WRAP_R
+ #define GL_TEXTURE_WRAP_R                   0x8072
+#endif
+#ifndef GL_TEXTURE_2D_ARRAY
+ #define GL_TEXTURE_2D_ARRAY                 0x8C1A
+#endif
+#ifndef GL_RGBA8
+ #define GL_RGBA8                            0x8058
+#endif
+#ifndef GL_R8
+ #define GL_R8                               0x8229
+#endif
+
+// Timer queries
+#ifndef GL_TIME_ELAPSED
+ #define GL_TIME_ELAPSED                     0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+ #define GL_QUERY_RESULT                     0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+ #define GL_QUERY_RESULT_AVAILABLE           0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+ #define GL_GPU_DISJOINT_EXT                 0x8FBB
+#endif
+
+typedef void (APIENTRY *GLExtGenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *GLExtDeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *GLExtBindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *GLExtBufferDataProc)(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+typedef void (APIENTRY *GLExtBufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void *(APIENTRY *GLExtMapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRY *GLExtUnmapBufferProc)(GLenum target);
+
+typedef GLsync (APIENTRY *GLExtFenceSyncProc)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY *GLExtClientWaitSyncProc)(GLsync sync, GLbitfield flags, quint64 timeout);
+typedef void (APIENTRY *GLExtWaitSyncProc)(GLsync sync, GLbitfield flags, quint64 timeout);
+typedef void (APIENTRY *GLExtDeleteSyncProc)(GLsync sync);
+
+typedef void (APIENTRY *GLExtTexImage3DProc)(GLenum target, GLint level, GLint internalformat,
+                                             GLsizei width, GLsizei height, GLsizei depth, GLint border,
+                                             GLenum format, GLenum type, const void *pixels);
+typedef void (APIENTRY *GLExtTexSubImage3DProc)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                                GLsizei width, GLsizei height, GLsizei depth,
+                                                GLenum format, GLenum type, const void *pixels);
+
+typedef void (APIENTRY *GLExtDrawArraysInstancedProc)(GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+typedef void (APIENTRY *GLExtVertexAttribDivisorProc)(GLuint index, GLuint divisor);
+
+typedef void (APIENTRY *GLExtGenQueriesProc)(GLsizei n, GLuint *ids);
+typedef void (APIENTRY *GLExtDeleteQueriesProc)(GLsizei n, const GLuint *ids);
+typedef void (APIENTRY *GLExtBeginQueryProc)(GLenum target, GLuint id);
+typedef void (APIENTRY *GLExtEndQueryProc)(GLenum target);
+typedef void (APIENTRY *GLExtGetQueryObjectivProc)(GLuint id, GLenum pname, GLint *params);
+typedef void (APIENTRY *GLExtGetQueryObjectui64vProc)(GLuint id, GLenum pname, quint64 *params);
+
+// Entry points past GL 1.1 that the GL helpers use, looked up from the
+// context as Qt's QGL headers don't have them. Functions are grouped by the
+// extension giving them, callers check for the extension then resolve its
+// group. A group is either all there or left all NULL.
+class GLExtFunctions
+{
+public:
+  GLExtFunctions();
+
+  // Context must be current for all of these. Each returns false if any of
+  // the group's functions are missing.
+
+  // ARB_pixel_buffer_object/ARB_map_buffer_range, without storage
+  bool ResolveBuffers(const QGLContext *context);
+  // ARB_buffer_storage
+  bool ResolveBufferStorage(const QGLContext *context);
+  // ARB_sync
+  bool ResolveSync(const QGLContext *context);
+  // glTexImage3D and glTexSubImage3D, for 3D textures and texture arrays
+  bool ResolveTexture3D(const QGLContext *context);
+  // ARB_draw_instanced and ARB_instanced_arrays
+  bool ResolveInstancing(const QGLContext *context);
+  // suffix is "" for core, ARB_timer_query and EXT_timer_query, "EXT" for
+  // EXT_disjoint_timer_query
+  bool ResolveTimerQueries(const QGLContext *context, const char *suffix);
+
+  GLExtGenBuffersProc glGenBuffers;
+  GLExtDeleteBuffersProc glDeleteBuffers;
+  GLExtBindBufferProc glBindBuffer;
+  GLExtBufferDataProc glBufferData;
+  GLExtMapBufferRangeProc glMapBufferRange;
+  GLExtUnmapBufferProc glUnmapBuffer;
+  GLExtBufferStorageProc glBufferStorage;
+
+  GLExtFenceSyncProc glFenceSync;
+  GLExtClientWaitSyncProc glClientWaitSync;
+  GLExtWaitSyncProc glWaitSync;
+  GLExtDeleteSyncProc glDeleteSync;
+
+  GLExtTexImage3DProc glTexImage3D;
+  GLExtTexSubImage3DProc glTexSubImage3D;
+
+  GLExtDrawArraysInstancedProc glDrawArraysInstanced;
+  GLExtVertexAttribDivisorProc glVertexAttribDivisor;
+
+  GLExtGenQueriesProc glGenQueries;
+  GLExtDeleteQueriesProc glDeleteQueries;
+  GLExtBeginQueryProc glBeginQuery;
+  GLExtEndQueryProc glEndQuery;
+  GLExtGetQueryObjectivProc glGetQueryObjectiv;
+  GLExtGetQueryObjectui64vProc glGetQueryObjectui64v;
+};
+
+#endif // GLEXTFUNCTIONS_H
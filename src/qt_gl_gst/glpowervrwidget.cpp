@@ -12,8 +12,8 @@
 
 #define COLFMT_TO_BC_FOURCC(fourCC) fourCC
 
-GLPowerVRWidget::GLPowerVRWidget(int argc, char *argv[], QWidget *parent) :
-  GLWidget(argc, argv, parent)
+GLPowerVRWidget::GLPowerVRWidget(const AppOptions &options, QWidget *parent) :
+  GLWidget(options, parent)
 {
   if (CMEM_init() == -1) {
     LOG(LOG_GL, Logger::Error, "Error calling CMEM_init");
@@ -85,7 +85,7 @@ Pipeline *GLPowerVRWidget::createPipeline(int vidIx)
   }
   m_vidBufferAddresses.replace(vidIx, QVector<bc_buf_ptr_t>());
 
-  return new TIGStreamerPipeline(vidIx, this->m_videoLoc[vidIx], SLOT(newFrame(int)), this);
+  return GLWidget::createPipeline(vidIx);
 }
 
 int
@@ -10,7 +10,7 @@ class GLPowerVRWidget : public GLWidget
 {
   Q_OBJECT
 public:
-  explicit GLPowerVRWidget(int argc, char *argv[], QWidget *parent = 0);
+  explicit GLPowerVRWidget(const AppOptions &options, QWidget *parent = 0);
   ~GLPowerVRWidget();
 
 protected:
@@ -0,0 +1,169 @@
+#include <string.h>
+#include "gltimerqueries.h"
+#include "applogger.h"
+
+GLTimerQueries::GLTimerQueries() :
+  m_available(false), m_isDisjointExt(false), m_queryActive(false), m_currentFrame(0)
+{
+  for (int frameIx = 0; frameIx < GLTIMER_FRAMES_IN_FLIGHT; frameIx++) {
+    m_frames[frameIx].numUsed = 0;
+    m_frames[frameIx].pending = false;
+  }
+}
+
+GLTimerQueries::~GLTimerQueries()
+{
+}
+
+void
+GLTimerQueries::Cleanup()
+{
+  if (!m_available) {
+    return;
+  }
+
+  if (m_queryActive) {
+    m_glExt.glEndQuery(GL_TIME_ELAPSED);
+    m_queryActive = false;
+  }
+  for (int frameIx = 0; frameIx < GLTIMER_FRAMES_IN_FLIGHT; frameIx++) {
+    m_glExt.glDeleteQueries(GLTIMER_MAX_QUERIES_PER_FRAME, m_frames[frameIx].ids);
+    m_frames[frameIx].pending = false;
+  }
+  m_available = false;
+}
+
+bool
+GLTimerQueries::Init(const QGLContext *context)
+{
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  if (extensions == NULL) {
+    LOG(LOG_GL, Logger::Warning, "Can't get GL extensions, GPU timing disabled");
+    return false;
+  }
+
+  // Core/ARB and EXT_timer_query use the unsuffixed query entry points,
+  // the GLES extension has its own EXT suffixed set
+  const char *suffix = NULL;
+  if (strstr(extensions, "GL_ARB_timer_query")) {
+    suffix = "";
+  }
+  else if (strstr(extensions, "GL_EXT_timer_query")) {
+    suffix = "";
+  }
+  else if (strstr(extensions, "GL_EXT_disjoint_timer_query")) {
+    suffix = "EXT";
+    m_isDisjointExt = true;
+  }
+  else {
+    LOG(LOG_GL, Logger::Warning, "No timer query extension, GPU timing disabled");
+    return false;
+  }
+
+  if (!m_glExt.ResolveTimerQueries(context, suffix)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't get timer query functions, GPU timing disabled");
+    return false;
+  }
+
+  for (int frameIx = 0; frameIx < GLTIMER_FRAMES_IN_FLIGHT; frameIx++) {
+    m_glExt.glGenQueries(GLTIMER_MAX_QUERIES_PER_FRAME, m_frames[frameIx].ids);
+  }
+
+  LOG(LOG_GL, Logger::Info, "GPU timing enabled");
+  m_available = true;
+  return true;
+}
+
+void
+GLTimerQueries::BeginFrame(RenderStats *stats)
+{
+  if (!m_available) {
+    return;
+  }
+
+  // Pick up whatever older frames have finished, oldest first
+  for (int age = GLTIMER_FRAMES_IN_FLIGHT - 1; age > 0; age--) {
+    int frameIx = (m_currentFrame + GLTIMER_FRAMES_IN_FLIGHT - age) % GLTIMER_FRAMES_IN_FLIGHT;
+    if (m_frames[frameIx].pending) {
+      collectFrame(m_frames[frameIx], stats);
+    }
+  }
+
+  m_currentFrame = (m_currentFrame + 1) % GLTIMER_FRAMES_IN_FLIGHT;
+
+  // Still not finished after all the frames in flight, drop rather than wait
+  FrameQueries &frame = m_frames[m_currentFrame];
+  if (frame.pending && !collectFrame(frame, stats)) {
+    stats->AddToCounter("gpu_timer_frames_dropped", 1);
+  }
+  frame.pending = false;
+  frame.numUsed = 0;
+}
+
+void
+GLTimerQueries::Begin(const QString &name)
+{
+  FrameQueries &frame = m_frames[m_currentFrame];
+  if (!m_available || m_queryActive || (frame.numUsed >= GLTIMER_MAX_QUERIES_PER_FRAME)) {
+    return;
+  }
+
+  frame.names[frame.numUsed] = name;
+  m_glExt.glBeginQuery(GL_TIME_ELAPSED, frame.ids[frame.numUsed]);
+  m_queryActive = true;
+}
+
+void
+GLTimerQueries::End()
+{
+  if (!m_available || !m_queryActive) {
+    return;
+  }
+
+  m_glExt.glEndQuery(GL_TIME_ELAPSED);
+  m_queryActive = false;
+  m_frames[m_currentFrame].numUsed++;
+}
+
+void
+GLTimerQueries::EndFrame()
+{
+  if (!m_available) {
+    return;
+  }
+
+  End();
+  m_frames[m_currentFrame].pending = (m_frames[m_currentFrame].numUsed > 0);
+}
+
+// Returns false without reading anything if the frame's results aren't ready
+bool
+GLTimerQueries::collectFrame(FrameQueries &frame, RenderStats *stats)
+{
+  // Queries complete in order, so the last one being ready means all are
+  GLint available = 0;
+  m_glExt.glGetQueryObjectiv(frame.ids[frame.numUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+
+  frame.pending = false;
+
+  // Results are meaningless if the GPU was reset or changed clocks meanwhile
+  if (m_isDisjointExt) {
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint) {
+      stats->AddToCounter("gpu_timer_frames_dropped", 1);
+      return true;
+    }
+  }
+
+  for (int queryIx = 0; queryIx < frame.numUsed; queryIx++) {
+    quint64 elapsedNs = 0;
+    m_glExt.glGetQueryObjectui64v(frame.ids[queryIx], GL_QUERY_RESULT, &elapsedNs);
+    stats->Timing("gpu_" + frame.names[queryIx]).AddSample((qint64)elapsedNs);
+  }
+
+  return true;
+}
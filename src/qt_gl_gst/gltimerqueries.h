@@ -0,0 +1,57 @@
+#ifndef GLTIMERQUERIES_H
+#define GLTIMERQUERIES_H
+
+#include <QGLContext>
+#include <QVector>
+#include <QString>
+
+#include "renderstats.h"
+#include "glextfunctions.h"
+
+// Frames of queries kept in flight before results are read, so reading
+// them never has to wait for the GPU
+#define GLTIMER_FRAMES_IN_FLIGHT            4
+#define GLTIMER_MAX_QUERIES_PER_FRAME       64
+
+// GPU time of render passes using GL_TIME_ELAPSED queries, from
+// ARB_timer_query, EXT_timer_query or EXT_disjoint_timer_query.
+// Results go into RenderStats as "gpu_<name>" timings a few frames later.
+class GLTimerQueries
+{
+public:
+  GLTimerQueries();
+  ~GLTimerQueries();
+
+  // Context must be current. Returns false if there is no timer query support,
+  // in which case all the other calls do nothing.
+  bool Init(const QGLContext *context);
+  bool IsAvailable() const { return m_available; }
+  // Context must be current. Deletes the queries, unavailable after this.
+  void Cleanup();
+
+  void BeginFrame(RenderStats *stats);
+  void Begin(const QString &name);
+  void End();
+  void EndFrame();
+
+private:
+  typedef struct _FrameQueries
+  {
+    GLuint ids[GLTIMER_MAX_QUERIES_PER_FRAME];
+    QString names[GLTIMER_MAX_QUERIES_PER_FRAME];
+    int numUsed;
+    bool pending;
+  } FrameQueries;
+
+  bool collectFrame(FrameQueries &frame, RenderStats *stats);
+
+  bool m_available;
+  bool m_isDisjointExt;
+  bool m_queryActive;
+  FrameQueries m_frames[GLTIMER_FRAMES_IN_FLIGHT];
+  int m_currentFrame;
+
+  GLExtFunctions m_glExt;
+};
+
+#endif // GLTIMERQUERIES_H
@@ -1,5 +1,10 @@
 #include <QMainWindow>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <gst/gst.h>
 #include "glwidget.h"
+#include "pipelineclock.h"
 #include "shaderlists.h"
 #include "applogger.h"
 
@@ -8,9 +13,22 @@
 #endif
 
 
-GLWidget::GLWidget(int argc, char *argv[], QWidget *parent) :
-  QGLWidget(QGLFormat(QGL::DoubleBuffer | QGL::DepthBuffer | QGL::Rgba), parent),
-  m_closing(false), m_brickProg(this)
+GLWidget::GLWidget(const AppOptions &options, QWidget *parent) :
+  QGLWidget(glFormatForOptions(options), parent),
+  m_closing(false), m_brickProg(this), m_headless(options.m_headless),
+  m_headlessFrames(options.m_headlessFrames), m_headlessFramesDone(0),
+  m_headlessSize(options.m_headlessSize), m_benchOutputFile(options.m_benchOutputFile),
+  m_headlessTimer(NULL), m_headlessFbo(NULL), m_offlineFps(options.m_offlineFps), m_offlineFrameNs(0),
+  m_offlineStartNs(-1), m_offlineWaiting(false), m_gpuTimingEnabled(options.m_gpuTiming),
+  m_vidQuadVbo(QGLBuffer::VertexBuffer), m_vidQuadVao(NULL),
+  m_throttleHidden(options.m_throttleHidden), m_instancingEnabled(options.m_instancing),
+  m_texturePool(GL_RECT_VID_TEXTURE_2D), m_asyncUploadBuffers(options.m_asyncUploadBuffers),
+  m_asyncUploader(GL_RECT_VID_TEXTURE_2D, &m_texturePool), m_dmabufEnabled(options.m_dmabufImport),
+  m_pboPoolMB(options.m_pboPoolMB), m_pboPool(NULL),
+  m_deinterlaceMode(options.m_deinterlaceMode), m_deinterlacer(GL_RECT_VID_TEXTURE_2D, &m_texturePool),
+  m_colourLutEnabled(options.m_colourLut), m_colourLutFile(options.m_colourLutFile),
+  m_effectChainDescs(options.m_effectChains), m_recordFile(options.m_recordFile), m_nextGrabId(0),
+  m_pipelineBackend(options.m_pipelineBackend), m_syncStreams(options.m_syncStreams)
 {
   LOG(LOG_GL, Logger::Debug1, "GLWidget constructor entered");
 
@@ -30,11 +48,17 @@ GLWidget::GLWidget(int argc, char *argv[], QWidget *parent) :
   m_stackVidQuads = false;
   m_currentModelEffectIndex = ModelEffectFirst;
 
-  QTimer *timer = new QTimer(this);
-  connect(timer, SIGNAL(timeout()), this, SLOT(animate()));
-  timer->start(20);
+  // Stills convert in order, without taking threads off the decoders
+  m_grabPool.setMaxThreadCount(1);
 
-  grabKeyboard();
+  // Headless mode steps the animation once per rendered frame instead
+  if (!m_headless) {
+    QTimer *timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(animate()));
+    timer->start(20);
+
+    grabKeyboard();
+  }
 
   // Video shader effects vars
   m_colourHilightRangeMin = QVector4D(0.0, 0.0, 0.0, 0.0);
@@ -45,9 +69,14 @@ GLWidget::GLWidget(int argc, char *argv[], QWidget *parent) :
   m_colourSwapDirUpwards = true;
   m_alphaTextureLoaded = false;
 
+  m_texturePool.SetBudget((qint64)options.m_textureBudgetMB * 1024 * 1024);
+
   // Video pipeline
-  for (int vidIx = 1; vidIx < argc; vidIx++) {
-        m_videoLoc.push_back(QString(argv[vidIx]));
+  m_videoLoc = options.m_videoLocations;
+
+  // Stays with the default carousel if the file is no good
+  if (!options.m_layoutFile.isEmpty()) {
+    m_layout.Load(options.m_layoutFile);
   }
 
   m_model = NULL;
@@ -78,6 +107,52 @@ GLWidget::GLWidget(int argc, char *argv[], QWidget *parent) :
 
 GLWidget::~GLWidget()
 {
+  // The GL helpers' objects are only deleted here, with our context current
+  makeCurrent();
+  m_gpuTimers.Cleanup();
+  m_vidBatcher.Cleanup();
+  m_dmabufImporter.Cleanup();
+  m_deinterlacer.Cleanup();
+  m_colourLut.Cleanup();
+  m_fboPool.Cleanup();
+  m_grabReadback.Cleanup();
+  m_recorder.Cleanup();
+  // After anything handing textures back to it
+  m_texturePool.Cleanup();
+
+  delete m_headlessFbo;
+
+  if (m_pboPool) {
+    // Every frame in the arena has to be back before it can go
+    m_grabPool.waitForDone();
+    glFinish();
+    for (int relIx = 0; relIx < m_pendingReleases.size(); relIx++) {
+      gst_buffer_unref((GstBuffer *)m_pendingReleases[relIx].buf);
+    }
+    m_pendingReleases.clear();
+    for (int vidIx = 0; vidIx < m_vidTextures.size(); vidIx++) {
+      if (m_vidTextures[vidIx].buffer) {
+        gst_buffer_unref((GstBuffer *)m_vidTextures[vidIx].buffer);
+        m_vidTextures[vidIx].buffer = NULL;
+      }
+    }
+
+    m_pboPool->Shutdown();
+    m_pboPool->unref();
+  }
+}
+
+QGLFormat
+GLWidget::glFormatForOptions(const AppOptions &options)
+{
+  QGLFormat glFormat(QGL::DoubleBuffer | QGL::DepthBuffer | QGL::Rgba);
+
+  // Don't let vsync throttle the benchmark
+  if (options.m_headless) {
+    glFormat.setSwapInterval(0);
+  }
+
+  return glFormat;
 }
 
 void
@@ -95,6 +170,9 @@ GLWidget::initVideo()
     QObject::connect(m_vidPipelines[vidIx], SIGNAL(finished(int)), this, SLOT(pipelineFinished(int)));
     QObject::connect(this, SIGNAL(closeRequested()), m_vidPipelines[vidIx], SLOT(Stop()), Qt::QueuedConnection);
 
+    m_vidPipelines[vidIx]->enableTargetScaling(m_layout.ScaleDecode());
+    m_vidPipelines[vidIx]->enableSyncToRenderer(m_syncStreams);
+    m_vidPipelines[vidIx]->enableOffline(m_offlineFps > 0);
     m_vidPipelines[vidIx]->Configure();
   }
 }
@@ -167,10 +245,63 @@ GLWidget::initializeGL()
   setupShader(&m_NV12AlphaMask, VidNV12AlphaMaskShaderList, NUM_SHADERS_VIDNV12_ALPHAMASK);
 #endif
 
-  glTexParameteri(GL_RECT_VID_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_RECT_VID_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_RECT_VID_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_RECT_VID_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (m_gpuTimingEnabled) {
+    m_gpuTimers.Init(context());
+  }
+
+  setupVidQuadGeometry();
+
+#ifndef IMGTEX_EXT_NEEDED
+  // Stream textures are filled in by the driver, nothing to upload
+  if ((m_asyncUploadBuffers > 0) && m_asyncUploader.Start(context(), m_asyncUploadBuffers)) {
+    connect(&m_asyncUploader, SIGNAL(uploaded(int)), this, SLOT(asyncUploadReadySlot(int)), Qt::QueuedConnection);
+  }
+  else if (m_dmabufEnabled) {
+    m_dmabufImporter.Init(context());
+  }
+
+  // Upload thread maps frames itself, so only when uploading here
+  if (!m_asyncUploader.IsAvailable() && (m_pboPoolMB > 0)) {
+    m_pboPool = new PboBufferPool();
+    if (!m_pboPool->Init(context(), (qint64)m_pboPoolMB * 1024 * 1024)) {
+      m_pboPool->unref();
+      m_pboPool = NULL;
+    }
+  }
+#endif
+
+#ifdef RECTTEX_EXT_NEEDED
+  // Upload thread's textures are swapped in as they come, nowhere to do the pass
+  if ((m_deinterlaceMode != DeinterlaceOff) && !m_asyncUploader.IsAvailable() &&
+      (setupShader(&m_deinterlaceProg, VidDeinterlaceShaderList, NUM_SHADERS_VIDDEINTERLACE) == 0)) {
+    m_deinterlacer.Init(&m_deinterlaceProg, m_deinterlaceMode);
+  }
+#endif
+
+  if (m_colourLutEnabled) {
+    int lutShaderErrors = 0;
+#ifdef VIDI420_SHADERS_NEEDED
+    lutShaderErrors |= setupShader(&m_I420ColourLut, VidI420ColourLutShaderList, NUM_SHADERS_VIDI420_COLOURLUT);
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+    lutShaderErrors |= setupShader(&m_NV12ColourLut, VidNV12ColourLutShaderList, NUM_SHADERS_VIDNV12_COLOURLUT);
+#endif
+    // GLES only has 3D textures with an extension, the shaders won't build
+    if ((lutShaderErrors == 0) && m_colourLut.Init(context(), COLOURLUT_SIZE) && !m_colourLutFile.isEmpty()) {
+      m_colourLut.LoadCubeFile(m_colourLutFile);
+    }
+  }
+
+  // Batched frames share one texture array, which can't be multi buffered
+  // per vid, so no batching when uploading on the other thread
+  if (m_instancingEnabled && !m_asyncUploader.IsAvailable() && m_vidBatcher.Init(context())) {
+#ifdef VIDI420_SHADERS_NEEDED
+    setupShader(&m_I420NoEffectInstanced, VidI420NoEffectInstancedShaderList, NUM_SHADERS_VIDI420_NOEFFECT_INSTANCED);
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+    setupShader(&m_NV12NoEffectInstanced, VidNV12NoEffectInstancedShaderList, NUM_SHADERS_VIDNV12_NOEFFECT_INSTANCED);
+#endif
+  }
 
   // Set uniforms for vid shaders along with other stream details when first
   // frame comes through
@@ -183,11 +314,27 @@ GLWidget::initializeGL()
   // Create entry in tex info vector for all pipelines
   for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
     VidTextureInfo newInfo;
-    glGenTextures(1, &newInfo.texId);
+    // Comes from the texture pool with the first frame, once the size is known
+    newInfo.texId = 0;
     newInfo.texInfoValid = false;
     newInfo.buffer = NULL;
     newInfo.effect = VidShaderNoEffect;
     newInfo.frameCount = 0;
+    newInfo.framesUploaded = 0;
+    newInfo.newSinceRender = false;
+    newInfo.visible = true;
+    newInfo.dmabufImport = false;
+    newInfo.interlaced = false;
+    newInfo.deinterlacedTexId = 0;
+    newInfo.colorimetry.matrix = ColMatrix_Unknown;
+    newInfo.colorimetry.fullRange = false;
+    newInfo.yuvCoeffs = YuvColourMatrix::Coeffs(newInfo.colorimetry, 0);
+    // Options already checked they parse. Programs are built once the
+    // format is known.
+    QString chainDesc = m_effectChainDescs.value(vidIx, m_effectChainDescs.value(-1));
+    if (!chainDesc.isEmpty()) {
+      newInfo.effectChain.Parse(chainDesc);
+    }
 
     m_vidTextures.push_back(newInfo);
   }
@@ -199,7 +346,11 @@ GLWidget::initializeGL()
   }
   m_model->SetScale(MODEL_BOUNDARY_SIZE);
 
+  // Same base time for all so they play in step
+  qint64 baseTimeNs = PipelineClock::StartBaseTimeNs();
   for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
+    m_vidPipelines[vidIx]->setBaseTimeNs(baseTimeNs);
+    m_vidPipelines[vidIx]->setBufferPool(m_pboPool);
     m_vidPipelines[vidIx]->Start();
   }
 }
@@ -207,16 +358,14 @@ GLWidget::initializeGL()
 Pipeline *
 GLWidget::createPipeline(int vidIx)
 {
-  return new GStreamerPipeline(vidIx, m_videoLoc[vidIx], SLOT(newFrame(int)), this);
+  return PipelineFactory::Create(m_pipelineBackend, vidIx, m_videoLoc[vidIx], SLOT(newFrame(int)), this);
 }
 
+// Draws the model and video quads into whatever framebuffer is bound,
+// context must already be current
 void
-GLWidget::paintEvent(QPaintEvent *event)
+GLWidget::renderScene()
 {
-  Q_UNUSED(event);
-
-  makeCurrent();
-
   glDepthFunc(GL_LESS);
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_BLEND);
@@ -241,7 +390,7 @@ GLWidget::paintEvent(QPaintEvent *event)
     break;
   case ModelEffectVideo:
     glActiveTexture(GL_RECT_VID_TEXTURE0);
-    glBindTexture(GL_RECT_VID_TEXTURE_2D, m_vidTextures[0].texId);
+    glBindTexture(GL_RECT_VID_TEXTURE_2D, vidDrawTexture(0));
 #ifdef TEXCOORDS_ALREADY_NORMALISED
     m_vidTextures[0].effect = VidShaderNoEffect;
 #else
@@ -255,7 +404,7 @@ GLWidget::paintEvent(QPaintEvent *event)
 
   case ModelEffectVideoLit:
     glActiveTexture(GL_RECT_VID_TEXTURE0);
-    glBindTexture(GL_RECT_VID_TEXTURE_2D, m_vidTextures[0].texId);
+    glBindTexture(GL_RECT_VID_TEXTURE_2D, vidDrawTexture(0));
 #ifdef TEXCOORDS_ALREADY_NORMALISED
     m_vidTextures[0].effect = VidShaderLit;
 #else
@@ -268,7 +417,11 @@ GLWidget::paintEvent(QPaintEvent *event)
     break;
   }
 
+  if (m_gpuTimers.IsAvailable()) {
+    m_gpuTimers.Begin("model");
+  }
   m_model->Draw(m_modelViewMatrix, m_projectionMatrix, currentShader, false);
+  m_gpuTimers.End();
 
   switch (enabledModelEffect) {
   case ModelEffectBrick:
@@ -285,87 +438,940 @@ GLWidget::paintEvent(QPaintEvent *event)
     break;
   }
 
-  // Draw videos around the object
+  m_layout.Update(m_vidTextures.size(), m_modelViewMatrix, m_projectionMatrix, m_viewportSize);
+  updateVidPipelineHints();
+
+  // Draw videos around the object. The quad geometry is static, only the
+  // textures and uniforms change between videos.
+  bindVidQuadGeometry();
+
+  QVector<bool> vidDrawn(m_vidTextures.size(), false);
+  if (m_vidBatcher.IsAvailable()) {
+    drawBatchedVids(vidDrawn);
+  }
+
   for (int vidIx = 0; vidIx < m_vidTextures.size(); vidIx++) {
-    if (m_vidTextures[vidIx].texInfoValid) {
-      // Render a quad with the video on it:
-      glActiveTexture(GL_RECT_VID_TEXTURE0);
-      glBindTexture(GL_RECT_VID_TEXTURE_2D, m_vidTextures[vidIx].texId);
-      printOpenGLError(__FILE__, __LINE__);
-
-      if ((m_vidTextures[vidIx].effect == VidShaderAlphaMask) && m_alphaTextureLoaded) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glActiveTexture(GL_RECT_TEXTURE1);
-        glBindTexture(GL_RECT_TEXTURE_2D, m_alphaTextureId);
+    if (m_vidTextures[vidIx].texInfoValid && (vidDrawTexture(vidIx) != 0) && !vidDrawn[vidIx]) {
+      if (m_gpuTimers.IsAvailable()) {
+        m_gpuTimers.Begin(QString("vid%1").arg(vidIx));
       }
 
-      m_vidTextures[vidIx].shader->bind();
-      setVidShaderVars(vidIx, false);
-      printOpenGLError(__FILE__, __LINE__);
+      if (vidUsesChain(vidIx)) {
+        drawVidChain(vidIx);
+      }
+      else {
+        // Render a quad with the video on it:
+        glActiveTexture(GL_RECT_VID_TEXTURE0);
+        glBindTexture(GL_RECT_VID_TEXTURE_2D, vidDrawTexture(vidIx));
+        printOpenGLError(__FILE__, __LINE__);
+
+        if ((m_vidTextures[vidIx].effect == VidShaderAlphaMask) && m_alphaTextureLoaded) {
+          glEnable(GL_BLEND);
+          glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+          glActiveTexture(GL_RECT_TEXTURE1);
+          glBindTexture(GL_RECT_TEXTURE_2D, m_alphaTextureId);
+        }
+
+        m_vidTextures[vidIx].shader->bind();
+        setVidShaderVars(vidIx, false);
+        printOpenGLError(__FILE__, __LINE__);
+
+        QGLShaderProgram *vidShader = m_vidTextures[vidIx].shader;
 
-      if (m_vidTextures[vidIx].effect == VidShaderColourHilightSwap) {
-        m_vidTextures[vidIx].shader->setUniformValue("u_componentSwapR", m_colourComponentSwapR);
-        m_vidTextures[vidIx].shader->setUniformValue("u_componentSwapG", m_colourComponentSwapG);
-        m_vidTextures[vidIx].shader->setUniformValue("u_componentSwapB", m_colourComponentSwapB);
+        vidShader->setUniformValue("u_mvp_matrix", m_layout.TileMvpMatrix(vidIx));
+        vidShader->setUniformValue("u_mv_matrix", m_layout.TileMvMatrix(vidIx));
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
       }
 
-      QGLShaderProgram *vidShader = m_vidTextures[vidIx].shader;
+      m_gpuTimers.End();
+    }
+  }
+
+  releaseVidQuadGeometry();
+}
+
+// Let pipelines scale frames down towards the size their tile is on screen,
+// and throttle the ones nobody can see
+void
+GLWidget::updateVidPipelineHints()
+{
+  for (int vidIx = 0; vidIx < qMin(m_vidPipelines.size(), m_vidTextures.size()); vidIx++) {
+    if (m_vidPipelines[vidIx] == NULL) {
+      continue;
+    }
 
-      QMatrix4x4 vidQuadMatrix = m_modelViewMatrix;
+    if (m_layout.ScaleDecode()) {
+      m_vidPipelines[vidIx]->setTargetSize(m_layout.TilePixelSize(vidIx));
+    }
 
-      if (m_stackVidQuads) {
-        vidQuadMatrix.translate(0.0, 0.0, 2.0);
-        vidQuadMatrix.translate(0.0, 0.0, 0.2*vidIx);
+    if (m_throttleHidden) {
+      bool visible = vidVisible(vidIx);
+      if (visible != m_vidTextures[vidIx].visible) {
+        m_vidTextures[vidIx].visible = visible;
+        m_vidPipelines[vidIx]->setThrottled(!visible);
       }
-      else {
-        vidQuadMatrix.rotate((360/m_vidTextures.size())*vidIx, 0.0, 1.0, 0.0);
-        vidQuadMatrix.translate(0.0, 0.0, 2.0);
+    }
+  }
+}
+
+// Vid 0 is always seen while it is on the model
+bool
+GLWidget::vidVisible(int vidIx)
+{
+  return m_layout.TileVisible(vidIx) ||
+         ((vidIx == 0) && (m_currentModelEffectIndex != ModelEffectBrick));
+}
+
+// Only plain quads are batched, not ones with effects or effect chains. Vid 0 also textures the model when a video
+// model effect is on, which needs its own texture.
+bool
+GLWidget::vidUsesBatch(int vidIx)
+{
+  return m_vidBatcher.IsBatched(vidIx) &&
+         (m_vidTextures[vidIx].effect == VidShaderNoEffect) && !vidUsesLut(vidIx) && !vidUsesChain(vidIx) &&
+         ((vidIx != 0) || (m_currentModelEffectIndex == ModelEffectBrick));
+}
+
+// Effects always go through the LUT when there is one. Plain quads only do
+// when there's a grade, otherwise the matrix is just as cheap and they can
+// still be batched.
+bool
+GLWidget::vidUsesLut(int vidIx)
+{
+  if (!m_colourLut.IsAvailable()) {
+    return false;
+  }
+
+  switch (m_vidTextures[vidIx].colourFormat) {
+#ifdef VIDI420_SHADERS_NEEDED
+  case ColFmt_I420:
+  case ColFmt_I420_10LE:
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+  case ColFmt_NV12:
+  case ColFmt_P010:
+#endif
+    break;
+  default:
+    return false;
+  }
+
+  switch (m_vidTextures[vidIx].effect) {
+  case VidShaderColourHilight:
+  case VidShaderColourHilightSwap:
+    return true;
+  case VidShaderNoEffect:
+    return m_colourLut.HasGrade();
+  default:
+    return false;
+  }
+}
+
+// Binds the vid's LUT, baking it first if the effect has changed since
+void
+GLWidget::bindVidLut(int vidIx)
+{
+  ColourLutEffect lutEffect = ColourLutNoEffect;
+  if (m_vidTextures[vidIx].effect == VidShaderColourHilight) {
+    lutEffect = ColourLutHilight;
+  }
+  else if (m_vidTextures[vidIx].effect == VidShaderColourHilightSwap) {
+    lutEffect = ColourLutHilightSwap;
+  }
+
+  ColourLutParams params;
+  params.hilightMin = m_colourHilightRangeMin;
+  params.hilightMax = m_colourHilightRangeMax;
+  params.swapR = m_colourComponentSwapR;
+  params.swapG = m_colourComponentSwapG;
+  params.swapB = m_colourComponentSwapB;
+
+  glActiveTexture(GL_TEXTURE0 + COLOURLUT_TEXTURE_UNIT);
+  m_colourLut.Bind(m_vidTextures[vidIx].yuvCoeffs, lutEffect, params);
+  glActiveTexture(GL_RECT_VID_TEXTURE0);
+}
+
+// Chain is only drawn once all its stages have built for the vid's format
+bool
+GLWidget::vidUsesChain(int vidIx)
+{
+  return !m_vidTextures[vidIx].chainShaders.isEmpty();
+}
+
+// Conversion shader an effect chain starts with for the format, NULL if
+// the format's shaders aren't in the build
+const char *
+GLWidget::vidConvShaderFile(ColFormat colFormat)
+{
+  switch (colFormat) {
+#ifdef VIDI420_SHADERS_NEEDED
+  case ColFmt_I420:
+  case ColFmt_I420_10LE:
+    return "shaders/yuv2rgbI420" VIDCONV_FRAG_SHADER_SUFFIX ".frag";
+#endif
+#ifdef VIDUYVY_SHADERS_NEEDED
+  case ColFmt_UYVY:
+    return "shaders/yuv2rgbUYVY" VIDCONV_FRAG_SHADER_SUFFIX ".frag";
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+  case ColFmt_NV12:
+  case ColFmt_P010:
+    return "shaders/yuv2rgbNV12" VIDCONV_FRAG_SHADER_SUFFIX ".frag";
+#endif
+  default:
+    return NULL;
+  }
+}
+
+// Stage programs are shared by every vid with the same stage, the first
+// stage's by format too, and only built the first time one needs them. If
+// any stage won't build the vid is drawn without its chain.
+void
+GLWidget::setupVidChainShaders(int vidIx)
+{
+  VidTextureInfo &vid = m_vidTextures[vidIx];
+  vid.chainShaders.clear();
+
+  if (vid.effectChain.IsEmpty()) {
+    return;
+  }
+
+  const char *convFileName = vidConvShaderFile(vid.colourFormat);
+  if (convFileName == NULL) {
+    LOG(LOG_GLSHADERS, Logger::Warning, "No conversion shader for vid %d's format, drawn without its effect chain",
+        vidIx);
+    return;
+  }
+
+  QVector<QGLShaderProgram *> stageShaders;
+  for (int stageIx = 0; stageIx < vid.effectChain.NumStages(); stageIx++) {
+    QString key = vid.effectChain.StageKey(stageIx);
+    if (stageIx == 0) {
+      key.prepend(QString("%1:").arg(convFileName));
+    }
+
+    if (!m_chainShaders.contains(key)) {
+      // Module names have to stay around until it's built
+      QList<QByteArray> fragFileNames;
+      if (stageIx == 0) {
+        fragFileNames.append(convFileName);
+      }
+#ifdef RECTTEX_EXT_NEEDED
+      else if (vid.effectChain.StageUsesAlphaMask(stageIx)) {
+        fragFileNames.append("shaders/recttex-enable.frag");
+      }
+#endif
+      QStringList passFileNames = vid.effectChain.StageSourceFiles(stageIx, VIDCONV_FRAG_SHADER_SUFFIX);
+      for (int fileIx = 0; fileIx < passFileNames.size(); fileIx++) {
+        fragFileNames.append(passFileNames[fileIx].toUtf8());
+      }
+
+      QVector<GLShaderModule> modules;
+      GLShaderModule vertModule = { "shaders/alphamask.vert", QGLShader::Vertex };
+      modules.append(vertModule);
+      for (int fileIx = 0; fileIx < fragFileNames.size(); fileIx++) {
+        GLShaderModule fragModule = { fragFileNames[fileIx].constData(), QGLShader::Fragment };
+        modules.append(fragModule);
+      }
+
+      QGLShaderProgram *prog = new QGLShaderProgram(this);
+      if (setupShader(prog, modules.data(), modules.size(), vid.effectChain.StageMainSource(stageIx)) != 0) {
+        delete prog;
+        prog = NULL;
       }
+      // Kept even if it failed, so it's not tried again for every vid
+      m_chainShaders.insert(key, prog);
+    }
+
+    if (m_chainShaders.value(key) == NULL) {
+      LOG(LOG_GLSHADERS, Logger::Warning, "Effect chain stage %s won't build, vid %d drawn without its chain",
+          key.toUtf8().constData(), vidIx);
+      return;
+    }
+    stageShaders.append(m_chainShaders.value(key));
+  }
+
+  LOG(LOG_GLSHADERS, Logger::Debug1, "vid %d drawn through effect chain %s in %d stage(s)",
+      vidIx, vid.effectChain.Description().toUtf8().constData(), stageShaders.size());
+  vid.chainShaders = stageShaders;
+}
+
+// Every stage but the last renders the whole frame into an FBO from the
+// pool, which the next stage samples. The last one draws the tile like any
+// other vid. Vid quad geometry must be bound.
+void
+GLWidget::drawVidChain(int vidIx)
+{
+  QSize frameSize(m_vidTextures[vidIx].width, m_vidTextures[vidIx].height);
+  int lastStageIx = m_vidTextures[vidIx].chainShaders.size() - 1;
+  QGLFramebufferObject *inputFbo = NULL;
+  bool stagesDone = true;
+
+  if (lastStageIx > 0) {
+    // Back to whichever framebuffer the scene is going into afterwards, it's
+    // the headless one in headless mode
+    QOpenGLFunctions *glFuncs = QOpenGLContext::currentContext()->functions();
+    GLint sceneFbo = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &sceneFbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glViewport(0, 0, frameSize.width(), frameSize.height());
+
+    // Quad fills the target, upside down so t = 0 lands in the first row
+    // and the next stage samples it the same way up as the frame
+    QMatrix4x4 stageMvp;
+    stageMvp.ortho(VIDTEXTURE_LEFT_X, VIDTEXTURE_RIGHT_X, VIDTEXTURE_TOP_Y, VIDTEXTURE_BOT_Y, -1.0f, 1.0f);
+
+    for (int stageIx = 0; stageIx < lastStageIx; stageIx++) {
+      QGLFramebufferObject *outputFbo = m_fboPool.Acquire(frameSize);
+      if (outputFbo == NULL) {
+        stagesDone = false;
+        break;
+      }
+
+      outputFbo->bind();
+      drawVidChainStage(vidIx, stageIx, inputFbo, stageMvp, QMatrix4x4());
+
+      // Free for the stage after next, or the next vid of this size
+      if (inputFbo != NULL) {
+        m_fboPool.Release(inputFbo);
+      }
+      inputFbo = outputFbo;
+    }
+
+    glFuncs->glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (depthTest) {
+      glEnable(GL_DEPTH_TEST);
+    }
+    if (blend) {
+      glEnable(GL_BLEND);
+    }
+  }
+
+  if (stagesDone) {
+    drawVidChainStage(vidIx, lastStageIx, inputFbo, m_layout.TileMvpMatrix(vidIx), m_layout.TileMvMatrix(vidIx));
+  }
+
+  if (inputFbo != NULL) {
+    m_fboPool.Release(inputFbo);
+  }
+}
+
+// First stage converts the vid's frame, the rest sample the FBO the stage
+// before rendered into
+void
+GLWidget::drawVidChainStage(int vidIx, int stageIx, QGLFramebufferObject *inputFbo,
+                            const QMatrix4x4 &mvpMatrix, const QMatrix4x4 &mvMatrix)
+{
+  QGLShaderProgram *prog = m_vidTextures[vidIx].chainShaders[stageIx];
+
+  if (inputFbo == NULL) {
+    glActiveTexture(GL_RECT_VID_TEXTURE0);
+    glBindTexture(GL_RECT_VID_TEXTURE_2D, vidDrawTexture(vidIx));
+  }
+  else {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, inputFbo->texture());
+  }
+
+  if (m_vidTextures[vidIx].effectChain.StageUsesAlphaMask(stageIx) && m_alphaTextureLoaded) {
+    glActiveTexture(GL_RECT_TEXTURE1);
+    glBindTexture(GL_RECT_TEXTURE_2D, m_alphaTextureId);
+    glActiveTexture(GL_RECT_VID_TEXTURE0);
+  }
+
+  prog->bind();
+
+  if (inputFbo == NULL) {
+    prog->setUniformValue("u_vidTexture", 0); // texture unit index
+    prog->setUniformValue("u_yHeight", (GLfloat)m_vidTextures[vidIx].height);
+    prog->setUniformValue("u_yWidth", (GLfloat)m_vidTextures[vidIx].width);
+#ifdef TEXCOORDS_ALREADY_NORMALISED
+    prog->setUniformValue("u_texCoordScale", QVector2D(1.0f, 1.0f));
+#else
+    prog->setUniformValue("u_texCoordScale", QVector2D(m_vidTextures[vidIx].width, m_vidTextures[vidIx].height));
+#endif
+    prog->setUniformValue("u_sampleScale", vidSampleScale(vidIx));
+    YuvColourMatrix::SetUniforms(prog, m_vidTextures[vidIx].yuvCoeffs);
+  }
+  else {
+    // FBO textures are always 0..1
+    prog->setUniformValue("u_stageTexture", 0); // texture unit index
+    prog->setUniformValue("u_texelSize", QVector2D(1.0f / m_vidTextures[vidIx].width,
+                                                   1.0f / m_vidTextures[vidIx].height));
+    prog->setUniformValue("u_texCoordScale", QVector2D(1.0f, 1.0f));
+  }
+
+  // Whichever of these the stage's passes don't use just aren't there
+  prog->setUniformValue("u_colrToDisplayMin", m_colourHilightRangeMin);
+  prog->setUniformValue("u_colrToDisplayMax", m_colourHilightRangeMax);
+  prog->setUniformValue("u_componentSwapR", m_colourComponentSwapR);
+  prog->setUniformValue("u_componentSwapG", m_colourComponentSwapG);
+  prog->setUniformValue("u_componentSwapB", m_colourComponentSwapB);
+  prog->setUniformValue("u_alphaTexture", 1); // texture unit index
+#ifdef TEXCOORDS_ALREADY_NORMALISED
+  prog->setUniformValue("u_alphaTexCoordScale", QVector2D(1.0f, 1.0f));
+#else
+  prog->setUniformValue("u_alphaTexCoordScale", QVector2D(m_alphaTexWidth, m_alphaTexHeight));
+#endif
+
+  prog->setUniformValue("u_mvp_matrix", mvpMatrix);
+  prog->setUniformValue("u_mv_matrix", mvMatrix);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  printOpenGLError(__FILE__, __LINE__);
+}
+
+QGLShaderProgram *
+GLWidget::instancedVidShader(ColFormat colFormat)
+{
+  switch (colFormat) {
+#ifdef VIDI420_SHADERS_NEEDED
+  case ColFmt_I420:
+    return &m_I420NoEffectInstanced;
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+  case ColFmt_NV12:
+    return &m_NV12NoEffectInstanced;
+#endif
+  default:
+    // UYVY has no texture array conversion shader yet
+    return NULL;
+  }
+}
+
+// Draws every batchable vid, one instanced call per format/size, and marks
+// which ones were drawn so the separate path can skip them
+void
+GLWidget::drawBatchedVids(QVector<bool> &vidDrawn)
+{
+  for (int vidIx = 0; vidIx < m_vidTextures.size(); vidIx++) {
+    if (m_vidTextures[vidIx].texInfoValid && vidUsesBatch(vidIx)) {
+      vidDrawn[vidIx] = m_vidBatcher.AddInstance(vidIx, m_layout.TileMvpMatrix(vidIx));
+    }
+  }
+
+  glActiveTexture(GL_RECT_VID_TEXTURE0);
+
+  for (int batchIx = 0; batchIx < m_vidBatcher.NumBatches(); batchIx++) {
+    if (m_vidBatcher.NumInstances(batchIx) == 0) {
+      continue;
+    }
+
+    if (m_gpuTimers.IsAvailable()) {
+      m_gpuTimers.Begin(QString("vidbatch%1").arg(batchIx));
+    }
+
+    QGLShaderProgram *batchShader = instancedVidShader(m_vidBatcher.BatchColourFormat(batchIx));
+    QSize vidSize = m_vidBatcher.BatchVidSize(batchIx);
+    batchShader->bind();
+    batchShader->setUniformValue("u_vidTexture", 0); // texture unit index
+    batchShader->setUniformValue("u_yHeight", (GLfloat)vidSize.height());
+    batchShader->setUniformValue("u_yWidth", (GLfloat)vidSize.width());
+    batchShader->setUniformValue("u_texCoordScale", QVector2D(vidSize.width(), vidSize.height()));
+    // Batches are split by colorimetry too, so one set does for them all
+    YuvColourMatrix::SetUniforms(batchShader, YuvColourMatrix::Coeffs(m_vidBatcher.BatchColorimetry(batchIx),
+                                                                      vidSize.height()));
+
+    m_vidBatcher.DrawBatch(batchIx);
+    printOpenGLError(__FILE__, __LINE__);
+
+    m_gpuTimers.End();
+  }
+}
+
+// x, y, then s, t for each corner of the quad. Alpha mask texture uses the
+// same s, t, both get scaled up to texels by uniforms where needed.
+static const GLfloat VidQuadVertexData[NUM_VIDTEXTURE_VERTICES_X * NUM_VIDTEXTURE_VERTICES_Y * 4] =
+{
+  VIDTEXTURE_RIGHT_X, VIDTEXTURE_TOP_Y, 1.0f, 0.0f,
+  VIDTEXTURE_LEFT_X,  VIDTEXTURE_TOP_Y, 0.0f, 0.0f,
+  VIDTEXTURE_RIGHT_X, VIDTEXTURE_BOT_Y, 1.0f, 1.0f,
+  VIDTEXTURE_LEFT_X,  VIDTEXTURE_BOT_Y, 0.0f, 1.0f
+};
+
+void
+GLWidget::setupVidQuadGeometry()
+{
+  m_vidQuadVbo.create();
+  m_vidQuadVbo.setUsagePattern(QGLBuffer::StaticDraw);
+  m_vidQuadVbo.bind();
+  m_vidQuadVbo.allocate(VidQuadVertexData, sizeof(VidQuadVertexData));
+
+  // Attribute locations are fixed at link time for every shader, so one
+  // VAO can be shared between all of them
+  m_vidQuadVao = new QOpenGLVertexArrayObject(this);
+  if (m_vidQuadVao->create()) {
+    m_vidQuadVao->bind();
+    setVidQuadAttribPointers(true);
+    m_vidQuadVao->release();
+  }
+  else {
+    LOG(LOG_GL, Logger::Info, "No vertex array object support, setting attributes per frame");
+    delete m_vidQuadVao;
+    m_vidQuadVao = NULL;
+  }
+
+  m_vidQuadVbo.release();
+  printOpenGLError(__FILE__, __LINE__);
+}
+
+// Vid quad VBO must be bound
+void
+GLWidget::setVidQuadAttribPointers(bool enable)
+{
+  QOpenGLFunctions *glFuncs = QOpenGLContext::currentContext()->functions();
+  const int stride = 4 * sizeof(GLfloat);
+
+  if (enable) {
+    glFuncs->glVertexAttribPointer(VID_ATTRIB_VERTEX, 2, GL_FLOAT, GL_FALSE, stride, (const void *)0);
+    glFuncs->glVertexAttribPointer(VID_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, stride, (const void *)(2 * sizeof(GLfloat)));
+    glFuncs->glVertexAttribPointer(VID_ATTRIB_ALPHATEXCOORD, 2, GL_FLOAT, GL_FALSE, stride, (const void *)(2 * sizeof(GLfloat)));
+    glFuncs->glEnableVertexAttribArray(VID_ATTRIB_VERTEX);
+    glFuncs->glEnableVertexAttribArray(VID_ATTRIB_TEXCOORD);
+    glFuncs->glEnableVertexAttribArray(VID_ATTRIB_ALPHATEXCOORD);
+  }
+  else {
+    glFuncs->glDisableVertexAttribArray(VID_ATTRIB_VERTEX);
+    glFuncs->glDisableVertexAttribArray(VID_ATTRIB_TEXCOORD);
+    glFuncs->glDisableVertexAttribArray(VID_ATTRIB_ALPHATEXCOORD);
+  }
+}
+
+void
+GLWidget::bindVidQuadGeometry()
+{
+  if (m_vidQuadVao) {
+    m_vidQuadVao->bind();
+  }
+  else {
+    m_vidQuadVbo.bind();
+    setVidQuadAttribPointers(true);
+    m_vidQuadVbo.release();
+  }
+}
+
+void
+GLWidget::releaseVidQuadGeometry()
+{
+  if (m_vidQuadVao) {
+    m_vidQuadVao->release();
+  }
+  else {
+    setVidQuadAttribPointers(false);
+  }
+}
+
+void
+GLWidget::paintEvent(QPaintEvent *event)
+{
+  Q_UNUSED(event);
+
+  // Headless frames are rendered from headlessFrameSlot instead
+  if (m_headless) {
+    return;
+  }
+
+  makeCurrent();
+
+  if (m_syncStreams) {
+    pickSyncedFrames();
+  }
+
+  QElapsedTimer frameTimer;
+  frameTimer.start();
+  m_gpuTimers.BeginFrame(&m_renderStats);
+
+  renderScene();
+  // Without the overlay
+  recordFrame(m_viewportSize);
+  readBackGrabs(m_viewportSize);
+
+  if (m_gpuTimers.IsAvailable()) {
+    m_gpuTimers.Begin("overlay");
+  }
+  QPainter painter(this);
+  painter.setRenderHint(QPainter::Antialiasing);
+  painter.setRenderHint(QPainter::TextAntialiasing);
+
+  painter.endNativePainting();
+  QString framesPerSecond;
+  framesPerSecond.setNum(m_frames / (m_frameTime.elapsed() / 1000.0), 'f', 2);
+  painter.setPen(Qt::white);
+  painter.drawText(20, 40, framesPerSecond + " fps");
+  if (!m_gpuTimingText.isEmpty()) {
+    painter.drawText(20, 60, m_gpuTimingText);
+  }
+  painter.end();
+  m_gpuTimers.End();
+  m_gpuTimers.EndFrame();
+
+  // Before the swap, which can block waiting for vsync
+  m_renderStats.Timing("cpu_frame").AddSample(frameTimer.nsecsElapsed());
+
+  swapBuffers();
+
+  if (!(m_frames % 100)) {
+    m_frameTime.start();
+    m_frames = 0;
+
+    if (m_gpuTimers.IsAvailable()) {
+      updateGpuTimingText();
+    }
+  }
+  ++m_frames;
+}
+
+// Starts the GPU reading back the frame just drawn for the recording, the
+// recording starting with the first frame at the size it's drawn
+void
+GLWidget::recordFrame(const QSize &frameSize)
+{
+  if (m_recordFile.isEmpty()) {
+    return;
+  }
+
+  if (!m_recorder.IsRecording()) {
+    // Offline every frame goes in, however long that holds rendering up
+    m_recorder.SetLossless(m_offlineFps > 0);
+    if (!m_recorder.Start(context(), m_recordFile, frameSize, m_offlineFps)) {
+      // Only tried the once
+      m_recordFile.clear();
+      return;
+    }
+    m_recordTime.start();
+  }
+
+  qint64 ptsNs = (m_offlineFps > 0) ? m_offlineFrameNs : m_recordTime.nsecsElapsed();
+  m_recorder.CaptureFrame(frameSize, ptsNs);
+}
+
+int
+GLWidget::grabFrame(const QString &fileName)
+{
+  if (!m_grabReadback.IsAvailable()) {
+    makeCurrent();
+    // glReadPixels would hold up rendering, which is the one thing this
+    // mustn't do
+    if (!m_grabReadback.Init(context(), GRAB_READBACK_BUFFERS)) {
+      LOG(LOG_GL, Logger::Warning, "Can't grab frames without asynchronous readback");
+      return -1;
+    }
+  }
+
+  PendingGrab grab = { m_nextGrabId++, fileName };
+  m_frameGrabsWaiting.append(grab);
+
+  // In case nothing else is about to draw one
+  update();
+  return grab.grabId;
+}
+
+int
+GLWidget::grabVideoFrame(int vidIx, const QString &fileName)
+{
+  if ((vidIx < 0) || (vidIx >= m_vidPipelines.size()) || (m_vidPipelines[vidIx] == NULL)) {
+    return -1;
+  }
 
-      vidShader->setUniformValue("u_mvp_matrix", m_projectionMatrix * vidQuadMatrix);
-      vidShader->setUniformValue("u_mv_matrix", vidQuadMatrix);
+  PendingGrab grab = { m_nextGrabId++, fileName };
+  m_videoGrabsWaiting[vidIx].append(grab);
+  return grab.grabId;
+}
 
-      // Need to set these arrays up here as shader instances are shared between
-      // all the videos:
-      vidShader->enableAttributeArray("a_texCoord");
-      vidShader->setAttributeArray("a_texCoord", m_vidTextures[vidIx].triStripTexCoords);
+// Starts reading back the frame just drawn for any composited grabs
+// waiting for one
+void
+GLWidget::readBackGrabs(const QSize &frameSize)
+{
+  if (m_frameGrabsWaiting.isEmpty()) {
+    return;
+  }
+
+  // Left for the next frame if both buffers are still being read into
+  if (m_grabReadback.Start(frameSize, 0)) {
+    m_frameGrabsReading.append(m_frameGrabsWaiting);
+    m_frameGrabsWaiting.clear();
+    QTimer::singleShot(GRAB_POLL_MS, this, SLOT(collectGrabsSlot()));
+  }
+}
+
+// Hands finished readbacks over to be converted, checking again shortly
+// for any that aren't
+void
+GLWidget::collectGrabsSlot()
+{
+  if (m_frameGrabsReading.isEmpty()) {
+    return;
+  }
+
+  makeCurrent();
+  while (m_grabReadback.NumPending() > 0) {
+    int numPending = m_grabReadback.NumPending();
+    QSize size;
+    GstBuffer *buf = m_grabReadback.TakeFinished(false, &size);
+    if (m_grabReadback.NumPending() == numPending) {
+      QTimer::singleShot(GRAB_POLL_MS, this, SLOT(collectGrabsSlot()));
+      return;
+    }
 
-      if (m_vidTextures[vidIx].effect == VidShaderAlphaMask) {
-        vidShader->enableAttributeArray("a_alphaTexCoord");
-        vidShader->setAttributeArray("a_alphaTexCoord", m_vidTextures[vidIx].triStripAlphaTexCoords);
+    QList<PendingGrab> grabs = m_frameGrabsReading.takeFirst();
+    for (int grabIx = 0; grabIx < grabs.size(); grabIx++) {
+      if (buf) {
+        gst_buffer_ref(buf);
+        startGrabTask(new FrameGrabTask(grabs[grabIx].grabId, buf, size, grabs[grabIx].fileName));
       }
+      else {
+        emit frameGrabbed(grabs[grabIx].grabId, QImage());
+      }
+    }
+    if (buf) {
+      gst_buffer_unref(buf);
+    }
+  }
+}
+
+// buf is the vid's new frame, just taken from its pipeline
+void
+GLWidget::grabVideoBuffer(int vidIx, void *buf)
+{
+  Pipeline *pipeline = m_vidPipelines[vidIx];
+  QSize size(pipeline->getWidth(), pipeline->getHeight());
+  QList<PendingGrab> grabs = m_videoGrabsWaiting.take(vidIx);
+
+  for (int grabIx = 0; grabIx < grabs.size(); grabIx++) {
+    // Reffed rather than copied, it's converted on the grab thread
+    gst_buffer_ref((GstBuffer *)buf);
+    startGrabTask(new FrameGrabTask(grabs[grabIx].grabId, (GstBuffer *)buf, size, pipeline->getColourFormat(),
+                                    pipeline->getColorimetry(), grabs[grabIx].fileName));
+  }
+}
+
+void
+GLWidget::startGrabTask(FrameGrabTask *task)
+{
+  // Queued, finished is emitted on the grab thread
+  QObject::connect(task, SIGNAL(finished(int, const QImage &)), this, SIGNAL(frameGrabbed(int, const QImage &)));
+  m_grabPool.start(task);
+}
 
-      vidShader->enableAttributeArray("a_vertex");
-      vidShader->setAttributeArray("a_vertex", m_vidTextures[vidIx].triStripVertices);
+// Summary of mean GPU pass times for the overlay, only updated now and then
+void
+GLWidget::updateGpuTimingText()
+{
+  m_gpuTimingText = "gpu ms:";
 
-      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  QStringList timingNames = m_renderStats.TimingNames();
+  for (int nameIx = 0; nameIx < timingNames.size(); nameIx++) {
+    if (timingNames[nameIx].startsWith("gpu_")) {
+      qint64 meanNs = m_renderStats.Timing(timingNames[nameIx]).Mean();
+      m_gpuTimingText += QString(" %1=%2").arg(timingNames[nameIx].mid(4)).arg(meanNs / 1000000.0, 0, 'f', 2);
+    }
+  }
+}
 
-      vidShader->disableAttributeArray("a_vertex");
-      if (m_vidTextures[vidIx].effect == VidShaderAlphaMask) {
-        vidShader->disableAttributeArray("a_alphaTexCoord");
+void
+GLWidget::startHeadless()
+{
+  // Widget needs to be "shown" to get a GL context, but never appears
+  setAttribute(Qt::WA_DontShowOnScreen);
+  resize(m_headlessSize);
+  show();
+
+  m_headlessTimer = new QTimer(this);
+  connect(m_headlessTimer, SIGNAL(timeout()), this, SLOT(headlessFrameSlot()));
+  // Zero interval so new frames and pipeline events get handled between renders
+  m_headlessTimer->start(0);
+}
+
+void
+GLWidget::headlessFrameSlot()
+{
+  if (m_closing) {
+    return;
+  }
+
+  if (!isValid()) {
+    LOG(LOG_GL, Logger::Error, "No valid GL context for headless rendering");
+    m_headlessTimer->stop();
+    close();
+    return;
+  }
+
+  makeCurrent();
+
+  // Make sure initializeGL has run before the first frame
+  if (m_model == NULL) {
+    glInit();
+  }
+
+  if ((m_headlessFbo == NULL) && QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+    m_headlessFbo = new QGLFramebufferObject(m_headlessSize, QGLFramebufferObject::Depth);
+    LOG(LOG_GL, Logger::Info, "Headless rendering to %dx%d FBO",
+        m_headlessSize.width(), m_headlessSize.height());
+  }
+
+  if (m_headlessFramesDone == 0) {
+    if (m_headlessFbo == NULL) {
+      LOG(LOG_GL, Logger::Warning, "No FBO support, headless rendering to hidden window back buffer");
+    }
+    m_headlessWallTime.start();
+  }
+
+  if (m_offlineFps > 0) {
+    m_offlineFrameNs = (qint64)m_headlessFramesDone * 1000000000LL / m_offlineFps;
+
+    bool anyVids = false;
+    for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
+      anyVids = anyVids || (m_vidPipelines[vidIx] != NULL);
+    }
+    if (!anyVids) {
+      finishHeadless();
+      return;
+    }
+
+    // Picked up again by newFrame or pipelineFinished
+    if (((m_offlineStartNs < 0) && !findOfflineStart()) ||
+        !pickOfflineFrames(m_offlineStartNs + m_offlineFrameNs)) {
+      m_headlessTimer->stop();
+      m_offlineWaiting = true;
+      return;
+    }
+  }
+  else if (m_syncStreams) {
+    pickSyncedFrames();
+  }
+
+  QElapsedTimer frameTimer;
+  frameTimer.start();
+
+  if (m_headlessFbo) {
+    m_headlessFbo->bind();
+  }
+  glViewport(0, 0, m_headlessSize.width(), m_headlessSize.height());
+
+  m_gpuTimers.BeginFrame(&m_renderStats);
+  renderScene();
+  recordFrame(m_headlessSize);
+  readBackGrabs(m_headlessSize);
+  m_gpuTimers.EndFrame();
+
+  // Wait for the GPU so the time covers the whole frame, not just submission.
+  // Offline it's throughput that matters, so the GPU is left to get on with it.
+  if (m_offlineFps == 0) {
+    glFinish();
+  }
+
+  if (m_headlessFbo) {
+    m_headlessFbo->release();
+  }
+
+  // Without the wait it's only how long the frame took to submit, so it's
+  // reported under its own name rather than passed off as the frame time
+  m_renderStats.Timing((m_offlineFps == 0) ? "cpu_frame" : "cpu_submit").AddSample(frameTimer.nsecsElapsed());
+  printOpenGLError(__FILE__, __LINE__);
+
+  // Latency from when each newly shown video frame was due, to it being drawn
+  for (int vidIx = 0; vidIx < m_vidTextures.size(); vidIx++) {
+    if (m_vidTextures[vidIx].newSinceRender && m_vidPipelines[vidIx]) {
+      // Offline frames aren't due at any particular time
+      qint64 ageNs = (m_offlineFps > 0) ? -1 : m_vidPipelines[vidIx]->getBufferAgeNs(m_vidTextures[vidIx].buffer);
+      if (ageNs >= 0) {
+        m_renderStats.Timing("frame_latency").AddSample(ageNs);
       }
-      vidShader->disableAttributeArray("a_texCoord");
+      m_vidTextures[vidIx].newSinceRender = false;
     }
   }
 
-  QPainter painter(this);
-  painter.setRenderHint(QPainter::Antialiasing);
-  painter.setRenderHint(QPainter::TextAntialiasing);
+  animate();
+
+  // Offline runs to the end of the videos if no frame count was given
+  if ((++m_headlessFramesDone >= m_headlessFrames) && (m_headlessFrames > 0)) {
+    finishHeadless();
+  }
+}
+
+void
+GLWidget::finishHeadless()
+{
+  m_headlessTimer->stop();
+  // Counts are only final once the recording is finished
+  m_recorder.Stop();
+  reportHeadlessResults();
+  close();
+}
+
+void
+GLWidget::reportHeadlessResults()
+{
+  qint64 wallNs = m_headlessWallTime.nsecsElapsed();
+  qreal wallSecs = wallNs / 1000000000.0;
+
+  quint64 totalUploaded = 0;
+  for (int vidIx = 0; vidIx < m_vidTextures.size(); vidIx++) {
+    totalUploaded += m_vidTextures[vidIx].framesUploaded;
+  }
+
+  m_renderStats.SetCounter("frames", m_headlessFramesDone);
+  m_renderStats.SetCounter("wall_time_ms", wallNs / 1000000);
+  m_renderStats.SetCounter("video_frames_uploaded", totalUploaded);
+  m_texturePool.ReportStats(m_renderStats);
+  m_deinterlacer.ReportStats(m_renderStats);
+  m_fboPool.ReportStats(m_renderStats);
+  if (!m_recordFile.isEmpty()) {
+    m_recorder.ReportStats(m_renderStats);
+  }
+  if (m_colourLut.IsAvailable()) {
+    m_colourLut.ReportStats(m_renderStats);
+  }
+  if (m_pboPool) {
+    m_pboPool->ReportStats(m_renderStats);
+  }
+  m_renderStats.SetCounter("vidbatch_bytes_allocated", m_vidBatcher.BytesAllocated());
+  m_renderStats.AddProcessCounters();
+
+  std::cout << "Headless render of " << m_headlessFramesDone << " frames at "
+            << m_headlessSize.width() << "x" << m_headlessSize.height() << ", "
+            << m_vidPipelines.size() << " videos: "
+            << (m_headlessFramesDone / wallSecs) << " fps, "
+            << (totalUploaded / wallSecs) << " video frames/s\n";
+  if (m_offlineFps > 0) {
+    std::cout << "Offline at " << m_offlineFps << " fps, "
+              << ((qreal)m_headlessFramesDone / m_offlineFps / wallSecs) << " times real time\n";
+  }
+  std::cout << m_renderStats.ReportText().toUtf8().constData();
+
+  if (!m_benchOutputFile.isEmpty()) {
+    QJsonObject results = m_renderStats.ReportJson();
 
-  painter.endNativePainting();
-  QString framesPerSecond;
-  framesPerSecond.setNum(m_frames / (m_frameTime.elapsed() / 1000.0), 'f', 2);
-  painter.setPen(Qt::white);
-  painter.drawText(20, 40, framesPerSecond + " fps");
-  painter.end();
-  swapBuffers();
+    QJsonArray videoLocations;
+    for (int vidIx = 0; vidIx < m_videoLoc.size(); vidIx++) {
+      videoLocations.append(m_videoLoc[vidIx]);
+    }
+    results["videos"] = videoLocations;
+    results["width"] = m_headlessSize.width();
+    results["height"] = m_headlessSize.height();
+    results["render_fps"] = m_headlessFramesDone / wallSecs;
+    results["video_fps"] = totalUploaded / wallSecs;
+    if (m_offlineFps > 0) {
+      results["offline_fps"] = m_offlineFps;
+      results["realtime_factor"] = (qreal)m_headlessFramesDone / m_offlineFps / wallSecs;
+    }
 
-  if (!(m_frames % 100)) {
-    m_frameTime.start();
-    m_frames = 0;
+    QFile outFile(m_benchOutputFile);
+    if (outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      outFile.write(QJsonDocument(results).toJson());
+    }
+    else {
+      LOG(LOG_GL, Logger::Error, "Couldn't write bench results to %s", m_benchOutputFile.toUtf8().constData());
+    }
   }
-  ++m_frames;
 }
 
 void
@@ -375,6 +1381,7 @@ GLWidget::resizeGL(int wid, int ht)
   float aspect = (float)wid / (float)ht;
 
   glViewport(0, 0, wid, ht);
+  m_viewportSize = QSize(wid, ht);
 
   m_projectionMatrix = QMatrix4x4();
   m_projectionMatrix.frustum(-vp, vp, -vp / aspect, vp / aspect, 1.0, 50.0);
@@ -383,102 +1390,290 @@ GLWidget::resizeGL(int wid, int ht)
 void
 GLWidget::newFrame(int vidIx)
 {
-  if (m_vidPipelines[vidIx]) {
-    LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d frame %d", vidIx, m_vidTextures[vidIx].frameCount++);
+  // Synced frames are picked by PTS when the next frame is rendered
+  if (m_vidPipelines[vidIx] && !m_syncStreams) {
+    void *newBuf = NULL;
+    m_vidPipelines[vidIx]->m_incomingBufQueue.get(&newBuf);
+    showFrame(vidIx, newBuf);
+  }
 
-    Pipeline *pipeline = m_vidPipelines[vidIx];
+  resumeOffline();
+}
 
-    // If we have a vid frame currently, return it back to the video system
-    if (m_vidTextures[vidIx].buffer) {
-      pipeline->m_outgoingBufQueue.put(m_vidTextures[vidIx].buffer);
-      LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d pushed buffer %p to outgoing queue",
-          vidIx, m_vidTextures[vidIx].buffer);
+// For each synced vid, show the latest frame due by now. Older ones which
+// were never shown go straight back, so every stream shows the frame for
+// the same moment.
+void
+GLWidget::pickSyncedFrames()
+{
+  for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
+    if (m_vidPipelines[vidIx]) {
+      pickFramesDueBy(vidIx, m_vidPipelines[vidIx]->getRunningTimeNs());
     }
+  }
+}
 
-    void *newBuf = NULL;
-    if (pipeline->m_incomingBufQueue.get(&newBuf) == true) {
-      m_vidTextures[vidIx].buffer = newBuf;
+// Shows the vid's latest frame due by targetNs, if there's a new one.
+// Returns true if a later frame is already queued, so the one shown is
+// definitely the right one.
+bool
+GLWidget::pickFramesDueBy(int vidIx, qint64 targetNs)
+{
+  Pipeline *pipeline = m_vidPipelines[vidIx];
+  void *pickedBuf = NULL;
+  void *nextBuf;
+  while (pipeline->m_incomingBufQueue.peek(&nextBuf) &&
+         (pipeline->getBufferRunningTimeNs(nextBuf) <= targetNs)) {
+    pipeline->m_incomingBufQueue.get(&nextBuf);
+
+    if (pickedBuf) {
+      // Format changes still have to be seen in order
+      if (pipeline->takeFormatChange(pickedBuf)) {
+        m_vidTextures[vidIx].texInfoValid = false;
+      }
+      pipeline->m_outgoingBufQueue.put(pickedBuf);
+      m_renderStats.AddToCounter("sync_frames_skipped", 1);
     }
-    else {
-      m_vidTextures[vidIx].buffer = NULL;
-      return;
+    pickedBuf = nextBuf;
+  }
+
+  if (pickedBuf) {
+    showFrame(vidIx, pickedBuf);
+  }
+
+  return pipeline->m_incomingBufQueue.size() > 0;
+}
+
+// Output starts at the earliest first frame of any stream, so a running
+// time that doesn't start at 0 neither holds everything up nor has a
+// stream's frames all come out at once. Returns false until every stream
+// still going has a frame queued.
+bool
+GLWidget::findOfflineStart()
+{
+  qint64 startNs = -1;
+  for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
+    Pipeline *pipeline = m_vidPipelines[vidIx];
+    void *firstBuf;
+    if (pipeline == NULL) {
+      continue;
+    }
+    if (!pipeline->m_incomingBufQueue.peek(&firstBuf)) {
+      if (!pipeline->isFinished()) {
+        return false;
+      }
+      continue;
     }
 
-    LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d popped buffer %p from incoming queue",
-        vidIx, m_vidTextures[vidIx].buffer);
+    qint64 runningTimeNs = pipeline->getBufferRunningTimeNs(firstBuf);
+    if ((runningTimeNs >= 0) && ((startNs < 0) || (runningTimeNs < startNs))) {
+      startNs = runningTimeNs;
+    }
+  }
 
-    makeCurrent();
+  m_offlineStartNs = qMax(startNs, (qint64)0);
+  LOG(LOG_GL, Logger::Debug1, "Offline timeline starts at running time %lld ns", m_offlineStartNs);
+  return true;
+}
+
+// Offline there's no clock to go by, so each output frame waits until
+// every stream has decoded past it. Returns false if any are still
+// decoding up to it, frames picked so far are kept.
+bool
+GLWidget::pickOfflineFrames(qint64 targetNs)
+{
+  bool allReady = true;
+  for (int vidIx = 0; vidIx < m_vidPipelines.size(); vidIx++) {
+    Pipeline *pipeline = m_vidPipelines[vidIx];
+    if (pipeline && !pickFramesDueBy(vidIx, targetNs) && !pipeline->isFinished()) {
+      allReady = false;
+    }
+  }
+  return allReady;
+}
+
+void
+GLWidget::resumeOffline()
+{
+  if (m_offlineWaiting && !m_closing) {
+    m_offlineWaiting = false;
+    m_headlessTimer->start(0);
+  }
+}
 
-    // Load the gst buf into a texture
-    if (m_vidTextures[vidIx].texInfoValid == false) {
-      LOG(LOG_VIDPIPELINE, Logger::Debug2, "Setting up texture info for vid %d", vidIx);
+// newBuf is taken from the vid's incoming queue, or NULL if there wasn't one
+void
+GLWidget::showFrame(int vidIx, void *newBuf)
+{
+  // Keep the increment out of LOG, its arguments aren't evaluated when disabled
+  m_vidTextures[vidIx].frameCount++;
+  LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d frame %d", vidIx, m_vidTextures[vidIx].frameCount);
 
-      // Try and keep this fairly portable to other media frameworks by
-      // leaving info extraction within pipeline class
-      m_vidTextures[vidIx].width = pipeline->getWidth();
-      m_vidTextures[vidIx].height = pipeline->getHeight();
-      m_vidTextures[vidIx].colourFormat = pipeline->getColourFormat();
-//    m_vidTextures[vidIx].texInfoValid = true;
+  Pipeline *pipeline = m_vidPipelines[vidIx];
 
-      setAppropriateVidShader(vidIx);
+  // If we have a vid frame currently, return it back to the video system
+  if (m_vidTextures[vidIx].buffer) {
+    releaseVidBuffer(pipeline, m_vidTextures[vidIx].buffer);
+    LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d released buffer %p", vidIx, m_vidTextures[vidIx].buffer);
+  }
 
-      m_vidTextures[vidIx].shader->bind();
-      printOpenGLError(__FILE__, __LINE__);
-      // Setting shader variables here will have no effect as they are set on every render,
-      // but do it to check for errors, so we don't need to check on every render
-      // and program output doesn't go mad
-      setVidShaderVars(vidIx, true);
+  if (newBuf) {
+    m_vidTextures[vidIx].buffer = newBuf;
 
-#ifdef TEXCOORDS_ALREADY_NORMALISED
-      GLfloat vidWidth = 1.0f;
-      GLfloat vidHeight = 1.0f;
-#else
-      GLfloat vidWidth = m_vidTextures[vidIx].width;
-      GLfloat vidHeight = m_vidTextures[vidIx].height;
-#endif
+    // Texture, shader and texcoords are set up again in place if frames are
+    // a different size or format from here on
+    if (pipeline->takeFormatChange(newBuf)) {
+      m_vidTextures[vidIx].texInfoValid = false;
+    }
+
+    if (m_videoGrabsWaiting.contains(vidIx)) {
+      grabVideoBuffer(vidIx, newBuf);
+    }
+  }
+  else {
+    m_vidTextures[vidIx].buffer = NULL;
+    return;
+  }
+
+  LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d popped buffer %p from incoming queue",
+      vidIx, m_vidTextures[vidIx].buffer);
 
-      m_vidTextures[vidIx].triStripTexCoords[0]      = QVector2D(vidWidth, 0.0f);
-      m_vidTextures[vidIx].triStripVertices[0]       = QVector2D(VIDTEXTURE_RIGHT_X, VIDTEXTURE_TOP_Y);
+  makeCurrent();
+
+  // Load the gst buf into a texture
+  if (m_vidTextures[vidIx].texInfoValid == false) {
+    LOG(LOG_VIDPIPELINE, Logger::Debug2, "Setting up texture info for vid %d", vidIx);
+
+    // Old size texture goes back for whoever wants that size next. The
+    // upload thread's textures are swapped over by ConfigureVid below.
+    if (!m_asyncUploader.IsAvailable() && m_texturePool.Release(m_vidTextures[vidIx].texId)) {
+      m_vidTextures[vidIx].texId = 0;
+    }
+    m_deinterlacer.RemoveVid(vidIx);
+    m_vidTextures[vidIx].deinterlacedTexId = 0;
+
+    // Try and keep this fairly portable to other media frameworks by
+    // leaving info extraction within pipeline class
+    m_vidTextures[vidIx].width = pipeline->getWidth();
+    m_vidTextures[vidIx].height = pipeline->getHeight();
+    m_vidTextures[vidIx].colourFormat = pipeline->getColourFormat();
+    m_vidTextures[vidIx].colorimetry = pipeline->getColorimetry();
+    m_vidTextures[vidIx].yuvCoeffs = YuvColourMatrix::Coeffs(m_vidTextures[vidIx].colorimetry,
+                                                             m_vidTextures[vidIx].height);
+    LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d colour matrix %s%s, %s range", vidIx,
+        YuvColourMatrix::MatrixName(m_vidTextures[vidIx].colorimetry.matrix),
+        (m_vidTextures[vidIx].colorimetry.matrix == ColMatrix_Unknown) ? " (guessed from size)" : "",
+        m_vidTextures[vidIx].colorimetry.fullRange ? "full" : "limited");
+//  m_vidTextures[vidIx].texInfoValid = true;
+
+    setAppropriateVidShader(vidIx);
+    // Before the first upload, chains keep vids out of the batches
+    setupVidChainShaders(vidIx);
+
+    m_vidTextures[vidIx].shader->bind();
+    printOpenGLError(__FILE__, __LINE__);
+    // Setting shader variables here will have no effect as they are set on every render,
+    // but do it to check for errors, so we don't need to check on every render
+    // and program output doesn't go mad
+    setVidShaderVars(vidIx, true);
+
+    // Importing saves more than batching would, so those vids aren't batched.
+    // Nor are interlaced ones, the pass needs a texture of their own. Mixed
+    // streams count whatever this frame is, it's decided per frame on upload.
+    GLint internalFormat;
+    GLenum type;
+    vidTextureFormat(vidIx, internalFormat, type);
+    m_vidTextures[vidIx].dmabufImport = (type == GL_UNSIGNED_BYTE) && m_dmabufImporter.CanImport(newBuf);
+    m_vidTextures[vidIx].interlaced = m_deinterlacer.IsAvailable() &&
+                                      (pipeline->getInterlacing().mode != Interlace_Progressive);
+
+    if (m_vidBatcher.IsAvailable() && instancedVidShader(m_vidTextures[vidIx].colourFormat) &&
+        !m_vidTextures[vidIx].dmabufImport && !m_vidTextures[vidIx].interlaced) {
+      m_vidBatcher.AddVid(vidIx, m_vidTextures[vidIx].colourFormat, m_vidTextures[vidIx].colorimetry,
+                          m_vidTextures[vidIx].width, m_vidTextures[vidIx].height);
+    }
+    else {
+      m_vidBatcher.RemoveVid(vidIx);
+    }
 
-      m_vidTextures[vidIx].triStripTexCoords[1]      = QVector2D(0.0f, 0.0f);
-      m_vidTextures[vidIx].triStripVertices[1]       = QVector2D(VIDTEXTURE_LEFT_X, VIDTEXTURE_TOP_Y);
+    if (m_asyncUploader.IsAvailable()) {
+      int texWidth, texHeight;
+      QList<void *> droppedBufs;
+      GLint internalFormat;
+      GLenum type;
+      vidTextureFormat(vidIx, internalFormat, type);
+      bool configured = vidTextureSize(vidIx, texWidth, texHeight) &&
+                        m_asyncUploader.ConfigureVid(vidIx, internalFormat, GL_LUMINANCE, type,
+                                                     texWidth, texHeight, droppedBufs);
+      for (int bufIx = 0; bufIx < droppedBufs.size(); bufIx++) {
+        pipeline->m_outgoingBufQueue.put(droppedBufs[bufIx]);
+      }
+
+      // Not drawn until the first frame has been uploaded
+      m_vidTextures[vidIx].texId = 0;
+      m_vidTextures[vidIx].texInfoValid = configured;
+      if (!configured) {
+        return;
+      }
+    }
+  }
 
-      m_vidTextures[vidIx].triStripTexCoords[2]      = QVector2D(vidWidth, vidHeight);
-      m_vidTextures[vidIx].triStripVertices[2]       = QVector2D(VIDTEXTURE_RIGHT_X, VIDTEXTURE_BOT_Y);
+  // Hidden quads keep showing their last frame, must have one first though
+  if (m_throttleHidden && m_vidTextures[vidIx].texInfoValid && !m_vidTextures[vidIx].visible) {
+    m_renderStats.AddToCounter("uploads_skipped_hidden", 1);
+    return;
+  }
 
-      m_vidTextures[vidIx].triStripTexCoords[3]      = QVector2D(0.0f, vidHeight);
-      m_vidTextures[vidIx].triStripVertices[3]       = QVector2D(VIDTEXTURE_LEFT_X, VIDTEXTURE_BOT_Y);
+  if (m_asyncUploader.IsAvailable()) {
+    // asyncUploadReadySlot swaps the texture in once it's uploaded
+    void *droppedBuf;
+    m_asyncUploader.Submit(vidIx, m_vidTextures[vidIx].buffer, &droppedBuf);
+    m_vidTextures[vidIx].buffer = NULL;
+    if (droppedBuf) {
+      pipeline->m_outgoingBufQueue.put(droppedBuf);
+      m_renderStats.AddToCounter("async_uploads_dropped", 1);
     }
+    return;
+  }
 
-    m_vidTextures[vidIx].texInfoValid = loadNewTexture(vidIx);
+  m_vidTextures[vidIx].texInfoValid = loadNewTexture(vidIx);
+  if (m_vidTextures[vidIx].texInfoValid) {
+    if (m_vidTextures[vidIx].interlaced) {
+      deinterlaceFrame(vidIx);
+    }
+    m_vidTextures[vidIx].framesUploaded++;
+    m_vidTextures[vidIx].newSinceRender = true;
+  }
 
 #ifdef ENABLE_YUV_WINDOW
-    if ((vidIx == 0) && (m_yuvWindow->isVisible())) {
-      QImage yuvImage;
-      GstMapInfo info;
-      switch (m_vidTextures[vidIx].colourFormat) {
-      case ColFmt_I420:
-      case ColFmt_NV12:
-      default:
-        if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
-          yuvImage = QImage(info.data, m_vidTextures[vidIx].width, m_vidTextures[vidIx].height*1.5f, QImage::Format_Indexed8);
-          gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
-        }
-        break;
-      case ColFmt_UYVY:
-        if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
-          yuvImage = QImage(info.data, m_vidTextures[vidIx].width*2, m_vidTextures[vidIx].height, QImage::Format_Indexed8);
-          gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
-        }
-        break;
+  if ((vidIx == 0) && (m_yuvWindow->isVisible())) {
+    QImage yuvImage;
+    GstMapInfo info;
+    switch (m_vidTextures[vidIx].colourFormat) {
+    case ColFmt_I420:
+    case ColFmt_NV12:
+    default:
+      if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
+        yuvImage = QImage(info.data, m_vidTextures[vidIx].width, m_vidTextures[vidIx].height*1.5f, QImage::Format_Indexed8);
+        gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
+      }
+      break;
+    case ColFmt_UYVY:
+      if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
+        yuvImage = QImage(info.data, m_vidTextures[vidIx].width*2, m_vidTextures[vidIx].height, QImage::Format_Indexed8);
+        gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
       }
-      yuvImage.setColorTable(m_colourMap);
-      m_yuvWindow->m_imageLabel->setPixmap(QPixmap::fromImage(yuvImage));
+      break;
     }
+    yuvImage.setColorTable(m_colourMap);
+    m_yuvWindow->m_imageLabel->setPixmap(QPixmap::fromImage(yuvImage));
+  }
 #endif
 
-    printOpenGLError(__FILE__, __LINE__);
+  printOpenGLError(__FILE__, __LINE__);
 
+  // Synced frames are picked just before rendering, so it's already coming
+  if (!m_syncStreams) {
     update();
   }
 }
@@ -487,43 +1682,281 @@ bool
 GLWidget::loadNewTexture(int vidIx)
 {
   bool texLoaded = false;
+  GstMapInfo info;
+  const void *pboPixels;
+
+  // Batched vids only go into their texture array layer
+  if (vidUsesBatch(vidIx)) {
+    if (m_pboPool && m_pboPool->BeginUpload(m_vidTextures[vidIx].buffer, &pboPixels)) {
+      texLoaded = m_vidBatcher.Upload(vidIx, pboPixels);
+      m_pboPool->EndUpload(m_vidTextures[vidIx].buffer);
+    }
+    else if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
+      texLoaded = m_vidBatcher.Upload(vidIx, info.data);
+      gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
+    }
+    return texLoaded;
+  }
+  m_vidBatcher.InvalidateLayer(vidIx);
+
+  int texWidth, texHeight;
+  if (!vidTextureSize(vidIx, texWidth, texHeight)) {
+    return false;
+  }
+
+  if (m_vidTextures[vidIx].dmabufImport) {
+    // Import copies need an R8 texture, not luminance
+    if (m_vidTextures[vidIx].texId == 0) {
+      m_vidTextures[vidIx].texId = m_texturePool.Acquire(GL_R8, GL_RED, GL_UNSIGNED_BYTE, texWidth, texHeight);
+    }
+    if ((m_vidTextures[vidIx].texId != 0) &&
+        m_dmabufImporter.Import(m_vidTextures[vidIx].buffer, m_vidTextures[vidIx].texId,
+                                GL_RECT_VID_TEXTURE_2D, texWidth, texHeight)) {
+      m_renderStats.AddToCounter("dmabuf_imports", 1);
+      return true;
+    }
+
+    // Copy this stream's frames from now on rather than fail every time
+    LOG(LOG_GL, Logger::Info, "vid %d frames can't be imported, copying them instead", vidIx);
+    m_renderStats.AddToCounter("dmabuf_import_failures", 1);
+    m_vidTextures[vidIx].dmabufImport = false;
+    if (m_texturePool.Release(m_vidTextures[vidIx].texId)) {
+      m_vidTextures[vidIx].texId = 0;
+    }
+  }
+
+  GLint internalFormat;
+  GLenum type;
+  vidTextureFormat(vidIx, internalFormat, type);
+
+  // Storage is allocated once per texture by the pool, not every frame
+  if (m_vidTextures[vidIx].texId == 0) {
+    m_vidTextures[vidIx].texId = m_texturePool.Acquire(internalFormat, GL_LUMINANCE, type,
+                                                       texWidth, texHeight);
+    if (m_vidTextures[vidIx].texId == 0) {
+      return false;
+    }
+  }
 
   glBindTexture(GL_RECT_VID_TEXTURE_2D, m_vidTextures[vidIx].texId);
 
-  GstMapInfo info;
+  // Decoded straight into the pixel buffer, the GPU copies it from there
+  if (m_pboPool && m_pboPool->BeginUpload(m_vidTextures[vidIx].buffer, &pboPixels)) {
+    glTexSubImage2D(GL_RECT_VID_TEXTURE_2D, 0, 0, 0, texWidth, texHeight,
+                    GL_LUMINANCE, type, pboPixels);
+    m_pboPool->EndUpload(m_vidTextures[vidIx].buffer);
+    texLoaded = true;
+  }
+  else if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
+    glTexSubImage2D(GL_RECT_VID_TEXTURE_2D, 0, 0, 0, texWidth, texHeight,
+                    GL_LUMINANCE, type, info.data);
+    gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
+    texLoaded = true;
+  }
+
+  return texLoaded;
+}
 
+// Frames go into a single channel texture, planes one after the other
+bool
+GLWidget::vidTextureSize(int vidIx, int &texWidth, int &texHeight)
+{
   switch (m_vidTextures[vidIx].colourFormat) {
   case ColFmt_I420:
   case ColFmt_NV12:
-    if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
-      glTexImage2D(GL_RECT_VID_TEXTURE_2D, 0, GL_LUMINANCE,
-                   m_vidTextures[vidIx].width, m_vidTextures[vidIx].height*1.5f,
-                   0, GL_LUMINANCE, GL_UNSIGNED_BYTE, info.data);
-      gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
-      texLoaded = true;
-    }
-    break;
+#ifdef GL_LUMINANCE16
+  case ColFmt_I420_10LE:
+  case ColFmt_P010:
+#endif
+    texWidth = m_vidTextures[vidIx].width;
+    texHeight = m_vidTextures[vidIx].height*1.5f;
+    return true;
   case ColFmt_UYVY:
-    if (gst_buffer_map((GstBuffer *)m_vidTextures[vidIx].buffer, &info, GST_MAP_READ)) {
-      glTexImage2D(GL_RECT_VID_TEXTURE_2D, 0, GL_LUMINANCE,
-                   m_vidTextures[vidIx].width*2, m_vidTextures[vidIx].height,
-                   0, GL_LUMINANCE, GL_UNSIGNED_BYTE, info.data);
-      gst_buffer_unmap((GstBuffer *)m_vidTextures[vidIx].buffer, &info);
-      texLoaded = true;
-    }
-    break;
+    texWidth = m_vidTextures[vidIx].width*2;
+    texHeight = m_vidTextures[vidIx].height;
+    return true;
   default:
     LOG(LOG_GL, Logger::Error, "Decide how to load texture for colour format %d", m_vidTextures[vidIx].colourFormat);
+    return false;
+  }
+}
+
+// 10 bit formats are uploaded as they are into 16 bit textures, rather than
+// being converted down to 8 bits on the CPU
+void
+GLWidget::vidTextureFormat(int vidIx, GLint &internalFormat, GLenum &type)
+{
+  switch (m_vidTextures[vidIx].colourFormat) {
+#ifdef GL_LUMINANCE16
+  case ColFmt_I420_10LE:
+  case ColFmt_P010:
+    internalFormat = GL_LUMINANCE16;
+    type = GL_UNSIGNED_SHORT;
     break;
+#endif
+  default:
+    internalFormat = GL_LUMINANCE;
+    type = GL_UNSIGNED_BYTE;
+    break;
+  }
+}
+
+// Conversion shaders multiply samples by this to get back to 0..1. P010's
+// values are in the top 10 bits so are already as good as there.
+GLfloat
+GLWidget::vidSampleScale(int vidIx)
+{
+  if (m_vidTextures[vidIx].colourFormat == ColFmt_I420_10LE) {
+    return 65535.0f / 1023.0f;
   }
+  return 1.0f;
+}
 
-  return texLoaded;
+// Deinterlaced frames are drawn from the pass's output, anything else
+// straight from what was uploaded
+GLuint
+GLWidget::vidDrawTexture(int vidIx)
+{
+  if (m_vidTextures[vidIx].deinterlacedTexId != 0) {
+    return m_vidTextures[vidIx].deinterlacedTexId;
+  }
+  return m_vidTextures[vidIx].texId;
+}
+
+// Frame has just been uploaded. Mixed streams have progressive frames in
+// among the interlaced ones, those are drawn as they are.
+void
+GLWidget::deinterlaceFrame(int vidIx)
+{
+  FieldOrder fieldOrder = m_vidPipelines[vidIx]->getBufferFieldOrder(m_vidTextures[vidIx].buffer);
+  int texWidth, texHeight;
+  if ((fieldOrder == Fields_Progressive) || !vidTextureSize(vidIx, texWidth, texHeight)) {
+    m_vidTextures[vidIx].deinterlacedTexId = 0;
+    return;
+  }
+
+  m_vidTextures[vidIx].deinterlacedTexId =
+      m_deinterlacer.Process(vidIx, m_vidTextures[vidIx].texId, m_vidTextures[vidIx].colourFormat,
+                             m_vidTextures[vidIx].width, m_vidTextures[vidIx].height,
+                             texWidth, texHeight, fieldOrder == Fields_TopFirst);
+}
+
+// Decoder mustn't write over a frame before the GPU has read it, so one
+// still being uploaded waits on the pending list rather than holding up
+// rendering
+void
+GLWidget::releaseVidBuffer(Pipeline *pipeline, void *buf)
+{
+  if (m_pboPool) {
+    makeCurrent();
+  }
+  if (m_pboPool && !m_pboPool->IsUploaded(buf)) {
+    PendingRelease release = { pipeline, buf };
+    m_pendingReleases.append(release);
+    if (m_pendingReleases.size() == 1) {
+      QTimer::singleShot(PBOPOOL_RELEASE_POLL_MS, this, SLOT(returnUploadedBuffersSlot()));
+    }
+    return;
+  }
+
+  if (pipeline) {
+    pipeline->m_outgoingBufQueue.put(buf);
+  }
+  else {
+    gst_buffer_unref((GstBuffer *)buf);
+  }
+}
+
+// Gives back the pending frames whose uploads have finished, checking
+// again shortly for any that haven't
+void
+GLWidget::returnUploadedBuffersSlot()
+{
+  if (m_pendingReleases.isEmpty()) {
+    return;
+  }
+
+  makeCurrent();
+  QList<PendingRelease> stillPending;
+  for (int relIx = 0; relIx < m_pendingReleases.size(); relIx++) {
+    const PendingRelease &release = m_pendingReleases[relIx];
+    if (!m_pboPool->IsUploaded(release.buf)) {
+      stillPending.append(release);
+    }
+    else if (release.pipeline) {
+      release.pipeline->m_outgoingBufQueue.put(release.buf);
+    }
+    else {
+      gst_buffer_unref((GstBuffer *)release.buf);
+    }
+  }
+  m_pendingReleases = stillPending;
+
+  if (!m_pendingReleases.isEmpty()) {
+    QTimer::singleShot(PBOPOOL_RELEASE_POLL_MS, this, SLOT(returnUploadedBuffersSlot()));
+  }
+}
+
+// Upload thread has finished a frame, show the newest one it has
+void
+GLWidget::asyncUploadReadySlot(int vidIx)
+{
+  if (vidIx >= m_vidTextures.size()) {
+    return;
+  }
+
+  makeCurrent();
+
+  QList<void *> doneBufs;
+  GLuint texId = m_asyncUploader.TakeReady(vidIx, doneBufs);
+
+  for (int bufIx = 0; bufIx < doneBufs.size(); bufIx++) {
+    if (m_vidPipelines[vidIx]) {
+      m_vidPipelines[vidIx]->m_outgoingBufQueue.put(doneBufs[bufIx]);
+    }
+    else {
+      gst_buffer_unref((GstBuffer *)doneBufs[bufIx]);
+    }
+  }
+
+  if (texId != 0) {
+    m_vidTextures[vidIx].texId = texId;
+    m_vidTextures[vidIx].framesUploaded++;
+    m_vidTextures[vidIx].newSinceRender = true;
+    update();
+  }
 }
 
 void
 GLWidget::pipelineFinished(int vidIx)
 {
+  // Its frames still waiting on uploads are unreffed here when they finish
+  for (int relIx = 0; relIx < m_pendingReleases.size(); relIx++) {
+    if (m_pendingReleases[relIx].pipeline == m_vidPipelines[vidIx]) {
+      m_pendingReleases[relIx].pipeline = NULL;
+    }
+  }
+
   m_vidTextures[vidIx].frameCount = 0;
+  m_vidBatcher.RemoveVid(vidIx);
+  // Kept in the pool, the next stream is usually the same size again
+  makeCurrent();
+  if (m_asyncUploader.IsAvailable()) {
+    // Pipeline has already emptied its queues, so unref what comes back here
+    QList<void *> droppedBufs;
+    m_asyncUploader.RemoveVid(vidIx, droppedBufs);
+    for (int bufIx = 0; bufIx < droppedBufs.size(); bufIx++) {
+      gst_buffer_unref((GstBuffer *)droppedBufs[bufIx]);
+    }
+    m_vidTextures[vidIx].texId = 0;
+  }
+  else if (m_texturePool.Release(m_vidTextures[vidIx].texId)) {
+    m_vidTextures[vidIx].texId = 0;
+  }
+  m_deinterlacer.RemoveVid(vidIx);
+  m_vidTextures[vidIx].deinterlacedTexId = 0;
+  // New pipeline starts unthrottled
+  m_vidTextures[vidIx].visible = true;
 
   if (m_closing) {
     delete(m_vidPipelines[vidIx]);
@@ -550,7 +1983,21 @@ GLWidget::pipelineFinished(int vidIx)
       close();
     }
   }
+  else if (m_offlineFps > 0) {
+    // Offline render ends with the videos rather than looping them
+    delete(m_vidPipelines[vidIx]);
+    m_vidPipelines.replace(vidIx, NULL);
+    m_vidTextures[vidIx].texInfoValid = false;
+    resumeOffline();
+  }
   else {
+    // Next loop carries on the shared timeline from where this one ended,
+    // so it stays in step with the other synced streams
+    qint64 baseTimeNs = PipelineClock::StartBaseTimeNs();
+    if (m_syncStreams && (m_vidPipelines[vidIx]->getPlayedNs() > 0)) {
+      baseTimeNs = m_vidPipelines[vidIx]->getBaseTimeNs() + m_vidPipelines[vidIx]->getPlayedNs();
+    }
+
     delete(m_vidPipelines[vidIx]);
     m_vidTextures[vidIx].texInfoValid = false;
 
@@ -564,7 +2011,11 @@ GLWidget::pipelineFinished(int vidIx)
     QObject::connect(m_vidPipelines[vidIx], SIGNAL(finished(int)), this, SLOT(pipelineFinished(int)));
     QObject::connect(this, SIGNAL(closeRequested()), m_vidPipelines[vidIx], SLOT(Stop()), Qt::QueuedConnection);
 
+    m_vidPipelines[vidIx]->enableTargetScaling(m_layout.ScaleDecode());
+    m_vidPipelines[vidIx]->enableSyncToRenderer(m_syncStreams);
+    m_vidPipelines[vidIx]->setBufferPool(m_pboPool);
     m_vidPipelines[vidIx]->Configure();
+    m_vidPipelines[vidIx]->setBaseTimeNs(baseTimeNs);
     m_vidPipelines[vidIx]->Start();
   }
 }
@@ -783,6 +2234,8 @@ GLWidget::stackVidsToggleSlot(int toggleState)
     m_stackVidQuads = true;
   else
     m_stackVidQuads = false;
+
+  m_layout.SetStacked(m_stackVidQuads);
 }
 
 void
@@ -894,6 +2347,7 @@ GLWidget::keyPressEvent(QKeyEvent *e)
                   "q, <esc> - Quit\n"
                   "b - Toggle among background clear colors\n"
                   "m - Load a different model to render\n"
+                  "g - Save a still of what's shown to still-<time>.png\n"
                   "s - "
                   "a - "
                   "v - "
@@ -932,6 +2386,9 @@ GLWidget::keyPressEvent(QKeyEvent *e)
   case Qt::Key_O:
     cycleModelShaderSlot();
     break;
+  case Qt::Key_G:
+    grabFrame(QDateTime::currentDateTime().toString("'still-'yyyyMMdd-hhmmss-zzz'.png'"));
+    break;
   case Qt::Key_P:
     // Decouple bool used within class from Qt check box state enum values
     stackVidsToggleSlot(m_stackVidQuads ? Qt::Unchecked : Qt::Checked);
@@ -983,6 +2440,10 @@ GLWidget::closeEvent(QCloseEvent *event)
     m_closing = true;
     emit closeRequested();
 
+    // Finish the file off while the context is still around
+    makeCurrent();
+    m_recorder.Stop();
+
     // Just in case, check now if any gst threads still exist, if not, close application now
     bool allFinished = true;
     for (int i = 0; i < m_vidPipelines.size(); i++) {
@@ -1002,6 +2463,10 @@ GLWidget::closeEvent(QCloseEvent *event)
     QWidget *_parent = dynamic_cast<QWidget *>(parent());
     if (_parent)
       _parent->close();
+
+    // Nothing visible to close in headless mode, so quit directly
+    if (m_headless)
+      QApplication::quit();
   }
 }
 
@@ -1009,9 +2474,30 @@ GLWidget::closeEvent(QCloseEvent *event)
 void
 GLWidget::setAppropriateVidShader(int vidIx)
 {
+  // Conversion and effects both come out of the LUT
+  if (vidUsesLut(vidIx)) {
+    switch (m_vidTextures[vidIx].colourFormat) {
+#ifdef VIDI420_SHADERS_NEEDED
+    case ColFmt_I420:
+    case ColFmt_I420_10LE:
+      m_vidTextures[vidIx].shader = &m_I420ColourLut;
+      return;
+#endif
+#ifdef VIDNV12_SHADERS_NEEDED
+    case ColFmt_NV12:
+    case ColFmt_P010:
+      m_vidTextures[vidIx].shader = &m_NV12ColourLut;
+      return;
+#endif
+    default:
+      break;
+    }
+  }
+
   switch (m_vidTextures[vidIx].colourFormat) {
 #ifdef VIDI420_SHADERS_NEEDED
   case ColFmt_I420:
+  case ColFmt_I420_10LE:
     switch (m_vidTextures[vidIx].effect) {
     case VidShaderNoEffect:
       m_vidTextures[vidIx].shader = &m_I420NoEffect;
@@ -1066,6 +2552,7 @@ GLWidget::setAppropriateVidShader(int vidIx)
 #endif
 #ifdef VIDNV12_SHADERS_NEEDED
   case ColFmt_NV12:
+  case ColFmt_P010:
     qWarning() << "NV12 " << m_vidTextures[vidIx].effect;
     switch (m_vidTextures[vidIx].effect) {
     case VidShaderNoEffect:
@@ -1159,24 +2646,44 @@ GLWidget::setVidShaderVars(int vidIx, bool printErrors)
     m_vidTextures[vidIx].shader->setUniformValue("u_yHeight", (GLfloat)m_vidTextures[vidIx].height);
     m_vidTextures[vidIx].shader->setUniformValue("u_yWidth", (GLfloat)m_vidTextures[vidIx].width);
     m_vidTextures[vidIx].shader->setUniformValue("u_alphaTexture", 1); // texture unit index
-    if (printErrors) printOpenGLError(__FILE__, __LINE__);
 #ifdef TEXCOORDS_ALREADY_NORMALISED
-    m_vidTextures[vidIx].triStripAlphaTexCoords[0] = QVector2D(1.0f, 0.0f);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[1] = QVector2D(0.0f, 0.0f);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[2] = QVector2D(1.0f, 1.0f);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[3] = QVector2D(0.0f, 1.0f);
+    m_vidTextures[vidIx].shader->setUniformValue("u_alphaTexCoordScale", QVector2D(1.0f, 1.0f));
 #else
-    m_vidTextures[vidIx].triStripAlphaTexCoords[0] = QVector2D(m_alphaTexWidth, 0.0f);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[1] = QVector2D(0.0f, 0.0f);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[2] = QVector2D(m_alphaTexWidth, m_alphaTexHeight);
-    m_vidTextures[vidIx].triStripAlphaTexCoords[3] = QVector2D(0.0f, m_alphaTexHeight);
+    m_vidTextures[vidIx].shader->setUniformValue("u_alphaTexCoordScale", QVector2D(m_alphaTexWidth, m_alphaTexHeight));
 #endif
+    if (printErrors) printOpenGLError(__FILE__, __LINE__);
     break;
 
   default:
     LOG(LOG_GLSHADERS, Logger::Warning, "Invalid effect set on vidIx %d", vidIx);
     break;
   }
+
+  // Quad texture co-ords are 0..1, the video frag shaders want texels unless
+  // they are the normalised variants, which the model draws with.
+  QVector2D texCoordScale(1.0f, 1.0f);
+#ifndef TEXCOORDS_ALREADY_NORMALISED
+  switch (m_vidTextures[vidIx].effect) {
+  case VidShaderNoEffectNormalisedTexCoords:
+  case VidShaderLitNormalisedTexCoords:
+    break;
+  default:
+    texCoordScale = QVector2D(m_vidTextures[vidIx].width, m_vidTextures[vidIx].height);
+    break;
+  }
+#endif
+  m_vidTextures[vidIx].shader->setUniformValue("u_texCoordScale", texCoordScale);
+  m_vidTextures[vidIx].shader->setUniformValue("u_sampleScale", vidSampleScale(vidIx));
+
+  // LUT is indexed by YUV, so samples go through unconverted
+  if (vidUsesLut(vidIx)) {
+    YuvColourMatrix::SetUniforms(m_vidTextures[vidIx].shader, YuvColourMatrix::Passthrough());
+    m_colourLut.SetUniforms(m_vidTextures[vidIx].shader);
+    bindVidLut(vidIx);
+  }
+  else {
+    YuvColourMatrix::SetUniforms(m_vidTextures[vidIx].shader, m_vidTextures[vidIx].yuvCoeffs);
+  }
 }
 
 int
@@ -1201,7 +2708,8 @@ GLWidget::loadShaderFile(QString fileName, QString &shaderSource)
 }
 
 int
-GLWidget::setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int listLen)
+GLWidget::setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int listLen,
+                      const QString &generatedFragSource)
 {
   bool ret;
 
@@ -1263,6 +2771,14 @@ GLWidget::setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int l
     }
   }
 
+  // Effect chain stages have their main() made for them, after the passes
+  // it calls
+  if (!generatedFragSource.isEmpty()) {
+    shaderSourceFileNames += "(generated), ";
+    fullShaderSourceFileNames += "(generated), ";
+    shaderSource += generatedFragSource;
+  }
+
   if (!shaderSource.isEmpty()) {
     LOG(LOG_GLSHADERS, Logger::Debug1, "compiling fragment shader");
 
@@ -1275,6 +2791,13 @@ GLWidget::setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int l
     }
   }
 
+  // Same attribute locations in every program so the vid quad VAO works with all of them
+  prog->bindAttributeLocation("a_vertex", VID_ATTRIB_VERTEX);
+  prog->bindAttributeLocation("a_texCoord", VID_ATTRIB_TEXCOORD);
+  prog->bindAttributeLocation("a_alphaTexCoord", VID_ATTRIB_ALPHATEXCOORD);
+  prog->bindAttributeLocation("a_instanceMvp", VID_ATTRIB_INSTANCE_MVP);
+  prog->bindAttributeLocation("a_instanceLayer", VID_ATTRIB_INSTANCE_LAYER);
+
   ret = prog->link();
   if (ret == false) {
     LOG(LOG_GLSHADERS, Logger::Error, "Link log for shader sources %s:\n%s\n",
@@ -14,13 +14,38 @@
 #include <QFileDialog>
 #include <QSignalMapper>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QPaintEvent>
+#include <QGLFramebufferObject>
+#include <QGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLFunctions>
+#include <QThreadPool>
+#include <QImage>
 
 #include <iostream>
 
 #include "pipeline.h"
+#include "pipelinefactory.h"
 
 #include "model.h"
+#include "appoptions.h"
+#include "renderstats.h"
+#include "gltimerqueries.h"
+#include "vidquadbatcher.h"
+#include "vidlayout.h"
+#include "texturepool.h"
+#include "asynctexuploader.h"
+#include "dmabufimporter.h"
+#include "pbobufferpool.h"
+#include "deinterlacer.h"
+#include "yuvcolourmatrix.h"
+#include "colourlut.h"
+#include "effectchain.h"
+#include "fbopool.h"
+#include "recorder.h"
+#include "framereadback.h"
+#include "framegrabtask.h"
 
 #ifdef ENABLE_YUV_WINDOW
 #include "yuvdebugwindow.h"
@@ -69,6 +94,11 @@
 #define DFLT_OBJ_MODEL_FILE_NAME    "cube.obj"
 #define MODEL_BOUNDARY_SIZE     2.0f
 
+// Composited grabs read back at once, more wait for the next frame
+#define GRAB_READBACK_BUFFERS   2
+// How often a composited grab's readback is checked for being finished
+#define GRAB_POLL_MS            5
+
 typedef enum
 {
   ModelEffectFirst = 0,
@@ -99,6 +129,11 @@ typedef enum
 #define VIDTEXTURE_TOP_Y             1.0f
 #define VIDTEXTURE_BOT_Y             -1.0f
 
+// Attribute locations bound in every shader program
+#define VID_ATTRIB_VERTEX            0
+#define VID_ATTRIB_TEXCOORD          1
+#define VID_ATTRIB_ALPHATEXCOORD     2
+
 typedef struct _VidTextureInfo
 {
   GLuint texId;
@@ -107,16 +142,44 @@ typedef struct _VidTextureInfo
   int width;
   int height;
   ColFormat colourFormat;
+  Colorimetry colorimetry;
+  // Worked out from the colorimetry when the texture info is set up
+  YuvToRgbCoeffs yuvCoeffs;
   QGLShaderProgram *shader;
   VidShaderEffectType effect;
 
-  QVector2D triStripVertices[NUM_VIDTEXTURE_VERTICES_X * NUM_VIDTEXTURE_VERTICES_Y];
-  QVector2D triStripTexCoords[NUM_VIDTEXTURE_VERTICES_X * NUM_VIDTEXTURE_VERTICES_Y];
-  QVector2D triStripAlphaTexCoords[NUM_VIDTEXTURE_VERTICES_X * NUM_VIDTEXTURE_VERTICES_Y];
-
   int frameCount;
+  // Not reset on pipeline restart, for benchmark throughput
+  quint64 framesUploaded;
+  bool newSinceRender;
+  // As of the last render, uploads are skipped while false if throttling
+  bool visible;
+  // Frames come in dmabufs and are imported rather than copied
+  bool dmabufImport;
+  // Caps say some or all frames are interlaced, so those are deinterlaced
+  // on upload
+  bool interlaced;
+  // Drawn instead of texId when the last frame was deinterlaced
+  GLuint deinterlacedTexId;
+  // Post processing passes, with a program for each stage of them once
+  // they're built for the format
+  EffectChain effectChain;
+  QVector<QGLShaderProgram *> chainShaders;
 } VidTextureInfo;
 
+typedef struct _PendingGrab
+{
+  int grabId;
+  QString fileName;
+} PendingGrab;
+
+// Frame the GPU may still be reading, pipeline is NULL once it's gone
+typedef struct _PendingRelease
+{
+  Pipeline *pipeline;
+  void *buf;
+} PendingRelease;
+
 typedef struct _GLShaderModule
 {
   const char *sourceFileName;
@@ -127,10 +190,11 @@ class GLWidget : public QGLWidget
 {
   Q_OBJECT
 public:
-  explicit GLWidget(int argc, char *argv[], QWidget *parent = 0);
+  explicit GLWidget(const AppOptions &options, QWidget *parent = 0);
   ~GLWidget();
 
   virtual void initVideo();
+  void startHeadless();
 
   QSize minimumSizeHint() const;
   QSize sizeHint() const;
@@ -139,7 +203,18 @@ public:
   void setYRotation(int angle);
   void setZRotation(int angle);
 
+  // Stills, taken without holding up rendering. grabFrame is of the next
+  // frame drawn, read back asynchronously. grabVideoFrame is of the next
+  // frame video vidIx shows, as it was decoded, so without effects or
+  // deinterlacing. The image comes back through frameGrabbed, and is also
+  // saved to fileName if one's given, .png or .jpg. Returns the grab's id,
+  // or -1 if it can't be done.
+  int grabFrame(const QString &fileName = QString());
+  int grabVideoFrame(int vidIx, const QString &fileName = QString());
+
 Q_SIGNALS:
+  // Null image if the grab failed
+  void frameGrabbed(int grabId, const QImage &image);
   void closeRequested();
   void stackVidsStateChanged(bool newState);
   void rotateStateChanged(bool newState);
@@ -166,9 +241,16 @@ public Q_SLOTS:
 
   void animate();
 
+private Q_SLOTS:
+  void headlessFrameSlot();
+  void collectGrabsSlot();
+  void returnUploadedBuffersSlot();
+  void asyncUploadReadySlot(int vidIx);
+
 protected:
   virtual void initializeGL();
   virtual Pipeline *createPipeline(int vidIx);
+  void renderScene();
   void paintEvent(QPaintEvent *event);
   void resizeGL(int width, int height);
   void mousePressEvent(QMouseEvent *event);
@@ -188,8 +270,46 @@ private:
   void setVidShaderVars(int vidIx, bool printErrors);
   int loadShaderFile(QString fileName, QString &shaderSource);
   int setupShader(QGLShaderProgram *prog, QString baseFileName, bool vertNeeded, bool fragNeeded);
-  int setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int listLen);
+  int setupShader(QGLShaderProgram *prog, GLShaderModule shaderList[], int listLen,
+                  const QString &generatedFragSource = QString());
   int getCallingGstVecIx(int vidIx);
+  static QGLFormat glFormatForOptions(const AppOptions &options);
+  void finishHeadless();
+  void reportHeadlessResults();
+  void setupVidQuadGeometry();
+  void setVidQuadAttribPointers(bool enable);
+  void bindVidQuadGeometry();
+  void releaseVidQuadGeometry();
+  void updateVidPipelineHints();
+  bool vidVisible(int vidIx);
+  bool vidTextureSize(int vidIx, int &texWidth, int &texHeight);
+  void vidTextureFormat(int vidIx, GLint &internalFormat, GLenum &type);
+  GLfloat vidSampleScale(int vidIx);
+  GLuint vidDrawTexture(int vidIx);
+  void deinterlaceFrame(int vidIx);
+  bool vidUsesBatch(int vidIx);
+  bool vidUsesLut(int vidIx);
+  void bindVidLut(int vidIx);
+  bool vidUsesChain(int vidIx);
+  const char *vidConvShaderFile(ColFormat colFormat);
+  void setupVidChainShaders(int vidIx);
+  void drawVidChain(int vidIx);
+  void drawVidChainStage(int vidIx, int stageIx, QGLFramebufferObject *inputFbo,
+                         const QMatrix4x4 &mvpMatrix, const QMatrix4x4 &mvMatrix);
+  QGLShaderProgram *instancedVidShader(ColFormat colFormat);
+  void drawBatchedVids(QVector<bool> &vidDrawn);
+  void showFrame(int vidIx, void *newBuf);
+  void releaseVidBuffer(Pipeline *pipeline, void *buf);
+  void pickSyncedFrames();
+  bool pickFramesDueBy(int vidIx, qint64 targetNs);
+  bool findOfflineStart();
+  bool pickOfflineFrames(qint64 targetNs);
+  void resumeOffline();
+  void updateGpuTimingText();
+  void recordFrame(const QSize &frameSize);
+  void readBackGrabs(const QSize &frameSize);
+  void grabVideoBuffer(int vidIx, void *buf);
+  void startGrabTask(FrameGrabTask *task);
 
   bool m_closing;
   QString m_dataFilesDir;
@@ -216,12 +336,14 @@ private:
 
   QMatrix4x4 m_modelViewMatrix;
   QMatrix4x4 m_projectionMatrix;
+  QSize m_viewportSize;
 
   int m_clearColorIndex;
   bool m_stackVidQuads;
   ModelEffectType m_currentModelEffectIndex;
 
   QGLShaderProgram m_brickProg;
+  QGLShaderProgram m_deinterlaceProg;
 #ifdef VIDI420_SHADERS_NEEDED
   QGLShaderProgram m_I420NoEffectNormalised;
   QGLShaderProgram m_I420LitNormalised;
@@ -230,6 +352,8 @@ private:
   QGLShaderProgram m_I420ColourHilight;
   QGLShaderProgram m_I420ColourHilightSwap;
   QGLShaderProgram m_I420AlphaMask;
+  QGLShaderProgram m_I420NoEffectInstanced;
+  QGLShaderProgram m_I420ColourLut;
 #endif
 #ifdef VIDUYVY_SHADERS_NEEDED
   QGLShaderProgram m_UYVYNoEffectNormalised;
@@ -248,6 +372,8 @@ private:
   QGLShaderProgram m_NV12ColourHilight;
   QGLShaderProgram m_NV12ColourHilightSwap;
   QGLShaderProgram m_NV12AlphaMask;
+  QGLShaderProgram m_NV12NoEffectInstanced;
+  QGLShaderProgram m_NV12ColourLut;
 #endif
 
   // Video shader effects vars - for simplicitys sake make them general to all vids
@@ -268,6 +394,99 @@ private:
   int m_frames;
   QTime m_frameTime;
 
+  // Headless benchmark mode
+  bool m_headless;
+  int m_headlessFrames;
+  int m_headlessFramesDone;
+  QSize m_headlessSize;
+  QString m_benchOutputFile;
+  QTimer *m_headlessTimer;
+  QGLFramebufferObject *m_headlessFbo;
+  QElapsedTimer m_headlessWallTime;
+  // Offline rendering, output frames are at fixed times on their own
+  // timeline rather than the clock's
+  int m_offlineFps;
+  qint64 m_offlineFrameNs;
+  // Streams' running time the timeline starts at, -1 until every stream
+  // has its first frame
+  qint64 m_offlineStartNs;
+  // Frame timer is stopped while waiting for frames to be decoded
+  bool m_offlineWaiting;
+  RenderStats m_renderStats;
+
+  // Optional GPU pass timing
+  bool m_gpuTimingEnabled;
+  GLTimerQueries m_gpuTimers;
+  QString m_gpuTimingText;
+
+  // Static geometry shared by all the video quads
+  QGLBuffer m_vidQuadVbo;
+  QOpenGLVertexArrayObject *m_vidQuadVao;
+
+  // Where the video quads go, and how big they are on screen
+  VidLayout m_layout;
+  bool m_throttleHidden;
+
+  // Same format/size quads drawn with one instanced call each
+  bool m_instancingEnabled;
+  VidQuadBatcher m_vidBatcher;
+
+  // Textures of the separately drawn quads, reused across restarts
+  TexturePool m_texturePool;
+
+  // Uploads on a separate thread when enabled and supported
+  int m_asyncUploadBuffers;
+  AsyncTexUploader m_asyncUploader;
+
+  bool m_dmabufEnabled;
+  DmaBufImporter m_dmabufImporter;
+
+  // Arena decoders write frames into, refcounted as frames can outlive us
+  int m_pboPoolMB;
+  PboBufferPool *m_pboPool;
+  // Frames waiting for their uploads to finish before going back
+  QList<PendingRelease> m_pendingReleases;
+
+  // Frames go through it to the textures that are drawn, so after the pool
+  DeinterlaceMode m_deinterlaceMode;
+  Deinterlacer m_deinterlacer;
+
+  // Conversion and colour effects in one 3D LUT lookup, optionally with a
+  // .cube grade, when enabled and supported
+  bool m_colourLutEnabled;
+  QString m_colourLutFile;
+  ColourLut m_colourLut;
+
+  // Effect chain options by vid, stage programs shared by every vid with
+  // the same stage (NULL if it wouldn't build), and the stages' targets
+  QMap<int, QString> m_effectChainDescs;
+  QMap<QString, QGLShaderProgram *> m_chainShaders;
+  FboPool m_fboPool;
+
+  // Composited output is recorded to this file if set, cleared if the
+  // recording can't be started
+  QString m_recordFile;
+  Recorder m_recorder;
+  QElapsedTimer m_recordTime;
+
+  // Stills, see grabFrame
+  int m_nextGrabId;
+  FrameReadback m_grabReadback;
+  // Composited grabs waiting for a frame, then for its readback, a list
+  // for each readback in flight
+  QList<PendingGrab> m_frameGrabsWaiting;
+  QList<QList<PendingGrab> > m_frameGrabsReading;
+  // Video grabs by vid index, waiting for its next frame
+  QMap<int, QList<PendingGrab> > m_videoGrabsWaiting;
+  // Converts and saves them, one at a time
+  QThreadPool m_grabPool;
+
+  // Pipeline backend name, or "auto" to pick one per video
+  QString m_pipelineBackend;
+
+  // Every pipeline on the shared clock, frames picked by PTS each render
+  bool m_syncStreams;
+
 #ifdef ENABLE_YUV_WINDOW
   YuvDebugWindow *m_yuvWindow;
   QVector<QRgb> m_colourMap;
@@ -1,13 +1,25 @@
 
+#include <string.h>
+#include <QStringList>
+#include <QTimer>
+#include <gst/video/video.h>
 #include "gstpipeline.h"
+#include "pipelineclock.h"
+#include "pbobufferpool.h"
 #include "applogger.h"
 
 GStreamerPipeline::GStreamerPipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent) :
-  Pipeline(vidIx, videoLocation, renderer_slot, parent), m_source(NULL), m_decodebin(NULL), m_videosink(NULL),
-  m_audiosink(NULL), m_audioconvert(NULL), m_audioqueue(NULL), m_loop(NULL), m_bus(NULL), m_pipeline(NULL)
+  Pipeline(vidIx, videoLocation, renderer_slot, parent), m_source(NULL), m_capsfilter(NULL), m_videoscale(NULL),
+  m_scalecaps(NULL), m_decodebin(NULL), m_videosink(NULL), m_audiosink(NULL), m_audioconvert(NULL),
+  m_audioqueue(NULL), m_loop(NULL), m_bus(NULL), m_pipeline(NULL), m_streamWidth(0), m_streamHeight(0),
+  m_streamColFormat(ColFmt_Unknown), m_pendingCaps(NULL), m_stopping(false), m_pboPool(NULL)
 {
   LOG(LOG_VIDPIPELINE, Logger::Debug1, "constructor entered");
 
+  m_streamColorimetry = m_colorimetry;
+  m_streamInterlacing = m_interlacing;
+  gst_segment_init(&m_segment, GST_FORMAT_TIME);
+
   m_incomingBufThread = new GstIncomingBufThread(this, this);
   m_outgoingBufThread = new GstOutgoingBufThread(this, this);
 
@@ -32,23 +44,19 @@ GStreamerPipeline::Configure()
 
   // Create the elements
   m_pipeline = gst_pipeline_new(NULL);
-  if (m_videoLocation.isEmpty()) {
-    LOG(LOG_VIDPIPELINE, Logger::Info, "No video file specified. Using video test source.");
-    m_source = gst_element_factory_make("videotestsrc", "testsrc");
-  }
-  else {
-    m_source = gst_element_factory_make("filesrc", "filesrc");
-    g_object_set(G_OBJECT(m_source), "location", /*"video.avi"*/ m_videoLocation.toUtf8().constData(), NULL);
-  }
+  createSource();
   m_decodebin = gst_element_factory_make("decodebin", "decodebin");
   m_videosink = gst_element_factory_make("fakesink", "videosink");
-  m_audiosink = gst_element_factory_make("alsasink", "audiosink");
+  // alsasink would pace the whole pipeline to real time
+  m_audiosink = gst_element_factory_make(m_offline ? "fakesink" : "alsasink", "audiosink");
   m_audioconvert = gst_element_factory_make("audioconvert", "audioconvert");
   m_audioqueue = gst_element_factory_make("queue", "audioqueue");
 
   if (m_pipeline == NULL || m_source == NULL || m_decodebin == NULL ||
       m_videosink == NULL || m_audiosink == NULL || m_audioconvert == NULL || m_audioqueue == NULL)
     g_critical("One of the GStreamer decoding elements is missing");
+  else if (m_offline)
+    g_object_set(G_OBJECT(m_audiosink), "sync", FALSE, NULL);
 
   // Setup the pipeline
   gst_bin_add_many(GST_BIN(m_pipeline), m_source, m_decodebin, m_videosink,
@@ -56,10 +64,104 @@ GStreamerPipeline::Configure()
   g_signal_connect(m_decodebin, "pad-added", G_CALLBACK(on_new_pad), this);
 
   // Link the elements
-  gst_element_link(m_source, m_decodebin);
+  linkSource(m_decodebin);
   gst_element_link(m_audioqueue, m_audioconvert);
   gst_element_link(m_audioconvert, m_audiosink);
 
+  // Scaler for setTargetSize, passes through until a size is set
+  if (m_scaleToTarget) {
+    m_videoscale = gst_element_factory_make("videoscale", "videoscale");
+    m_scalecaps = gst_element_factory_make("capsfilter", "scalecaps");
+    if (m_videoscale && m_scalecaps) {
+      gst_bin_add_many(GST_BIN(m_pipeline), m_videoscale, m_scalecaps, NULL);
+      gst_element_link_many(m_videoscale, m_scalecaps, m_videosink, NULL);
+    }
+    else {
+      LOG(LOG_VIDPIPELINE, Logger::Warning, "No videoscale element, vid %d won't be scaled", m_vidIx);
+      if (m_videoscale) {
+        gst_object_unref(m_videoscale);
+      }
+      if (m_scalecaps) {
+        gst_object_unref(m_scalecaps);
+      }
+      m_videoscale = NULL;
+      m_scalecaps = NULL;
+    }
+  }
+
+  watchVideoSink();
+  watchBusAndPause();
+}
+
+// Test source for no location or a synthetic one, otherwise the file
+void
+GStreamerPipeline::createSource()
+{
+  if (m_videoLocation.isEmpty()) {
+    LOG(LOG_VIDPIPELINE, Logger::Info, "No video file specified. Using video test source.");
+    m_source = gst_element_factory_make("videotestsrc", "testsrc");
+  }
+  else if (m_videoLocation.startsWith(SYNTHETIC_VIDEO_LOCATION_PREFIX)) {
+    LOG(LOG_VIDPIPELINE, Logger::Info, "Using video test source for %s", m_videoLocation.toUtf8().constData());
+    m_source = gst_element_factory_make("videotestsrc", "testsrc");
+
+    GstCaps *caps = syntheticLocationToCaps(m_videoLocation);
+    if (caps) {
+      m_capsfilter = gst_element_factory_make("capsfilter", "synthcaps");
+      if (m_capsfilter) {
+        g_object_set(G_OBJECT(m_capsfilter), "caps", caps, NULL);
+      }
+      gst_caps_unref(caps);
+    }
+    else {
+      LOG(LOG_VIDPIPELINE, Logger::Error, "Badly formed synthetic video location %s", m_videoLocation.toUtf8().constData());
+    }
+  }
+  else {
+    m_source = gst_element_factory_make("filesrc", "filesrc");
+    g_object_set(G_OBJECT(m_source), "location", /*"video.avi"*/ m_videoLocation.toUtf8().constData(), NULL);
+  }
+}
+
+// Source goes straight into downstream, unless synthetic caps need to go
+// in between. Both must already be in the pipeline.
+void
+GStreamerPipeline::linkSource(GstElement *downstream)
+{
+  if (m_capsfilter) {
+    gst_bin_add(GST_BIN(m_pipeline), m_capsfilter);
+    gst_element_link_many(m_source, m_capsfilter, downstream, NULL);
+  }
+  else {
+    gst_element_link(m_source, downstream);
+  }
+}
+
+// Decoders ask the sink where to put frames, which is the renderer's pixel
+// buffers once setBufferPool has been called. Caps are watched for changes
+// of format, and of the source size before any scaler, and segments for
+// the buffers' running times.
+void
+GStreamerPipeline::watchVideoSink()
+{
+  GstPad *sinkpad = gst_element_get_static_pad(m_videosink, "sink");
+  gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
+                    (GstPadProbeCallback)on_allocation_query, this, NULL);
+  gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                    (GstPadProbeCallback)on_stream_event, this, NULL);
+  gst_object_unref(sinkpad);
+
+  if (m_videoscale) {
+    sinkpad = gst_element_get_static_pad(m_videoscale, "sink");
+    gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                      (GstPadProbeCallback)on_stream_event, this, NULL);
+    gst_object_unref(sinkpad);
+  }
+}
+
+void
+GStreamerPipeline::watchBusAndPause()
+{
   m_bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
   gst_bus_add_watch(m_bus, (GstBusFunc)bus_call, this);
   gst_object_unref(m_bus);
@@ -70,6 +172,14 @@ GStreamerPipeline::Configure()
 void
 GStreamerPipeline::Start()
 {
+  if (m_syncToRenderer) {
+    // Fixed base time on the shared clock, rather than whenever this one
+    // happens to reach PLAYING
+    gst_pipeline_use_clock(GST_PIPELINE(m_pipeline), PipelineClock::Clock());
+    gst_element_set_start_time(m_pipeline, GST_CLOCK_TIME_NONE);
+    gst_element_set_base_time(m_pipeline, (GstClockTime)m_baseTimeNs);
+  }
+
   GstStateChangeReturn ret = gst_element_set_state(GST_ELEMENT(m_pipeline), GST_STATE_PLAYING);
   if (ret == GST_STATE_CHANGE_FAILURE) {
     LOG(LOG_VIDPIPELINE, Logger::Error, "Failed to start up pipeline!");
@@ -94,6 +204,8 @@ GStreamerPipeline::Start()
 void
 GStreamerPipeline::Stop()
 {
+  m_stopping = true;
+  m_incomingBufQueue.wakeWriters();
 #ifdef Q_WS_WIN
   g_main_loop_quit(m_loop);
 #else
@@ -119,14 +231,247 @@ GStreamerPipeline::cleanUp()
     m_outgoingBufQueue.get((void **)(&buf));
     gst_buffer_unref(buf);
   }
+  {
+    QMutexLocker locker(&m_runningTimeMutex);
+    m_bufRunningTimesNs.clear();
+  }
+  clearFormatChanges();
 
   gst_object_unref(m_pipeline);
 
+  if (m_pendingCaps) {
+    gst_caps_unref(m_pendingCaps);
+    m_pendingCaps = NULL;
+  }
+
   // Done
   m_finished = true;
   emit finished(m_vidIx);
 }
 
+qint64
+GStreamerPipeline::getBufferAgeNs(void *buf)
+{
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if ((gstBuf == NULL) || (m_pipeline == NULL) || !GST_BUFFER_PTS_IS_VALID(gstBuf)) {
+    return -1;
+  }
+
+  GstClock *clock = gst_element_get_clock(m_pipeline);
+  if (clock == NULL) {
+    return -1;
+  }
+
+  qint64 bufRunningTimeNs = getBufferRunningTimeNs(buf);
+  if (bufRunningTimeNs < 0) {
+    gst_object_unref(clock);
+    return -1;
+  }
+
+  GstClockTime runningTime = gst_clock_get_time(clock) - gst_element_get_base_time(m_pipeline);
+  gst_object_unref(clock);
+
+  return (qint64)runningTime - bufRunningTimeNs;
+}
+
+// PTS only means anything against the segment it came in, MPEG-TS for one
+// starts nowhere near 0
+qint64
+GStreamerPipeline::getBufferRunningTimeNs(void *buf)
+{
+  QMutexLocker locker(&m_runningTimeMutex);
+  return m_bufRunningTimesNs.value(buf, -1);
+}
+
+// Renderer thread, after takeFormatChange for the buffer so the
+// interlacing is that of the caps it came with. Interleaved caps are
+// interlaced throughout, mixed only where buffers are flagged. Field order
+// is from the caps if they say, otherwise per buffer.
+FieldOrder
+GStreamerPipeline::getBufferFieldOrder(void *buf)
+{
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if ((gstBuf == NULL) || (m_interlacing.mode == Interlace_Progressive)) {
+    return Fields_Progressive;
+  }
+
+  if ((m_interlacing.mode == Interlace_Mixed) && !GST_BUFFER_FLAG_IS_SET(gstBuf, GST_VIDEO_BUFFER_FLAG_INTERLACED)) {
+    return Fields_Progressive;
+  }
+
+  if (m_interlacing.fieldOrder != Fields_Progressive) {
+    return m_interlacing.fieldOrder;
+  }
+  return GST_BUFFER_FLAG_IS_SET(gstBuf, GST_VIDEO_BUFFER_FLAG_TFF) ? Fields_TopFirst : Fields_BottomFirst;
+}
+
+// Matrix and range the caps say the frames are in. Caps without colorimetry
+// get GStreamer's default for the frame size.
+Colorimetry
+GStreamerPipeline::discoverColorimetry(GstCaps *caps)
+{
+  Colorimetry colorimetry;
+  colorimetry.matrix = ColMatrix_Unknown;
+  colorimetry.fullRange = false;
+
+  GstVideoInfo info;
+  if (!gst_video_info_from_caps(&info, caps)) {
+    return colorimetry;
+  }
+
+  switch (GST_VIDEO_INFO_COLORIMETRY(&info).matrix) {
+  case GST_VIDEO_COLOR_MATRIX_BT601:
+    colorimetry.matrix = ColMatrix_BT601;
+    break;
+  case GST_VIDEO_COLOR_MATRIX_BT709:
+    colorimetry.matrix = ColMatrix_BT709;
+    break;
+  case GST_VIDEO_COLOR_MATRIX_BT2020:
+    colorimetry.matrix = ColMatrix_BT2020;
+    break;
+  case GST_VIDEO_COLOR_MATRIX_SMPTE240M:
+    colorimetry.matrix = ColMatrix_SMPTE240M;
+    break;
+  case GST_VIDEO_COLOR_MATRIX_FCC:
+    colorimetry.matrix = ColMatrix_FCC;
+    break;
+  default:
+    break;
+  }
+  colorimetry.fullRange = (GST_VIDEO_INFO_COLORIMETRY(&info).range == GST_VIDEO_COLOR_RANGE_0_255);
+
+  return colorimetry;
+}
+
+// How the caps say the frames are interlaced. Separate fields aren't
+// handled, they're shown as they come.
+Interlacing
+GStreamerPipeline::discoverInterlacing(GstCaps *caps)
+{
+  Interlacing interlacing;
+  interlacing.mode = Interlace_Progressive;
+  interlacing.fieldOrder = Fields_Progressive;
+
+  GstVideoInfo info;
+  if ((caps == NULL) || !gst_video_info_from_caps(&info, caps)) {
+    return interlacing;
+  }
+
+  switch (GST_VIDEO_INFO_INTERLACE_MODE(&info)) {
+  case GST_VIDEO_INTERLACE_MODE_INTERLEAVED:
+    interlacing.mode = Interlace_Interleaved;
+    break;
+  case GST_VIDEO_INTERLACE_MODE_MIXED:
+    interlacing.mode = Interlace_Mixed;
+    break;
+  default:
+    return interlacing;
+  }
+
+  switch (GST_VIDEO_INFO_FIELD_ORDER(&info)) {
+  case GST_VIDEO_FIELD_ORDER_TOP_FIELD_FIRST:
+    interlacing.fieldOrder = Fields_TopFirst;
+    break;
+  case GST_VIDEO_FIELD_ORDER_BOTTOM_FIELD_FIRST:
+    interlacing.fieldOrder = Fields_BottomFirst;
+    break;
+  default:
+    break;
+  }
+
+  return interlacing;
+}
+
+// The sink drops buffers closer together than throttle-time and sends
+// throttle QoS events upstream, which decoders use to skip decoding frames
+// (non-keyframes) that would only be dropped.
+void
+GStreamerPipeline::setThrottled(bool throttled)
+{
+  if (m_videosink == NULL) {
+    return;
+  }
+
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d %s", m_vidIx, throttled ? "throttled" : "unthrottled");
+  g_object_set(G_OBJECT(m_videosink),
+               "qos", (gboolean)throttled,
+               "throttle-time", (guint64)(throttled ? PIPELINE_THROTTLED_INTERVAL_NS : 0),
+               NULL);
+}
+
+// Usually already negotiated by the time the renderer has a pool to give,
+// so upstream is asked to query again
+void
+GStreamerPipeline::setBufferPool(PboBufferPool *pool)
+{
+  m_pboPool = pool;
+  if ((pool == NULL) || (m_videosink == NULL)) {
+    return;
+  }
+
+  GstPad *sinkpad = gst_element_get_static_pad(m_videosink, "sink");
+  if (gst_pad_is_linked(sinkpad)) {
+    gst_pad_push_event(sinkpad, gst_event_new_reconfigure());
+  }
+  gst_object_unref(sinkpad);
+}
+
+void
+GStreamerPipeline::setScaleDivisor(int divisor)
+{
+  if (m_scalecaps == NULL) {
+    return;
+  }
+
+  // Unconstrained caps let the full size straight through. Width is kept to
+  // a multiple of 8 so the chroma rows of I420 don't get padded, the
+  // renderer uploads frames as tightly packed.
+  GstCaps *caps;
+  if (divisor == 1) {
+    caps = gst_caps_new_any();
+  }
+  else {
+    caps = gst_caps_new_simple("video/x-raw",
+                               "width", G_TYPE_INT, (m_sourceWidth / divisor) & ~7,
+                               "height", G_TYPE_INT, (m_sourceHeight / divisor) & ~1,
+                               NULL);
+  }
+
+  g_object_set(G_OBJECT(m_scalecaps), "caps", caps, NULL);
+  gst_caps_unref(caps);
+}
+
+GstCaps *
+GStreamerPipeline::syntheticLocationToCaps(const QString &location)
+{
+  // "synthetic:<fourcc>:<width>x<height>@<fps>"
+  QStringList fields = location.mid(strlen(SYNTHETIC_VIDEO_LOCATION_PREFIX)).split(':');
+  if (fields.size() != 2) {
+    return NULL;
+  }
+
+  QStringList sizeAndRate = fields[1].split('@');
+  QStringList dims = sizeAndRate[0].split('x');
+  if ((sizeAndRate.size() != 2) || (dims.size() != 2)) {
+    return NULL;
+  }
+
+  bool widthOk, heightOk, fpsOk;
+  int width = dims[0].toInt(&widthOk);
+  int height = dims[1].toInt(&heightOk);
+  int fps = sizeAndRate[1].toInt(&fpsOk);
+  if (!widthOk || !heightOk || !fpsOk) {
+    return NULL;
+  }
+
+  return gst_caps_new_simple("video/x-raw",
+                             "format", G_TYPE_STRING, fields[0].toUtf8().constData(),
+                             "width", G_TYPE_INT, width,
+                             "height", G_TYPE_INT, height,
+                             "framerate", GST_TYPE_FRACTION, fps, 1,
+                             NULL);
+}
+
 void
 GStreamerPipeline::on_new_pad(GstElement *element, GstPad *pad, GStreamerPipeline *p)
 {
@@ -141,9 +486,16 @@ GStreamerPipeline::on_new_pad(GstElement *element, GstPad *pad, GStreamerPipelin
   str = gst_caps_get_structure(caps, 0);
 
   if (g_strrstr(gst_structure_get_name(str), "video")) {
-    sinkpad = gst_element_get_static_pad(p->m_videosink, "sink");
+    if (p->m_videoscale) {
+      sinkpad = gst_element_get_static_pad(p->m_videoscale, "sink");
+    }
+    else {
+      sinkpad = gst_element_get_static_pad(p->m_videosink, "sink");
+    }
 
-    g_object_set(G_OBJECT(p->m_videosink), "sync", TRUE, "signal-handoffs", TRUE, NULL);
+    // When synced the renderer picks frames by PTS, so they're let through
+    // as soon as they're decoded
+    g_object_set(G_OBJECT(p->m_videosink), "sync", (gboolean)!p->m_syncToRenderer, "signal-handoffs", TRUE, NULL);
     g_signal_connect(p->m_videosink, "preroll-handoff", G_CALLBACK(on_gst_buffer), p);
     g_signal_connect(p->m_videosink, "handoff", G_CALLBACK(on_gst_buffer), p);
   }
@@ -156,6 +508,94 @@ GStreamerPipeline::on_new_pad(GstElement *element, GstPad *pad, GStreamerPipelin
   gst_object_unref(sinkpad);
 }
 
+// Answers ALLOCATION queries on the sink with a pool in the renderer's pixel
+// buffers, for the formats it uploads from them. Anything else gets fakesink's
+// usual answer.
+GstPadProbeReturn
+GStreamerPipeline::on_allocation_query(GstPad *pad, GstPadProbeInfo *info, GStreamerPipeline *p)
+{
+  Q_UNUSED(pad);
+
+  GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+  PboBufferPool *pboPool = p->m_pboPool;
+  if ((GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION) || (pboPool == NULL)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstCaps *caps;
+  gboolean needPool;
+  GstVideoInfo videoInfo;
+  gst_query_parse_allocation(query, &caps, &needPool);
+  if ((caps == NULL) || !gst_video_info_from_caps(&videoInfo, caps)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&videoInfo);
+  if ((format != GST_VIDEO_FORMAT_I420) && (format != GST_VIDEO_FORMAT_NV12) && (format != GST_VIDEO_FORMAT_UYVY) &&
+      (format != GST_VIDEO_FORMAT_P010_10LE) && (format != GST_VIDEO_FORMAT_I420_10LE)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstBufferPool *pool = pboPool->NewGstBufferPool(caps);
+  if (pool == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  guint size;
+  GstStructure *config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_get_params(config, NULL, &size, NULL, NULL);
+  gst_structure_free(config);
+
+  gst_query_add_allocation_pool(query, pool, size, PBOPOOL_MIN_BUFFERS, 0);
+  gst_object_unref(pool);
+
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d decoding into pixel buffers, %u byte frames", p->getVidIx(), size);
+  return GST_PAD_PROBE_HANDLED;
+}
+
+// New caps apply from the next buffer on, so at the sink they're kept for
+// on_gst_buffer to pick up with it. Before the scaler it's the size frames
+// are scaled from which changes. The sink's segment is kept for the
+// buffers' running times.
+GstPadProbeReturn
+GStreamerPipeline::on_stream_event(GstPad *pad, GstPadProbeInfo *info, GStreamerPipeline *p)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+  if ((GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) && (GST_PAD_PARENT(pad) == p->m_videosink)) {
+    gst_event_copy_segment(event, &p->m_segment);
+    return GST_PAD_PROBE_OK;
+  }
+  if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstCaps *caps;
+  gst_event_parse_caps(event, &caps);
+
+  if (GST_PAD_PARENT(pad) == p->m_videosink) {
+    if (p->m_pendingCaps) {
+      gst_caps_unref(p->m_pendingCaps);
+    }
+    p->m_pendingCaps = gst_caps_ref(caps);
+  }
+  else if (p->m_vidInfoValid) {
+    int width = 0, height = 0;
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    gst_structure_get_int(structure, "width", &width);
+    gst_structure_get_int(structure, "height", &height);
+    QMutexLocker locker(&p->m_scaleMutex);
+    if ((width != p->m_sourceWidth) || (height != p->m_sourceHeight)) {
+      LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d source now %dx%d", p->getVidIx(), width, height);
+      p->m_sourceWidth = width;
+      p->m_sourceHeight = height;
+      // Scaled size was worked out from the old one
+      p->setScaleDivisor(p->m_scaleDivisor);
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 // fakesink handoff callback
 void
 GStreamerPipeline::on_gst_buffer(GstElement *element, GstBuffer *buf, GstPad *pad, GStreamerPipeline *p)
@@ -179,8 +619,74 @@ GStreamerPipeline::on_gst_buffer(GstElement *element, GstBuffer *buf, GstPad *pa
       LOG(LOG_VIDPIPELINE, Logger::Error, "on_gst_buffer() - Could not get caps for pad!");
     }
 
-    p->m_colFormat = discoverColFormat(buf, caps);
+    p->m_interlacing = discoverInterlacing(caps);
+    if (caps) {
+      p->m_colorimetry = discoverColorimetry(caps);
+    }
+    // Takes the caps reference
+    p->m_colFormat = caps ? discoverColFormat(buf, caps) : ColFmt_Unknown;
+    p->m_streamWidth = p->m_sourceWidth = p->m_width;
+    p->m_streamHeight = p->m_sourceHeight = p->m_height;
+    p->m_streamColFormat = p->m_colFormat;
+    p->m_streamColorimetry = p->m_colorimetry;
+    p->m_streamInterlacing = p->m_interlacing;
     p->m_vidInfoValid = true;
+
+    // Same caps as were just read
+    if (p->m_pendingCaps) {
+      gst_caps_unref(p->m_pendingCaps);
+      p->m_pendingCaps = NULL;
+    }
+  }
+  else if (p->m_pendingCaps) {
+    // Adaptive streams and the scaler change caps mid-stream, the renderer
+    // reconfigures from this buffer on rather than the pipeline restarting
+    GstCaps *caps = p->m_pendingCaps;
+    p->m_pendingCaps = NULL;
+
+    int width = 0, height = 0;
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    gst_structure_get_int(structure, "width", &width);
+    gst_structure_get_int(structure, "height", &height);
+    Interlacing interlacing = discoverInterlacing(caps);
+    Colorimetry colorimetry = discoverColorimetry(caps);
+    // Takes the caps reference
+    ColFormat colFormat = discoverColFormat(buf, caps);
+
+    if ((width != p->m_streamWidth) || (height != p->m_streamHeight) || (colFormat != p->m_streamColFormat) ||
+        (colorimetry.matrix != p->m_streamColorimetry.matrix) ||
+        (colorimetry.fullRange != p->m_streamColorimetry.fullRange) ||
+        (interlacing.mode != p->m_streamInterlacing.mode) ||
+        (interlacing.fieldOrder != p->m_streamInterlacing.fieldOrder)) {
+      LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d frames now %dx%d, format 0x%x, matrix %d%s, interlace mode %d",
+          p->getVidIx(), width, height, colFormat, colorimetry.matrix, colorimetry.fullRange ? " full range" : "",
+          interlacing.mode);
+      p->m_streamWidth = width;
+      p->m_streamHeight = height;
+      p->m_streamColFormat = colFormat;
+      p->m_streamColorimetry = colorimetry;
+      p->m_streamInterlacing = interlacing;
+      p->queueFormatChange(buf, width, height, colFormat, colorimetry, interlacing);
+    }
+  }
+
+  // Not synced to the clock, so this is what stops decoding running away.
+  // Woken as soon as the renderer takes a frame, or by Stop.
+  while (p->m_syncToRenderer && !p->m_stopping &&
+         !p->m_incomingBufQueue.waitForRoom(PIPELINE_SYNC_MAX_QUEUED, QUEUE_THREADBLOCK_WAITTIME_MS)) {
+  }
+
+  qint64 runningTimeNs = -1;
+  if (GST_BUFFER_PTS_IS_VALID(buf) && (p->m_segment.format == GST_FORMAT_TIME)) {
+    guint64 runningTime = gst_segment_to_running_time(&p->m_segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buf));
+    if (runningTime != GST_CLOCK_TIME_NONE) {
+      runningTimeNs = (qint64)runningTime;
+      p->m_playedNs = runningTimeNs + (GST_BUFFER_DURATION_IS_VALID(buf) ? (qint64)GST_BUFFER_DURATION(buf) : 0);
+    }
+  }
+  {
+    QMutexLocker locker(&p->m_runningTimeMutex);
+    p->m_bufRunningTimesNs.insert(buf, runningTimeNs);
   }
 
   // ref then push buffer to use it in qt
@@ -191,6 +697,23 @@ GStreamerPipeline::on_gst_buffer(GstElement *element, GstBuffer *buf, GstPad *pa
   p->NotifyNewFrame();
 }
 
+// Synced frames are decoded ahead of when the renderer picks them, so the
+// last few would be thrown away if stopped as soon as they're all decoded
+void
+GStreamerPipeline::stopWhenDrained()
+{
+  if (m_stopping) {
+    return;
+  }
+
+  if (m_incomingBufQueue.size() == 0) {
+    Stop();
+  }
+  else {
+    QTimer::singleShot(PIPELINE_SYNC_WAIT_MS, this, SLOT(stopWhenDrained()));
+  }
+}
+
 gboolean
 GStreamerPipeline::bus_call(GstBus *bus, GstMessage *msg, GStreamerPipeline *p)
 {
@@ -199,7 +722,12 @@ GStreamerPipeline::bus_call(GstBus *bus, GstMessage *msg, GStreamerPipeline *p)
   switch (GST_MESSAGE_TYPE(msg)) {
   case GST_MESSAGE_EOS:
     LOG(LOG_VIDPIPELINE, Logger::Debug1, "End-of-stream received. Stopping.");
-    p->Stop();
+    if (p->m_syncToRenderer) {
+      p->stopWhenDrained();
+    }
+    else {
+      p->Stop();
+    }
     break;
 
   case GST_MESSAGE_ERROR: {
@@ -313,6 +841,16 @@ GStreamerPipeline::discoverColFormat(GstBuffer *buf, GstCaps *pCaps)
         ret = ColFmt_I420;
         break;
 
+    case GST_VIDEO_FORMAT_P010_10LE:
+      LOG(LOG_VIDPIPELINE, Logger::Info, "P010 (0x%X)", uiFourCC);
+      ret = ColFmt_P010;
+      break;
+
+    case GST_VIDEO_FORMAT_I420_10LE:
+      LOG(LOG_VIDPIPELINE, Logger::Info, "I420_10LE (0x%X)", uiFourCC);
+      ret = ColFmt_I420_10LE;
+      break;
+
     case GST_VIDEO_FORMAT_IYU1:
     case GST_VIDEO_FORMAT_IYU2:
     case GST_MAKE_FOURCC('I', 'Y', 'U', 'V'):
@@ -427,6 +965,11 @@ GstOutgoingBufThread::run()
     GstBuffer *buf_old = NULL;
     if (m_pipelinePtr->m_outgoingBufQueue.get((void **)(&buf_old), QUEUE_THREADBLOCK_WAITTIME_MS)) {
       if (buf_old) {
+        {
+          QMutexLocker locker(&m_pipelinePtr->m_runningTimeMutex);
+          m_pipelinePtr->m_bufRunningTimesNs.remove(buf_old);
+        }
+        m_pipelinePtr->formatChangeBufReturned(buf_old);
         gst_buffer_unref(buf_old);
         LOG(LOG_VIDPIPELINE, Logger::Debug2, "GStreamerPipeline: vid %d popped buffer %p from outgoing queue", m_pipelinePtr->getVidIx(), buf_old);
         LOG(LOG_VIDPIPELINE, Logger::Debug2, "GStreamerPipeline: vid %d m_outgoingBufQueue size is = %d", m_pipelinePtr->getVidIx(), m_pipelinePtr->m_outgoingBufQueue.size());
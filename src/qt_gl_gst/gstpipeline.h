@@ -4,6 +4,9 @@
 
 #include <QWidget>
 #include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <atomic>
 
 #include <gst/gst.h>
 #include <gst/video/video-info.h>
@@ -62,9 +65,17 @@ public:
 
   void Configure();
   void Start();
+  qint64 getBufferAgeNs(void *buf);
+  qint64 getBufferRunningTimeNs(void *buf);
+  FieldOrder getBufferFieldOrder(void *buf);
+  void setThrottled(bool throttled);
+  void setBufferPool(PboBufferPool *pool);
 
   // bit lazy just making these public for gst callbacks, but it'll do for now
   GstElement *m_source;
+  GstElement *m_capsfilter;
+  GstElement *m_videoscale;
+  GstElement *m_scalecaps;
   GstElement *m_decodebin;
   GstElement *m_videosink;
   GstElement *m_audiosink;
@@ -79,11 +90,36 @@ public Q_SLOTS:
 
 private slots:
   void cleanUp();
+  void stopWhenDrained();
 
 protected:
+  void setScaleDivisor(int divisor);
+  // Configure steps shared by the GStreamer backends
+  void createSource();
+  void linkSource(GstElement *downstream);
+  void watchVideoSink();
+  void watchBusAndPause();
+
   GMainLoop *m_loop;
   GstBus *m_bus;
   GstElement *m_pipeline;
+  // Format of the buffers currently coming through, streaming thread only
+  int m_streamWidth;
+  int m_streamHeight;
+  ColFormat m_streamColFormat;
+  Colorimetry m_streamColorimetry;
+  Interlacing m_streamInterlacing;
+  // From the last CAPS event, applies from the next buffer
+  GstCaps *m_pendingCaps;
+  // From the last SEGMENT event at the sink, streaming thread only
+  GstSegment m_segment;
+  // Worked out from the segment as each buffer comes through, by buffer
+  QMutex m_runningTimeMutex;
+  QHash<void *, qint64> m_bufRunningTimesNs;
+  // Lets a streaming thread held back for the renderer give up
+  std::atomic<bool> m_stopping;
+  // Read by the streaming threads when they ask for buffers
+  std::atomic<PboBufferPool *> m_pboPool;
 
   GstIncomingBufThread *m_incomingBufThread;
   GstOutgoingBufThread *m_outgoingBufThread;
@@ -92,9 +128,14 @@ protected:
 
   static void on_gst_buffer(GstElement *element, GstBuffer *buf, GstPad *pad, GStreamerPipeline *p);
   static void on_new_pad(GstElement *element, GstPad *pad, GStreamerPipeline *p);
+  static GstPadProbeReturn on_stream_event(GstPad *pad, GstPadProbeInfo *info, GStreamerPipeline *p);
+  static GstPadProbeReturn on_allocation_query(GstPad *pad, GstPadProbeInfo *info, GStreamerPipeline *p);
   static gboolean bus_call(GstBus *bus, GstMessage *msg, GStreamerPipeline *p);
   static ColFormat discoverColFormat(GstBuffer *buffer, GstCaps *pCaps);
+  static Colorimetry discoverColorimetry(GstCaps *caps);
+  static Interlacing discoverInterlacing(GstCaps *caps);
   static quint32 discoverFourCC(GstBuffer *buf);
+  static GstCaps *syntheticLocationToCaps(const QString &location);
 };
 
 #endif
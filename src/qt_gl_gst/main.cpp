@@ -1,12 +1,36 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "glwidget.h"
+#include "applogger.h"
 
 int
 main(int argc, char *argv[])
 {
   QApplication a(argc, argv);
 
-  MainWindow mainWindow(argc, argv);
+  // QApplication has already removed any Qt options from argv
+  AppOptions options;
+  if (options.Parse(argc, argv) == false) {
+    options.PrintUsage(argv[0]);
+    return 1;
+  }
+
+  if (options.m_headless) {
+    // Nothing logged per frame so it doesn't skew the timings. GL's one-off
+    // setup messages (version, render target) are still shown.
+    GlobalLog.SetModuleLogLevel(LOG_GL, Logger::Info);
+    GlobalLog.SetModuleLogLevel(LOG_GLSHADERS, Logger::Warning);
+    GlobalLog.SetModuleLogLevel(LOG_OBJLOADER, Logger::Warning);
+    GlobalLog.SetModuleLogLevel(LOG_VIDPIPELINE, Logger::Warning);
+
+    GLWidget glWidget(options);
+    glWidget.initVideo();
+    glWidget.startHeadless();
+
+    return a.exec();
+  }
+
+  MainWindow mainWindow(options);
   mainWindow.show();
 //  mainWindow.showFullScreen();
 
@@ -8,7 +8,7 @@
 #endif
 #include "controlsform.h"
 
-MainWindow::MainWindow(int argc, char *argv[], QWidget *parent) :
+MainWindow::MainWindow(const AppOptions &options, QWidget *parent) :
   QMainWindow(parent)
 {
   GlobalLog.SetModuleLogLevel(LOG_GL, Logger::Info);
@@ -17,9 +17,9 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent) :
   GlobalLog.SetModuleLogLevel(LOG_VIDPIPELINE, Logger::Debug2);
 
 #ifdef OMAP3530
-  GLWidget *glWidget = new GLPowerVRWidget(argc, argv, this);
+  GLWidget *glWidget = new GLPowerVRWidget(options, this);
 #else
-  GLWidget *glWidget = new GLWidget(argc, argv, this);
+  GLWidget *glWidget = new GLWidget(options, this);
 #endif
   glWidget->initVideo();
 
@@ -2,14 +2,14 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-
+#include "appoptions.h"
 
 class MainWindow : public QMainWindow
 {
   Q_OBJECT
 
 public:
-  explicit MainWindow(int argc, char *argv[], QWidget *parent = 0);
+  explicit MainWindow(const AppOptions &options, QWidget *parent = 0);
     
 signals:
     
@@ -0,0 +1,376 @@
+#include <string.h>
+#include <QElapsedTimer>
+#include <gst/video/video.h>
+#include "pbobufferpool.h"
+#include "applogger.h"
+
+// GstBufferPool handing out frames from a PboBufferPool's arena
+
+typedef struct _PboGstBufferPool
+{
+  GstBufferPool parent;
+  PboBufferPool *owner;
+  guint frameBytes;
+} PboGstBufferPool;
+
+typedef struct _PboGstBufferPoolClass
+{
+  GstBufferPoolClass parent_class;
+} PboGstBufferPoolClass;
+
+// Frees the frame back to the arena when its memory goes
+typedef struct _PboFrame
+{
+  PboBufferPool *owner;
+  qint64 offset;
+  qint64 bytes;
+} PboFrame;
+
+G_DEFINE_TYPE(PboGstBufferPool, pbo_gst_buffer_pool, GST_TYPE_BUFFER_POOL)
+
+static void
+pbo_gst_buffer_pool_free_frame(gpointer data)
+{
+  PboFrame *frame = (PboFrame *)data;
+  frame->owner->freeFrame(frame->offset, frame->bytes);
+  frame->owner->unref();
+  delete frame;
+}
+
+static gboolean
+pbo_gst_buffer_pool_set_config(GstBufferPool *pool, GstStructure *config)
+{
+  PboGstBufferPool *pboPool = (PboGstBufferPool *)pool;
+
+  if (!gst_buffer_pool_config_get_params(config, NULL, &pboPool->frameBytes, NULL, NULL)) {
+    return FALSE;
+  }
+
+  return GST_BUFFER_POOL_CLASS(pbo_gst_buffer_pool_parent_class)->set_config(pool, config);
+}
+
+static GstFlowReturn
+pbo_gst_buffer_pool_alloc_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+  Q_UNUSED(params);
+  PboGstBufferPool *pboPool = (PboGstBufferPool *)pool;
+
+  qint64 offset = pboPool->owner->allocFrame(pboPool->frameBytes);
+  if (offset < 0) {
+    // Still works, the renderer just copies these ones
+    pboPool->owner->countFallbackAlloc();
+    *buffer = gst_buffer_new_allocate(NULL, pboPool->frameBytes, NULL);
+    return (*buffer) ? GST_FLOW_OK : GST_FLOW_ERROR;
+  }
+
+  PboFrame *frame = new PboFrame;
+  frame->owner = pboPool->owner;
+  frame->offset = offset;
+  frame->bytes = pboPool->frameBytes;
+  frame->owner->ref();
+
+  *buffer = gst_buffer_new();
+  gst_buffer_append_memory(*buffer, gst_memory_new_wrapped((GstMemoryFlags)0, pboPool->owner->data() + offset,
+                                                           pboPool->frameBytes, 0, pboPool->frameBytes,
+                                                           frame, pbo_gst_buffer_pool_free_frame));
+  return GST_FLOW_OK;
+}
+
+static void
+pbo_gst_buffer_pool_finalize(GObject *object)
+{
+  PboGstBufferPool *pboPool = (PboGstBufferPool *)object;
+  if (pboPool->owner) {
+    pboPool->owner->unref();
+  }
+
+  G_OBJECT_CLASS(pbo_gst_buffer_pool_parent_class)->finalize(object);
+}
+
+static void
+pbo_gst_buffer_pool_class_init(PboGstBufferPoolClass *klass)
+{
+  G_OBJECT_CLASS(klass)->finalize = pbo_gst_buffer_pool_finalize;
+  GST_BUFFER_POOL_CLASS(klass)->set_config = pbo_gst_buffer_pool_set_config;
+  GST_BUFFER_POOL_CLASS(klass)->alloc_buffer = pbo_gst_buffer_pool_alloc_buffer;
+}
+
+static void
+pbo_gst_buffer_pool_init(PboGstBufferPool *pool)
+{
+  pool->owner = NULL;
+  pool->frameBytes = 0;
+}
+
+
+PboBufferPool::PboBufferPool() :
+  m_available(false), m_bufferId(0), m_data(NULL), m_size(0), m_uploads(0), m_releasesDeferred(0), m_bytesInUse(0), m_shuttingDown(false)
+{
+  // The widget's reference
+  m_refs.ref();
+}
+
+// Can be on any thread, the GL side has already gone in Shutdown
+PboBufferPool::~PboBufferPool()
+{
+}
+
+bool
+PboBufferPool::Init(const QGLContext *context, qint64 bytes)
+{
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  if (extensions == NULL) {
+    LOG(LOG_GL, Logger::Warning, "Can't get GL extensions, frames will be copied");
+    return false;
+  }
+
+  if (!strstr(extensions, "GL_ARB_buffer_storage") || !strstr(extensions, "GL_ARB_sync")) {
+    LOG(LOG_GL, Logger::Info, "No persistently mapped buffer support, frames will be copied");
+    return false;
+  }
+
+  if (!m_glExt.ResolveBuffers(context) || !m_glExt.ResolveBufferStorage(context) ||
+      !m_glExt.ResolveSync(context)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't get pixel buffer functions, frames will be copied");
+    return false;
+  }
+
+  // Written by the decoders only, read by the GPU
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  m_glExt.glGenBuffers(1, &m_bufferId);
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferId);
+  m_glExt.glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags);
+  m_data = (uchar *)m_glExt.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (m_data == NULL) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't map %lld byte pixel buffer, frames will be copied", bytes);
+    m_glExt.glDeleteBuffers(1, &m_bufferId);
+    return false;
+  }
+
+  m_size = bytes;
+  m_freeRanges.insert(0, bytes);
+
+  LOG(LOG_GL, Logger::Info, "Decoders can write frames into a %lld MB mapped pixel buffer", bytes / (1024 * 1024));
+  m_available = true;
+  return true;
+}
+
+void
+PboBufferPool::Shutdown()
+{
+  if (!m_available) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_shuttingDown = true;
+
+    QElapsedTimer waitTime;
+    waitTime.start();
+    while ((m_bytesInUse > 0) && (waitTime.elapsed() < PBOPOOL_SHUTDOWN_TIMEOUT_MS)) {
+      m_frameFreed.wait(&m_mutex, (unsigned long)(PBOPOOL_SHUTDOWN_TIMEOUT_MS - waitTime.elapsed()));
+    }
+
+    // Unmapping now would leave them pointing at nothing, so the buffer's
+    // left for the context to take with it
+    if (m_bytesInUse > 0) {
+      LOG(LOG_GL, Logger::Error, "%lld bytes of frames still held after %d ms, pixel buffer left mapped",
+          m_bytesInUse, PBOPOOL_SHUTDOWN_TIMEOUT_MS);
+      return;
+    }
+  }
+
+  QMap<qint64, GLsync>::const_iterator fenceIt;
+  for (fenceIt = m_uploadFences.constBegin(); fenceIt != m_uploadFences.constEnd(); ++fenceIt) {
+    m_glExt.glDeleteSync(fenceIt.value());
+  }
+  m_uploadFences.clear();
+
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferId);
+  m_glExt.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  m_glExt.glDeleteBuffers(1, &m_bufferId);
+
+  // No frame can be in a zero sized arena, whatever its address
+  m_size = 0;
+  m_available = false;
+}
+
+GstBufferPool *
+PboBufferPool::NewGstBufferPool(GstCaps *caps)
+{
+  GstVideoInfo info;
+  if ((caps == NULL) || !gst_video_info_from_caps(&info, caps)) {
+    return NULL;
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    if (m_shuttingDown) {
+      return NULL;
+    }
+  }
+
+  PboGstBufferPool *pool = (PboGstBufferPool *)g_object_new(pbo_gst_buffer_pool_get_type(), NULL);
+  pool->owner = this;
+  ref();
+
+  GstStructure *config = gst_buffer_pool_get_config(GST_BUFFER_POOL(pool));
+  gst_buffer_pool_config_set_params(config, caps, info.size, PBOPOOL_MIN_BUFFERS, 0);
+  if (!gst_buffer_pool_set_config(GST_BUFFER_POOL(pool), config)) {
+    gst_object_unref(pool);
+    return NULL;
+  }
+
+  return GST_BUFFER_POOL(pool);
+}
+
+bool
+PboBufferPool::BeginUpload(void *buf, const void **pixels)
+{
+  qint64 offset;
+  if (!frameOffset(buf, offset)) {
+    return false;
+  }
+
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_bufferId);
+  *pixels = (const void *)(quintptr)offset;
+  return true;
+}
+
+void
+PboBufferPool::EndUpload(void *buf)
+{
+  m_glExt.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  qint64 offset;
+  if (!frameOffset(buf, offset)) {
+    return;
+  }
+
+  // Only the latest upload from the frame matters
+  if (m_uploadFences.contains(offset)) {
+    m_glExt.glDeleteSync(m_uploadFences.take(offset));
+  }
+  m_uploadFences.insert(offset, m_glExt.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  m_uploads++;
+}
+
+bool
+PboBufferPool::IsUploaded(void *buf)
+{
+  qint64 offset;
+  if (!m_available || m_uploadFences.isEmpty() || !frameOffset(buf, offset) ||
+      !m_uploadFences.contains(offset)) {
+    return true;
+  }
+
+  GLsync fence = m_uploadFences.value(offset);
+  GLenum waitRet = m_glExt.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (waitRet == GL_TIMEOUT_EXPIRED) {
+    m_releasesDeferred++;
+    return false;
+  }
+
+  if (waitRet == GL_WAIT_FAILED) {
+    LOG(LOG_GL, Logger::Warning, "Waiting for a frame upload failed, giving it back anyway");
+  }
+  m_uploadFences.remove(offset);
+  m_glExt.glDeleteSync(fence);
+  return true;
+}
+
+void
+PboBufferPool::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("pbopool_uploads", m_uploads);
+  stats.SetCounter("pbopool_releases_deferred", m_releasesDeferred);
+  stats.SetCounter("pbopool_fallback_allocs", m_fallbackAllocs.load());
+  stats.SetCounter("pbopool_bytes", m_size);
+
+  QMutexLocker locker(&m_mutex);
+  stats.SetCounter("pbopool_bytes_in_use", m_bytesInUse);
+}
+
+// First fit, frames are mostly all the same few sizes
+qint64
+PboBufferPool::allocFrame(qint64 bytes)
+{
+  QMutexLocker locker(&m_mutex);
+  if (m_shuttingDown) {
+    return -1;
+  }
+
+  qint64 alignedBytes = (bytes + PBOPOOL_ALIGNMENT - 1) & ~((qint64)PBOPOOL_ALIGNMENT - 1);
+  QMap<qint64, qint64>::iterator rangeIt;
+  for (rangeIt = m_freeRanges.begin(); rangeIt != m_freeRanges.end(); ++rangeIt) {
+    if (rangeIt.value() >= alignedBytes) {
+      qint64 offset = rangeIt.key();
+      qint64 remaining = rangeIt.value() - alignedBytes;
+      m_freeRanges.erase(rangeIt);
+      if (remaining > 0) {
+        m_freeRanges.insert(offset + alignedBytes, remaining);
+      }
+      m_bytesInUse += alignedBytes;
+      return offset;
+    }
+  }
+
+  return -1;
+}
+
+void
+PboBufferPool::freeFrame(qint64 offset, qint64 bytes)
+{
+  QMutexLocker locker(&m_mutex);
+
+  qint64 alignedBytes = (bytes + PBOPOOL_ALIGNMENT - 1) & ~((qint64)PBOPOOL_ALIGNMENT - 1);
+  m_bytesInUse -= alignedBytes;
+  m_frameFreed.wakeAll();
+
+  // Merge with the free ranges either side
+  QMap<qint64, qint64>::iterator nextIt = m_freeRanges.lowerBound(offset);
+  if ((nextIt != m_freeRanges.end()) && (nextIt.key() == offset + alignedBytes)) {
+    alignedBytes += nextIt.value();
+    nextIt = m_freeRanges.erase(nextIt);
+  }
+  if (nextIt != m_freeRanges.begin()) {
+    QMap<qint64, qint64>::iterator prevIt = nextIt - 1;
+    if (prevIt.key() + prevIt.value() == offset) {
+      prevIt.value() += alignedBytes;
+      return;
+    }
+  }
+  m_freeRanges.insert(offset, alignedBytes);
+}
+
+// Last one out deletes, on whichever thread that is
+void
+PboBufferPool::unref()
+{
+  if (!m_refs.deref()) {
+    delete this;
+  }
+}
+
+bool
+PboBufferPool::frameOffset(void *buf, qint64 &offset)
+{
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if (!m_available || (gstBuf == NULL) || (gst_buffer_n_memory(gstBuf) != 1)) {
+    return false;
+  }
+
+  // Wrapped memory maps to its data pointer, nothing's copied
+  GstMapInfo info;
+  if (!gst_buffer_map(gstBuf, &info, GST_MAP_READ)) {
+    return false;
+  }
+  offset = info.data - m_data;
+  gst_buffer_unmap(gstBuf, &info);
+
+  return (offset >= 0) && (offset < m_size);
+}
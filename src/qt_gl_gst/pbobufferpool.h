@@ -0,0 +1,103 @@
+#ifndef PBOBUFFERPOOL_H
+#define PBOBUFFERPOOL_H
+
+#include <QGLContext>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMap>
+#include <QAtomicInt>
+
+#include <gst/gst.h>
+
+#include "renderstats.h"
+#include "glextfunctions.h"
+
+// Frames start on this boundary within the arena
+#define PBOPOOL_ALIGNMENT                    256
+// Buffers each GstBufferPool asks upstream to keep around
+#define PBOPOOL_MIN_BUFFERS                  4
+// How often frames held back for the GPU to finish reading them are
+// checked again
+#define PBOPOOL_RELEASE_POLL_MS              2
+// Longest Shutdown waits for the decoders to give every frame back
+#define PBOPOOL_SHUTDOWN_TIMEOUT_MS          2000
+
+// Lets decoders write frames straight into GPU visible memory. One pixel
+// buffer is allocated with ARB_buffer_storage and mapped persistently, then
+// frames are handed out of it by GstBufferPools offered to upstream in
+// answer to ALLOCATION queries. Uploading a frame is then a buffer to
+// texture copy on the GPU, rather than a memcpy on the CPU by the driver.
+//
+// Frames are only given back to the decoder once the GPU has finished
+// reading them, fenced with ARB_sync. If the arena is full, frames are
+// allocated in normal memory and just copied as before.
+//
+// The pixel buffer belongs to the GL thread, which takes it down with
+// Shutdown once every frame is back. The object itself is refcounted, as
+// the last frame can be freed on any thread.
+class PboBufferPool
+{
+public:
+  PboBufferPool();
+  ~PboBufferPool();
+
+  // Context must be current. Returns false if persistently mapped buffers
+  // aren't supported, in which case frames are copied as before.
+  bool Init(const QGLContext *context, qint64 bytes);
+  bool IsAvailable() const { return m_available; }
+  // Context must be current. Waits for the decoders to give back every
+  // frame in the arena, then unmaps and deletes the pixel buffer. Frames
+  // allocated after this come from normal memory.
+  void Shutdown();
+
+  // Any thread. New GstBufferPool for frames of these caps, or NULL if they
+  // aren't raw video. Caller owns the reference.
+  GstBufferPool *NewGstBufferPool(GstCaps *caps);
+
+  // Renderer side, context must be current. If the frame is in the arena,
+  // binds the pixel buffer and sets pixels to the frame's offset to upload
+  // from, then EndUpload unbinds it and fences the upload.
+  bool BeginUpload(void *buf, const void **pixels);
+  void EndUpload(void *buf);
+  // Whether the GPU has finished every upload from the frame, so it can
+  // go back to its pipeline. Never waits.
+  bool IsUploaded(void *buf);
+
+  void ReportStats(RenderStats &stats) const;
+
+  // Used by the GstBufferPool, the mutex is taken inside
+  qint64 allocFrame(qint64 bytes);
+  void freeFrame(qint64 offset, qint64 bytes);
+  uchar *data() const { return m_data; }
+  void ref() { m_refs.ref(); }
+  void unref();
+  void countFallbackAlloc() { m_fallbackAllocs.ref(); }
+
+private:
+  bool frameOffset(void *buf, qint64 &offset);
+
+  bool m_available;
+  GLuint m_bufferId;
+  uchar *m_data;
+  qint64 m_size;
+  // Widget and every frame and GstBufferPool hold one
+  QAtomicInt m_refs;
+
+  GLExtFunctions m_glExt;
+
+  // Renderer thread only, fence of each frame's last upload by offset
+  QMap<qint64, GLsync> m_uploadFences;
+  qint64 m_uploads;
+  qint64 m_releasesDeferred;
+
+  // Free ranges, offset to size, shared with the streaming threads
+  mutable QMutex m_mutex;
+  QMap<qint64, qint64> m_freeRanges;
+  qint64 m_bytesInUse;
+  // Set by Shutdown, nothing more is handed out of the arena
+  bool m_shuttingDown;
+  QWaitCondition m_frameFreed;
+  QAtomicInt m_fallbackAllocs;
+};
+
+#endif // PBOBUFFERPOOL_H
@@ -1,13 +1,128 @@
 
 #include "pipeline.h"
+#include "pipelineclock.h"
+#include "applogger.h"
 
 Pipeline::Pipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent) :
   QObject(parent), m_vidIx(vidIx), m_videoLocation(videoLocation), m_colFormat(ColFmt_Unknown),
-  m_vidInfoValid(false), m_finished(false)
+  m_vidInfoValid(false), m_finished(false), m_syncToRenderer(false), m_baseTimeNs(-1), m_playedNs(0), m_offline(false),
+  m_scaleToTarget(false), m_sourceWidth(0), m_sourceHeight(0), m_scaleDivisor(1)
 {
+  m_colorimetry.matrix = ColMatrix_Unknown;
+  m_colorimetry.fullRange = false;
+  m_interlacing.mode = Interlace_Progressive;
+  m_interlacing.fieldOrder = Fields_Progressive;
+
   QObject::connect(this, SIGNAL(newFrameReady(int)), this->parent(), renderer_slot, Qt::QueuedConnection);
 }
 
 Pipeline::~Pipeline()
 {
 }
+
+void
+Pipeline::setTargetSize(const QSize &size)
+{
+  // Source size isn't known until the first frame
+  if (!m_scaleToTarget || (m_sourceWidth <= 0) || (m_sourceHeight <= 0)) {
+    return;
+  }
+
+  QMutexLocker locker(&m_scaleMutex);
+  int sourceWidth = m_sourceWidth;
+  int sourceHeight = m_sourceHeight;
+
+  // Biggest divisor which still gives at least the target size
+  int divisor = 1;
+  while (divisor < PIPELINE_MAX_SCALE_DIVISOR) {
+    int nextDivisor = divisor * 2;
+    float headroom = (nextDivisor > m_scaleDivisor) ? PIPELINE_SCALE_HYSTERESIS : 1.0f;
+    if (((sourceWidth / nextDivisor) < (size.width() * headroom)) ||
+        ((sourceHeight / nextDivisor) < (size.height() * headroom))) {
+      break;
+    }
+    divisor = nextDivisor;
+  }
+
+  if (divisor != m_scaleDivisor) {
+    LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d target %dx%d, scale divisor %d -> %d",
+        m_vidIx, size.width(), size.height(), (int)m_scaleDivisor, divisor);
+    m_scaleDivisor = divisor;
+    setScaleDivisor(divisor);
+  }
+}
+
+qint64
+Pipeline::getRunningTimeNs()
+{
+  if (!m_syncToRenderer) {
+    return -1;
+  }
+  return PipelineClock::NowNs() - m_baseTimeNs;
+}
+
+bool
+Pipeline::takeFormatChange(void *buf)
+{
+  QMutexLocker locker(&m_formatChangeMutex);
+
+  bool changed = false;
+  // Buffers which went back without being taken still changed the format
+  // of everything after them
+  while (!m_formatChanges.isEmpty() && m_formatChanges.first().returned) {
+    applyFormatChange(m_formatChanges.takeFirst());
+    changed = true;
+  }
+
+  if (!m_formatChanges.isEmpty() && (m_formatChanges.first().buf == buf)) {
+    applyFormatChange(m_formatChanges.takeFirst());
+    changed = true;
+  }
+  return changed;
+}
+
+void
+Pipeline::applyFormatChange(const FormatChange &change)
+{
+  m_width = change.width;
+  m_height = change.height;
+  m_colFormat = change.colFormat;
+  m_colorimetry = change.colorimetry;
+  m_interlacing = change.interlacing;
+}
+
+void
+Pipeline::queueFormatChange(void *buf, int width, int height, ColFormat colFormat,
+                            const Colorimetry &colorimetry, const Interlacing &interlacing)
+{
+  QMutexLocker locker(&m_formatChangeMutex);
+
+  FormatChange change;
+  change.buf = buf;
+  change.returned = false;
+  change.width = width;
+  change.height = height;
+  change.colFormat = colFormat;
+  change.colorimetry = colorimetry;
+  change.interlacing = interlacing;
+  m_formatChanges.append(change);
+}
+
+void
+Pipeline::formatChangeBufReturned(void *buf)
+{
+  QMutexLocker locker(&m_formatChangeMutex);
+
+  for (int changeIx = 0; changeIx < m_formatChanges.size(); changeIx++) {
+    if (m_formatChanges[changeIx].buf == buf) {
+      m_formatChanges[changeIx].returned = true;
+    }
+  }
+}
+
+void
+Pipeline::clearFormatChanges()
+{
+  QMutexLocker locker(&m_formatChangeMutex);
+  m_formatChanges.clear();
+}
@@ -2,6 +2,10 @@
 #define PIPELINE_H
 
 #include <QWidget>
+#include <QMutex>
+#include <QList>
+#include <QSize>
+#include <atomic>
 #include "asyncwaitingqueue.h"
 
 #define COLFMT_FOUR_CC(a,b,c,d) \
@@ -22,6 +26,11 @@ typedef enum _ColFormat
   ColFmt_Y422 = COLFMT_FOUR_CC('Y', '4', '2', '2'),
   ColFmt_UYNV = COLFMT_FOUR_CC('U', 'Y', 'N', 'V'),
 
+  // 10 bit in 16 bit little endian samples. P010 is NV12 layout with the
+  // value in the top bits, I420_10LE I420 layout with it in the bottom bits.
+  ColFmt_P010 = COLFMT_FOUR_CC('P', '0', '1', '0'),
+  ColFmt_I420_10LE = COLFMT_FOUR_CC('I', '0', 'A', 'L'),
+
   // Also capture RGBs in the same enum
   ColFmt_RGB888 = COLFMT_FOUR_CC('R', 'G', 'B', '8'),
   ColFmt_BGR888,
@@ -31,6 +40,69 @@ typedef enum _ColFormat
   ColFmt_Unknown
 } ColFormat;
 
+// How the lines of a frame were captured
+typedef enum _FieldOrder
+{
+  Fields_Progressive,
+  Fields_TopFirst,
+  Fields_BottomFirst
+} FieldOrder;
+
+typedef enum _InterlaceMode
+{
+  Interlace_Progressive,
+  // Every frame is
+  Interlace_Interleaved,
+  // Only the frames flagged as interlaced are
+  Interlace_Mixed
+} InterlaceMode;
+
+typedef struct _Interlacing
+{
+  InterlaceMode mode;
+  // Fields_Progressive if the source doesn't say, then each frame does
+  FieldOrder fieldOrder;
+} Interlacing;
+
+// Which YUV to RGB matrix the frames were encoded for
+typedef enum _ColMatrix
+{
+  ColMatrix_Unknown,
+  ColMatrix_BT601,
+  ColMatrix_BT709,
+  ColMatrix_BT2020,
+  ColMatrix_SMPTE240M,
+  ColMatrix_FCC
+} ColMatrix;
+
+typedef struct _Colorimetry
+{
+  ColMatrix matrix;
+  // Samples use the whole 0-255 range, rather than 16-235 luma and 16-240
+  // chroma
+  bool fullRange;
+} Colorimetry;
+
+// Video locations starting with this are generated rather than read from a
+// file, in the form "synthetic:<fourcc>:<width>x<height>@<fps>",
+// e.g. "synthetic:I420:1280x720@30"
+#define SYNTHETIC_VIDEO_LOCATION_PREFIX   "synthetic:"
+
+// Frames are scaled down by at most this, in power of two steps
+#define PIPELINE_MAX_SCALE_DIVISOR        8
+// Frame interval hidden videos are throttled to
+#define PIPELINE_THROTTLED_INTERVAL_NS    (500 * 1000 * 1000)
+// Frames decoded ahead of when they're due for the renderer to pick from,
+// when synced to it
+#define PIPELINE_SYNC_MAX_QUEUED          4
+// How often a pipeline held back by a full queue checks again
+#define PIPELINE_SYNC_WAIT_MS             2
+// Only step down to a smaller size when it's still this much bigger than
+// the target, so sizes near a step boundary don't keep renegotiating
+#define PIPELINE_SCALE_HYSTERESIS         1.25f
+
+class PboBufferPool;
+
 class Pipeline : public QObject
 {
   Q_OBJECT
@@ -47,6 +119,46 @@ public:
   int getWidth() { return m_width; }
   int getHeight() { return m_height; }
   ColFormat getColourFormat() { return m_colFormat; }
+  Colorimetry getColorimetry() { return m_colorimetry; }
+  Interlacing getInterlacing() { return m_interlacing; }
+  // How long ago the buffer was due to be presented, or -1 if not known
+  virtual qint64 getBufferAgeNs(void *buf) { Q_UNUSED(buf); return -1; }
+  // Running time the buffer is due at, or -1 if not known
+  virtual qint64 getBufferRunningTimeNs(void *buf) { Q_UNUSED(buf); return -1; }
+  // Whether the buffer's frame is interlaced and which field comes first
+  virtual FieldOrder getBufferFieldOrder(void *buf) { Q_UNUSED(buf); return Fields_Progressive; }
+
+  // Must be called before Configure. Frames then run on the shared
+  // PipelineClock, and come through ahead of when they're due for the
+  // renderer to pick by PTS, rather than as each is due.
+  void enableSyncToRenderer(bool enable) { m_syncToRenderer = enable; }
+  // PipelineClock time running time starts from when synced, before Start
+  void setBaseTimeNs(qint64 baseTimeNs) { m_baseTimeNs = baseTimeNs; }
+  qint64 getBaseTimeNs() { return m_baseTimeNs; }
+  // Running time the last frame through ends at, 0 before the first
+  qint64 getPlayedNs() { return m_playedNs; }
+  // Shared clock running time now, only when synced
+  qint64 getRunningTimeNs();
+  // Must be called before Configure. Nothing is played out, so nothing
+  // holds decoding back to real time. Audio is thrown away.
+  void enableOffline(bool enable) { m_offline = enable; }
+
+  // Must be called before Configure for setTargetSize to have any effect
+  void enableTargetScaling(bool enable) { m_scaleToTarget = enable; }
+  // Ask for frames scaled down towards the size they are displayed at,
+  // where the pipeline supports it
+  void setTargetSize(const QSize &size);
+  // Renderer calls this with every buffer it takes from the incoming queue.
+  // Returns true if the frame size or format changes from this buffer on,
+  // in which case getWidth()/getHeight()/getColourFormat()/getColorimetry()/
+  // getInterlacing() have been updated to match.
+  bool takeFormatChange(void *buf);
+  // Video isn't being looked at, decode as little as possible if the
+  // pipeline can. Frames may still come through, just fewer of them.
+  virtual void setThrottled(bool throttled) { Q_UNUSED(throttled); }
+  // Offer upstream buffers from the renderer's pixel buffer arena to decode
+  // into, where the pipeline can. Can be called after Configure.
+  virtual void setBufferPool(PboBufferPool *pool) { Q_UNUSED(pool); }
 //  virtual unsigned char *bufToVidDataStart(void *buf) = 0;
 
   bool isFinished() { return this->m_finished; }
@@ -62,31 +174,61 @@ public slots:
   virtual void Stop() = 0;
 
 protected:
+  // Subclasses which can scale apply a new divisor of the source size here
+  virtual void setScaleDivisor(int divisor) { Q_UNUSED(divisor); }
+  // Streaming thread side of takeFormatChange, buf is the first in the new
+  // format
+  void queueFormatChange(void *buf, int width, int height, ColFormat colFormat,
+                         const Colorimetry &colorimetry, const Interlacing &interlacing);
+  // With every buffer the renderer gives back, before it's unreffed and
+  // its address can come round again. A change whose buffer was never
+  // taken is then applied with the next one rather than blocking the rest.
+  void formatChangeBufReturned(void *buf);
+  // Once nothing is left in either queue
+  void clearFormatChanges();
+
   int m_vidIx;
   const QString m_videoLocation;
   int m_width;
   int m_height;
   ColFormat m_colFormat;
+  // Matrix left unknown if the source doesn't say
+  Colorimetry m_colorimetry;
+  Interlacing m_interlacing;
   bool m_vidInfoValid;
   bool m_finished;
-};
-
-#if defined OMAP3530
 
- // Don't include derived classes if this include is from the base class
- // header file due to the MOC. In that case, base class is not defined
- // yet but inclusion guard is defined.
- #ifndef GSTPIPELINE_H
-  #include "gstpipeline.h"
-  #ifndef TIGSTPIPELINE_H
-   #include "tigstpipeline.h"
-  #endif
- #endif
-
-#elif defined UNIX
- #include "gstpipeline.h"
-#endif
+  bool m_syncToRenderer;
+  qint64 m_baseTimeNs;
+  std::atomic<qint64> m_playedNs;
+  bool m_offline;
+
+  bool m_scaleToTarget;
+  // Size frames come out of the decoder at, set by subclasses on the
+  // streaming thread and read by the renderer
+  std::atomic<int> m_sourceWidth;
+  std::atomic<int> m_sourceHeight;
+  std::atomic<int> m_scaleDivisor;
+  // Held across working out and applying a new scaled size, which either
+  // thread can do
+  QMutex m_scaleMutex;
+
+private:
+  typedef struct _FormatChange
+  {
+    void *buf;
+    bool returned;
+    int width;
+    int height;
+    ColFormat colFormat;
+    Colorimetry colorimetry;
+    Interlacing interlacing;
+  } FormatChange;
+
+  void applyFormatChange(const FormatChange &change);
+
+  QMutex m_formatChangeMutex;
+  QList<FormatChange> m_formatChanges;
+};
 
 #endif // PIPELINE_H
-
-
@@ -0,0 +1,20 @@
+#include "pipelineclock.h"
+
+GstClock *
+PipelineClock::Clock()
+{
+  static GstClock *s_clock = NULL;
+
+  // System clock is monotonic, and the same one GStreamer would pick
+  if (s_clock == NULL) {
+    gst_init(NULL, NULL);
+    s_clock = gst_system_clock_obtain();
+  }
+  return s_clock;
+}
+
+qint64
+PipelineClock::NowNs()
+{
+  return (qint64)gst_clock_get_time(Clock());
+}
@@ -0,0 +1,24 @@
+#ifndef PIPELINECLOCK_H
+#define PIPELINECLOCK_H
+
+#include <QtGlobal>
+#include <gst/gst.h>
+
+// Slack given to pipelines between being started and their first frame
+// being due, so streams started together don't start late
+#define PIPELINE_SYNC_START_DELAY_NS      (200 * 1000 * 1000)
+
+// The one clock every synced pipeline and the renderer run on. Streams given
+// the same base time then stay frame accurate with each other, rather than
+// each drifting on its own pipeline clock.
+class PipelineClock
+{
+public:
+  // Not reffed for the caller
+  static GstClock *Clock();
+  static qint64 NowNs();
+  // Base time for pipelines starting now
+  static qint64 StartBaseTimeNs() { return NowNs() + PIPELINE_SYNC_START_DELAY_NS; }
+};
+
+#endif // PIPELINECLOCK_H
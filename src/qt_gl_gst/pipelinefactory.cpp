@@ -0,0 +1,159 @@
+#include "pipelinefactory.h"
+#include "gstpipeline.h"
+#include "rawfilepipeline.h"
+#ifdef OMAP3530
+ #include "tigstpipeline.h"
+#endif
+#include "applogger.h"
+
+static Pipeline *
+createGStreamerPipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent)
+{
+  return new GStreamerPipeline(vidIx, videoLocation, renderer_slot, parent);
+}
+
+// decodebin copes with whatever there's a decoder for
+static bool
+gstreamerHandles(const QString &videoLocation)
+{
+  Q_UNUSED(videoLocation);
+  return true;
+}
+
+static Pipeline *
+createRawFilePipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent)
+{
+  return new RawFilePipeline(vidIx, videoLocation, renderer_slot, parent);
+}
+
+#ifdef OMAP3530
+static Pipeline *
+createTIGStreamerPipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent)
+{
+  return new TIGStreamerPipeline(vidIx, videoLocation, renderer_slot, parent);
+}
+
+// Only demuxes mp4/mov, test sources go through decodebin
+static bool
+tiGStreamerHandles(const QString &videoLocation)
+{
+  return !videoLocation.isEmpty() && !videoLocation.startsWith(SYNTHETIC_VIDEO_LOCATION_PREFIX);
+}
+#endif
+
+void
+PipelineFactory::Register(const QString &name, const QString &description,
+                          PipelineCreateFunc createFunc, PipelineHandlesFunc handlesFunc)
+{
+  if (find(name)) {
+    LOG(LOG_VIDPIPELINE, Logger::Warning, "Pipeline backend %s already registered", name.toUtf8().constData());
+    return;
+  }
+
+  Backend backend;
+  backend.name = name;
+  backend.description = description;
+  backend.createFunc = createFunc;
+  backend.handlesFunc = handlesFunc;
+  backends().append(backend);
+}
+
+bool
+PipelineFactory::IsRegistered(const QString &name)
+{
+  return (find(name) != NULL);
+}
+
+QStringList
+PipelineFactory::Names()
+{
+  QStringList names;
+  const QList<Backend> &all = backends();
+  for (int backendIx = 0; backendIx < all.size(); backendIx++) {
+    names.append(all[backendIx].name);
+  }
+  return names;
+}
+
+QString
+PipelineFactory::Description(const QString &name)
+{
+  const Backend *backend = find(name);
+  return backend ? backend->description : QString();
+}
+
+QString
+PipelineFactory::Select(const QString &name, const QString &videoLocation)
+{
+  if (name != PIPELINE_BACKEND_AUTO) {
+    return IsRegistered(name) ? name : QString();
+  }
+
+  const QList<Backend> &all = backends();
+  for (int backendIx = 0; backendIx < all.size(); backendIx++) {
+    if (all[backendIx].handlesFunc(videoLocation)) {
+      return all[backendIx].name;
+    }
+  }
+  return QString();
+}
+
+Pipeline *
+PipelineFactory::Create(const QString &name, int vidIx, const QString &videoLocation,
+                        const char *renderer_slot, QObject *parent)
+{
+  const Backend *backend = find(Select(name, videoLocation));
+  if (backend == NULL) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "No %s pipeline backend for vid %d",
+        name.toUtf8().constData(), vidIx);
+    return NULL;
+  }
+
+  LOG(LOG_VIDPIPELINE, Logger::Info, "Vid %d using %s pipeline", vidIx, backend->name.toUtf8().constData());
+  return backend->createFunc(vidIx, videoLocation, renderer_slot, parent);
+}
+
+QList<PipelineFactory::Backend> &
+PipelineFactory::backends()
+{
+  static QList<Backend> s_backends;
+  static bool s_builtinsRegistered = false;
+
+  // Appended directly, Register() would come back in here
+  if (!s_builtinsRegistered) {
+    s_builtinsRegistered = true;
+
+    Backend backend;
+    backend.name = "raw";
+    backend.description = "mmapped raw I420/NV12/UYVY or y4m files, no decoding";
+    backend.createFunc = createRawFilePipeline;
+    backend.handlesFunc = RawFilePipeline::HandlesLocation;
+    s_backends.append(backend);
+#ifdef OMAP3530
+    backend.name = "ti";
+    backend.description = "qtdemux and TI DSP decoders, for the PowerVR texture stream path";
+    backend.createFunc = createTIGStreamerPipeline;
+    backend.handlesFunc = tiGStreamerHandles;
+    s_backends.append(backend);
+#endif
+    backend.name = "decodebin";
+    backend.description = "GStreamer decodebin, plays anything there's a decoder for";
+    backend.createFunc = createGStreamerPipeline;
+    backend.handlesFunc = gstreamerHandles;
+    s_backends.append(backend);
+  }
+
+  return s_backends;
+}
+
+const PipelineFactory::Backend *
+PipelineFactory::find(const QString &name)
+{
+  const QList<Backend> &all = backends();
+  for (int backendIx = 0; backendIx < all.size(); backendIx++) {
+    if (all[backendIx].name == name) {
+      return &all[backendIx];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef PIPELINEFACTORY_H
+#define PIPELINEFACTORY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "pipeline.h"
+
+// Backend name which picks one for each video location
+#define PIPELINE_BACKEND_AUTO             "auto"
+
+typedef Pipeline *(*PipelineCreateFunc)(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent);
+// Whether the backend can play the location, for picking one automatically
+typedef bool (*PipelineHandlesFunc)(const QString &videoLocation);
+
+// Registry of pipeline backends, so which one plays each video is chosen at
+// run time rather than being fixed by the build. Backends this build has
+// are registered on first use, in order of preference for auto selection.
+class PipelineFactory
+{
+public:
+  static void Register(const QString &name, const QString &description,
+                       PipelineCreateFunc createFunc, PipelineHandlesFunc handlesFunc);
+  static bool IsRegistered(const QString &name);
+  static QStringList Names();
+  static QString Description(const QString &name);
+
+  // Name of the backend which would play the location, resolving "auto".
+  // Empty if there isn't one.
+  static QString Select(const QString &name, const QString &videoLocation);
+  // Returns NULL if there's no such backend
+  static Pipeline *Create(const QString &name, int vidIx, const QString &videoLocation,
+                          const char *renderer_slot, QObject *parent);
+
+private:
+  typedef struct _Backend
+  {
+    QString name;
+    QString description;
+    PipelineCreateFunc createFunc;
+    PipelineHandlesFunc handlesFunc;
+  } Backend;
+
+  static QList<Backend> &backends();
+  static const Backend *find(const QString &name);
+};
+
+#endif // PIPELINEFACTORY_H
@@ -23,7 +23,28 @@ SOURCES += \
     mainwindow.cpp \
     yuvdebugwindow.cpp \
     controlsform.cpp \
-    applogger.cpp
+    applogger.cpp \
+    appoptions.cpp \
+    renderstats.cpp \
+    glextfunctions.cpp \
+    gltimerqueries.cpp \
+    vidquadbatcher.cpp \
+    vidlayout.cpp \
+    texturepool.cpp \
+    asynctexuploader.cpp \
+    dmabufimporter.cpp \
+    pipelinefactory.cpp \
+    rawfilepipeline.cpp \
+    pipelineclock.cpp \
+    pbobufferpool.cpp \
+    deinterlacer.cpp \
+    yuvcolourmatrix.cpp \
+    colourlut.cpp \
+    fbopool.cpp \
+    effectchain.cpp \
+    framereadback.cpp \
+    recorder.cpp \
+    framegrabtask.cpp
 
 HEADERS  += \
     glwidget.h \
@@ -35,7 +56,28 @@ HEADERS  += \
     mainwindow.h \
     yuvdebugwindow.h \
     controlsform.h \
-    applogger.h
+    applogger.h \
+    appoptions.h \
+    renderstats.h \
+    glextfunctions.h \
+    gltimerqueries.h \
+    vidquadbatcher.h \
+    vidlayout.h \
+    texturepool.h \
+    asynctexuploader.h \
+    dmabufimporter.h \
+    pipelinefactory.h \
+    rawfilepipeline.h \
+    pipelineclock.h \
+    pbobufferpool.h \
+    deinterlacer.h \
+    yuvcolourmatrix.h \
+    colourlut.h \
+    fbopool.h \
+    effectchain.h \
+    framereadback.h \
+    recorder.h \
+    framegrabtask.h
 
 FORMS += \
     controlsform.ui
@@ -49,5 +91,11 @@ LIBS += -lGLU \
 CONFIG += link_pkgconfig
 PKGCONFIG += gstreamer-1.0 gstreamer-video-1.0
 
+# dmabuf frame import, left out without these as in the CMake build:
+packagesExist(egl gstreamer-allocators-1.0) {
+    DEFINES += EGL_DMABUF_IMPORT
+    PKGCONFIG += egl gstreamer-allocators-1.0
+}
+
 # Model loading using Assimp:
 PKGCONFIG += assimp
@@ -25,7 +25,27 @@ SOURCES += main.cpp \
     yuvdebugwindow.cpp \
     controlsform.cpp \
     glpowervrwidget.cpp \
-    applogger.cpp
+    applogger.cpp \
+    appoptions.cpp \
+    renderstats.cpp \
+    gltimerqueries.cpp \
+    vidquadbatcher.cpp \
+    vidlayout.cpp \
+    texturepool.cpp \
+    asynctexuploader.cpp \
+    dmabufimporter.cpp \
+    pipelinefactory.cpp \
+    rawfilepipeline.cpp \
+    pipelineclock.cpp \
+    pbobufferpool.cpp \
+    deinterlacer.cpp \
+    yuvcolourmatrix.cpp \
+    colourlut.cpp \
+    fbopool.cpp \
+    effectchain.cpp \
+    framereadback.cpp \
+    recorder.cpp \
+    framegrabtask.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
@@ -38,7 +58,27 @@ HEADERS  += mainwindow.h \
     yuvdebugwindow.h \
     controlsform.h \
     glpowervrwidget.h \
-    applogger.h
+    applogger.h \
+    appoptions.h \
+    renderstats.h \
+    gltimerqueries.h \
+    vidquadbatcher.h \
+    vidlayout.h \
+    texturepool.h \
+    asynctexuploader.h \
+    dmabufimporter.h \
+    pipelinefactory.h \
+    rawfilepipeline.h \
+    pipelineclock.h \
+    pbobufferpool.h \
+    deinterlacer.h \
+    yuvcolourmatrix.h \
+    colourlut.h \
+    fbopool.h \
+    effectchain.h \
+    framereadback.h \
+    recorder.h \
+    framegrabtask.h
 
 FORMS += \
     controlsform.ui
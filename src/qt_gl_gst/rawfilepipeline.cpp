@@ -0,0 +1,465 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <QStringList>
+#include "rawfilepipeline.h"
+#include "pipelineclock.h"
+#include "applogger.h"
+
+RawFilePipeline::RawFilePipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent) :
+  Pipeline(vidIx, videoLocation, renderer_slot, parent), m_mapping(NULL), m_isY4m(false),
+  m_firstFrameOffset(0), m_fpsNum(0), m_fpsDen(1), m_startNs(-1), m_keepRunning(false), m_throttled(false),
+  m_framesDropped(0)
+{
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "constructor entered");
+
+  m_frameThread = new RawFrameThread(this, this);
+
+  QObject::connect(m_frameThread, SIGNAL(finished()), this, SLOT(cleanUp()));
+}
+
+RawFilePipeline::~RawFilePipeline()
+{
+  m_keepRunning = false;
+  m_frameThread->wait();
+
+  if (m_mapping) {
+    unrefMapping(m_mapping);
+  }
+}
+
+bool
+RawFilePipeline::HandlesLocation(const QString &videoLocation)
+{
+  return videoLocation.startsWith(RAW_VIDEO_LOCATION_PREFIX) ||
+         videoLocation.endsWith(".y4m", Qt::CaseInsensitive);
+}
+
+void
+RawFilePipeline::Configure()
+{
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "Configure entered");
+
+  // Only for GstBuffer
+  gst_init(NULL, NULL);
+
+  QString fileName = m_videoLocation;
+  m_isY4m = !m_videoLocation.startsWith(RAW_VIDEO_LOCATION_PREFIX);
+  if (!m_isY4m && !parseRawLocation(fileName)) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Badly formed raw video location %s", m_videoLocation.toUtf8().constData());
+    return;
+  }
+
+  if (!mapFile(fileName)) {
+    return;
+  }
+
+  if (m_isY4m && !parseY4mHeader()) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Can't play y4m file %s", fileName.toUtf8().constData());
+    unrefMapping(m_mapping);
+    m_mapping = NULL;
+    return;
+  }
+
+  m_sourceWidth = m_width;
+  m_sourceHeight = m_height;
+  m_vidInfoValid = true;
+
+  LOG(LOG_VIDPIPELINE, Logger::Info, "vid %d playing %dx%d raw frames at %d/%d fps from %s",
+      m_vidIx, m_width, m_height, m_fpsNum, m_fpsDen, fileName.toUtf8().constData());
+}
+
+void
+RawFilePipeline::Start()
+{
+  if (m_mapping == NULL) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Failed to start up raw pipeline for vid %d!", m_vidIx);
+    return;
+  }
+
+  m_keepRunning = true;
+  m_startNs = m_syncToRenderer ? m_baseTimeNs : PipelineClock::NowNs();
+  m_frameThread->start();
+}
+
+void
+RawFilePipeline::Stop()
+{
+  m_keepRunning = false;
+}
+
+void
+RawFilePipeline::cleanUp()
+{
+  m_frameThread->wait();
+
+  GstBuffer *buf;
+  while (m_incomingBufQueue.size()) {
+    m_incomingBufQueue.get((void **)(&buf));
+    gst_buffer_unref(buf);
+  }
+  while (m_outgoingBufQueue.size()) {
+    m_outgoingBufQueue.get((void **)(&buf));
+    gst_buffer_unref(buf);
+  }
+
+  // Frames the renderer still has keep the mapping until they're unreffed
+  if (m_mapping) {
+    unrefMapping(m_mapping);
+    m_mapping = NULL;
+  }
+
+  if (m_framesDropped) {
+    LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d dropped %d raw frames", m_vidIx, m_framesDropped);
+  }
+
+  // Done
+  m_finished = true;
+  emit finished(m_vidIx);
+}
+
+qint64
+RawFilePipeline::getBufferAgeNs(void *buf)
+{
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if ((gstBuf == NULL) || (m_startNs < 0) || !GST_BUFFER_PTS_IS_VALID(gstBuf)) {
+    return -1;
+  }
+
+  // PTS is on the same clock, so this is exact
+  return runningTimeNs() - (qint64)GST_BUFFER_PTS(gstBuf);
+}
+
+// Frames are stamped from 0, so the PTS is the running time
+qint64
+RawFilePipeline::getBufferRunningTimeNs(void *buf)
+{
+  GstBuffer *gstBuf = (GstBuffer *)buf;
+  if ((gstBuf == NULL) || !GST_BUFFER_PTS_IS_VALID(gstBuf)) {
+    return -1;
+  }
+  return (qint64)GST_BUFFER_PTS(gstBuf);
+}
+
+// "raw:<fourcc>:<width>x<height>@<fps>:<file>", the file name may have
+// colons in it so everything after the third one is taken
+bool
+RawFilePipeline::parseRawLocation(QString &fileName)
+{
+  QString fields = m_videoLocation.mid(strlen(RAW_VIDEO_LOCATION_PREFIX));
+  int formatEnd = fields.indexOf(':');
+  int sizeEnd = fields.indexOf(':', formatEnd + 1);
+  if ((formatEnd < 0) || (sizeEnd < 0)) {
+    return false;
+  }
+
+  QString fourCC = fields.left(formatEnd).toUpper();
+  if (fourCC == "I420") {
+    m_colFormat = ColFmt_I420;
+  }
+  else if (fourCC == "NV12") {
+    m_colFormat = ColFmt_NV12;
+  }
+  else if (fourCC == "UYVY") {
+    m_colFormat = ColFmt_UYVY;
+  }
+  else {
+    return false;
+  }
+
+  QStringList sizeAndRate = fields.mid(formatEnd + 1, sizeEnd - formatEnd - 1).split('@');
+  if (sizeAndRate.size() != 2) {
+    return false;
+  }
+  QStringList dims = sizeAndRate[0].split('x');
+  if (dims.size() != 2) {
+    return false;
+  }
+
+  bool widthOk, heightOk, fpsOk;
+  m_width = dims[0].toInt(&widthOk);
+  m_height = dims[1].toInt(&heightOk);
+  m_fpsNum = sizeAndRate[1].toInt(&fpsOk);
+  m_fpsDen = 1;
+  if (!widthOk || !heightOk || !fpsOk || (m_width <= 0) || (m_height <= 0) || (m_fpsNum < 0)) {
+    return false;
+  }
+
+  // Chroma is subsampled in pairs
+  if ((m_width & 1) || ((m_colFormat != ColFmt_UYVY) && (m_height & 1))) {
+    return false;
+  }
+
+  fileName = fields.mid(sizeEnd + 1);
+  m_firstFrameOffset = 0;
+  return !fileName.isEmpty();
+}
+
+// "YUV4MPEG2 W<width> H<height> F<num>:<den> [I..] [A..] [C..] [X..]\n",
+// only the 8 bit 4:2:0 colour spaces are the I420 layout
+bool
+RawFilePipeline::parseY4mHeader()
+{
+  const char *header = (const char *)m_mapping->data;
+  const char *headerEnd = (const char *)memchr(header, '\n', qMin(m_mapping->size, (qint64)RAWPIPELINE_MAX_Y4M_FRAME_HEADER));
+  if (headerEnd == NULL) {
+    return false;
+  }
+
+  QList<QByteArray> params = QByteArray(header, headerEnd - header).split(' ');
+  if (params[0] != "YUV4MPEG2") {
+    return false;
+  }
+
+  m_width = m_height = m_fpsNum = 0;
+  m_fpsDen = 1;
+  m_colFormat = ColFmt_I420;
+  for (int paramIx = 1; paramIx < params.size(); paramIx++) {
+    const QByteArray &param = params[paramIx];
+    if (param.isEmpty()) {
+      continue;
+    }
+
+    QByteArray value = param.mid(1);
+    switch (param[0]) {
+    case 'W':
+      m_width = value.toInt();
+      break;
+    case 'H':
+      m_height = value.toInt();
+      break;
+    case 'F': {
+      QList<QByteArray> rate = value.split(':');
+      if (rate.size() == 2) {
+        m_fpsNum = rate[0].toInt();
+        m_fpsDen = rate[1].toInt();
+      }
+      break; }
+    case 'C':
+      if ((value != "420") && (value != "420jpeg") && (value != "420paldv") && (value != "420mpeg2")) {
+        LOG(LOG_VIDPIPELINE, Logger::Error, "y4m colour space %s isn't supported", value.constData());
+        m_colFormat = ColFmt_Unknown;
+      }
+      break;
+    case 'X':
+      // Matrix isn't given, so is left to be guessed from the size
+      if (value == "COLORRANGE=FULL") {
+        m_colorimetry.fullRange = true;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  m_firstFrameOffset = (headerEnd - header) + 1;
+
+  return (m_colFormat != ColFmt_Unknown) && (m_width > 0) && (m_height > 0) &&
+         !(m_width & 1) && !(m_height & 1) && (m_fpsNum > 0) && (m_fpsDen > 0);
+}
+
+bool
+RawFilePipeline::mapFile(const QString &fileName)
+{
+  int fd = open(fileName.toUtf8().constData(), O_RDONLY);
+  if (fd == -1) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Can't open raw video file %s", fileName.toUtf8().constData());
+    return false;
+  }
+
+  struct stat fileStat;
+  if ((fstat(fd, &fileStat) == -1) || (fileStat.st_size == 0)) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Raw video file %s is empty", fileName.toUtf8().constData());
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // Mapping keeps its own reference to the file
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(LOG_VIDPIPELINE, Logger::Error, "Can't mmap raw video file %s", fileName.toUtf8().constData());
+    return false;
+  }
+
+  // Frames are read front to back, so the kernel can read ahead further
+  // and drop pages once they're behind
+  madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+
+  m_mapping = new RawFileMapping;
+  m_mapping->data = (uchar *)data;
+  m_mapping->size = fileStat.st_size;
+  m_mapping->refs.ref();
+  return true;
+}
+
+qint64
+RawFilePipeline::frameBytes() const
+{
+  if (m_colFormat == ColFmt_UYVY) {
+    return (qint64)m_width * m_height * 2;
+  }
+  return (qint64)m_width * m_height * 3 / 2;
+}
+
+qint64
+RawFilePipeline::runningTimeNs() const
+{
+  return PipelineClock::NowNs() - m_startNs;
+}
+
+void
+RawFrameThread::run()
+{
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "RawFilePipeline: vid %d frame thread started", m_pipelinePtr->getVidIx());
+
+  m_pipelinePtr->runFrameLoop();
+
+  LOG(LOG_VIDPIPELINE, Logger::Debug1, "RawFilePipeline: vid %d frame thread finished", m_pipelinePtr->getVidIx());
+}
+
+// Frame thread. Runs to the end of the file or until stopped, returning
+// buffers the renderer is done with in between frames.
+void
+RawFilePipeline::runFrameLoop()
+{
+  qint64 offset = m_firstFrameOffset;
+  qint64 frameIx = 0;
+  qint64 lastPushedNs = -1;
+
+  while (m_keepRunning) {
+    const uchar *frameData = nextFrameData(offset);
+    if (frameData == NULL) {
+      LOG(LOG_VIDPIPELINE, Logger::Debug1, "vid %d end of raw file", m_vidIx);
+      // Renderer picks frames by PTS, it still wants the ones queued
+      while (m_syncToRenderer && m_keepRunning && m_incomingBufQueue.size()) {
+        returnBuffers(PIPELINE_SYNC_WAIT_MS);
+      }
+      break;
+    }
+    readAhead(offset);
+
+    qint64 ptsNs;
+    if ((m_fpsNum > 0) && !m_syncToRenderer) {
+      ptsNs = (frameIx++ * 1000000000LL * m_fpsDen) / m_fpsNum;
+      if (!waitUntil(ptsNs)) {
+        break;
+      }
+
+      // Renderer's behind or the video's hidden, it would only be dropped later
+      if ((m_incomingBufQueue.size() >= RAWPIPELINE_MAX_QUEUED_FRAMES) ||
+          (m_throttled && (lastPushedNs >= 0) && ((ptsNs - lastPushedNs) < PIPELINE_THROTTLED_INTERVAL_NS))) {
+        m_framesDropped++;
+        continue;
+      }
+    }
+    else {
+      // Unpaced or picked by the renderer, just keep it fed
+      int maxQueued = m_syncToRenderer ? PIPELINE_SYNC_MAX_QUEUED : RAWPIPELINE_MAX_QUEUED_FRAMES;
+      while (m_keepRunning && (m_incomingBufQueue.size() >= maxQueued)) {
+        returnBuffers(1);
+      }
+      if (!m_keepRunning) {
+        break;
+      }
+      ptsNs = (m_fpsNum > 0) ? (frameIx++ * 1000000000LL * m_fpsDen) / m_fpsNum : runningTimeNs();
+    }
+
+    pushFrame(frameData, ptsNs);
+    lastPushedNs = ptsNs;
+  }
+}
+
+// Returns the next frame's data and moves offset past it, or NULL at the
+// end of the file
+const uchar *
+RawFilePipeline::nextFrameData(qint64 &offset)
+{
+  qint64 dataOffset = offset;
+
+  if (m_isY4m) {
+    qint64 headerBytes = qMin(m_mapping->size - offset, (qint64)RAWPIPELINE_MAX_Y4M_FRAME_HEADER);
+    if (headerBytes <= 0) {
+      return NULL;
+    }
+
+    const uchar *frameHeader = m_mapping->data + offset;
+    const uchar *headerEnd = (const uchar *)memchr(frameHeader, '\n', headerBytes);
+    if ((headerEnd == NULL) || (headerBytes < 5) || (memcmp(frameHeader, "FRAME", 5) != 0)) {
+      LOG(LOG_VIDPIPELINE, Logger::Warning, "vid %d bad y4m frame header at %lld", m_vidIx, offset);
+      return NULL;
+    }
+    dataOffset = (headerEnd - m_mapping->data) + 1;
+  }
+
+  if (dataOffset + frameBytes() > m_mapping->size) {
+    return NULL;
+  }
+
+  offset = dataOffset + frameBytes();
+  return m_mapping->data + dataOffset;
+}
+
+// Have the next few frames paged in before they're uploaded from
+void
+RawFilePipeline::readAhead(qint64 offset)
+{
+  qint64 pageMask = ~((qint64)sysconf(_SC_PAGESIZE) - 1);
+  qint64 start = offset & pageMask;
+  qint64 end = qMin(m_mapping->size, offset + (frameBytes() * RAWPIPELINE_READAHEAD_FRAMES));
+
+  if (end > start) {
+    madvise(m_mapping->data + start, end - start, MADV_WILLNEED);
+  }
+}
+
+// Returns false if stopped while waiting
+bool
+RawFilePipeline::waitUntil(qint64 dueNs)
+{
+  qint64 remainingNs;
+  while (m_keepRunning && ((remainingNs = dueNs - runningTimeNs()) > 0)) {
+    // Doubles as the sleep, wakes early to return buffers
+    returnBuffers(qMax((qint64)1, remainingNs / 1000000));
+  }
+  return m_keepRunning;
+}
+
+void
+RawFilePipeline::pushFrame(const uchar *frameData, qint64 ptsNs)
+{
+  // Buffer wraps the frame in place and holds the mapping until it's freed
+  m_mapping->refs.ref();
+  GstBuffer *buf = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, (gpointer)frameData,
+                                               frameBytes(), 0, frameBytes(), m_mapping, unrefMapping);
+  GST_BUFFER_PTS(buf) = ptsNs;
+  m_playedNs = ptsNs + ((m_fpsNum > 0) ? (1000000000LL * m_fpsDen) / m_fpsNum : 0);
+
+  m_incomingBufQueue.put(buf);
+  LOG(LOG_VIDPIPELINE, Logger::Debug2, "vid %d pushed buffer %p to incoming queue", m_vidIx, buf);
+
+  NotifyNewFrame();
+}
+
+// Wait up to waitMs for the first buffer, then take any others without waiting
+void
+RawFilePipeline::returnBuffers(unsigned long waitMs)
+{
+  GstBuffer *buf = NULL;
+  while (m_outgoingBufQueue.get((void **)(&buf), waitMs)) {
+    gst_buffer_unref(buf);
+    waitMs = 0;
+  }
+}
+
+void
+RawFilePipeline::unrefMapping(gpointer mapping)
+{
+  RawFileMapping *rawMapping = (RawFileMapping *)mapping;
+  if (!rawMapping->refs.deref()) {
+    munmap(rawMapping->data, rawMapping->size);
+    delete rawMapping;
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef RAWFILEPIPELINE_H
+#define RAWFILEPIPELINE_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <atomic>
+
+#include <gst/gst.h>
+
+// Re-include base class header here to keep the MOC happy:
+#include "pipeline.h"
+
+// Headerless raw files need their format given in the location, in the form
+// "raw:<fourcc>:<width>x<height>@<fps>:<file>", e.g. "raw:NV12:1920x1080@30:clip.nv12".
+// A frame rate of 0 plays frames as fast as the renderer takes them.
+// .y4m files carry their own format and are played from their plain path.
+#define RAW_VIDEO_LOCATION_PREFIX         "raw:"
+
+// Frames waiting for the renderer before more are dropped, or held back
+// when not paced
+#define RAWPIPELINE_MAX_QUEUED_FRAMES     3
+// Frames ahead of the current one to ask the kernel to read in
+#define RAWPIPELINE_READAHEAD_FRAMES      4
+// Longest "FRAME ..." line before a y4m file is taken as corrupt
+#define RAWPIPELINE_MAX_Y4M_FRAME_HEADER  256
+
+class RawFilePipeline;
+
+class RawFrameThread : public QThread
+{
+  Q_OBJECT
+
+public:
+  RawFrameThread(RawFilePipeline *pipelinePtr, QObject *parent = 0) :
+    QThread(parent), m_pipelinePtr(pipelinePtr) { }
+  void run();
+
+private:
+  RawFilePipeline *m_pipelinePtr;
+};
+
+
+// Plays raw I420/NV12/UYVY or y4m files without decoding them. The file is
+// mmapped and each frame goes to the renderer as a GstBuffer wrapping its
+// part of the mapping, so nothing is copied before the texture upload.
+// Frames are paced by the file's frame rate against the PipelineClock, or
+// when synced to the renderer, go through ahead of time for it to pick.
+//
+// GStreamer is only used for the buffer type, so the renderer can treat
+// frames the same as those from the decoding pipelines.
+class RawFilePipeline : public Pipeline
+{
+  Q_OBJECT
+
+public:
+  RawFilePipeline(int vidIx, const QString &videoLocation, const char *renderer_slot, QObject *parent);
+  ~RawFilePipeline();
+
+  void Configure();
+  void Start();
+  qint64 getBufferAgeNs(void *buf);
+  qint64 getBufferRunningTimeNs(void *buf);
+  void setThrottled(bool throttled) { m_throttled = throttled; }
+
+  // For the pipeline factory's auto selection
+  static bool HandlesLocation(const QString &videoLocation);
+
+public Q_SLOTS:
+  void Stop();
+
+private slots:
+  void cleanUp();
+
+private:
+  // Mapping stays until the pipeline and every frame wrapping it are done
+  typedef struct _RawFileMapping
+  {
+    uchar *data;
+    qint64 size;
+    QAtomicInt refs;
+  } RawFileMapping;
+
+  bool parseRawLocation(QString &fileName);
+  bool parseY4mHeader();
+  bool mapFile(const QString &fileName);
+  qint64 frameBytes() const;
+  qint64 runningTimeNs() const;
+
+  void runFrameLoop();
+  const uchar *nextFrameData(qint64 &offset);
+  void readAhead(qint64 offset);
+  bool waitUntil(qint64 dueNs);
+  void pushFrame(const uchar *frameData, qint64 ptsNs);
+  void returnBuffers(unsigned long waitMs);
+
+  static void unrefMapping(gpointer mapping);
+
+  RawFrameThread *m_frameThread;
+  friend class RawFrameThread;
+
+  RawFileMapping *m_mapping;
+  bool m_isY4m;
+  qint64 m_firstFrameOffset;
+  // Frame rate as a fraction, 0 numerator for unpaced
+  int m_fpsNum;
+  int m_fpsDen;
+
+  // PipelineClock time frames are timed from, -1 until started
+  qint64 m_startNs;
+  std::atomic<bool> m_keepRunning;
+  std::atomic<bool> m_throttled;
+  int m_framesDropped;
+};
+
+#endif // RAWFILEPIPELINE_H
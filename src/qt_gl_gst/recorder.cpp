@@ -0,0 +1,354 @@
+#include "recorder.h"
+#include "applogger.h"
+
+// Tried in order, the first which will go to READY is used
+static const RecorderEncoder RecorderEncoders[] =
+{
+  { "vaapih264enc", "vaapih264enc" },
+  { "nvh264enc", "nvh264enc" },
+  { "v4l2h264enc", "v4l2h264enc" },
+  { "omxh264enc", "omxh264enc" },
+  // Software fallback, tuned to keep up rather than for size
+  { "x264enc", "x264enc tune=zerolatency speed-preset=ultrafast" }
+};
+
+Recorder::Recorder() :
+  m_recording(false), m_lossless(false), m_frameDurationNs(0), m_firstPtsNs(-1), m_pipeline(NULL), m_appsrc(NULL),
+  m_framesCaptured(0), m_readbackDrops(0), m_sizeDrops(0), m_keepRunning(false), m_queueDrops(0),
+  m_framesPushed(0), m_pushErrors(0)
+{
+}
+
+Recorder::~Recorder()
+{
+  // Only finished properly by Stop, this just makes sure nothing's left
+  stopThread();
+  releasePipeline();
+  for (int queueIx = 0; queueIx < m_queue.size(); queueIx++) {
+    gst_buffer_unref(m_queue[queueIx]);
+  }
+}
+
+void
+Recorder::Cleanup()
+{
+  m_readback.Cleanup();
+}
+
+bool
+Recorder::Start(const QGLContext *context, const QString &fileName, const QSize &size, int fps)
+{
+  if (m_recording) {
+    return false;
+  }
+
+  // Could be before any pipeline has done it
+  gst_init(NULL, NULL);
+
+  if (!m_readback.IsAvailable() && !m_readback.Init(context, READBACK_DFLT_BUFFERS)) {
+    LOG(LOG_GL, Logger::Warning, "Can't read frames back without stalling, not recording");
+    return false;
+  }
+
+  m_size = size;
+  m_fileName = fileName;
+  m_frameDurationNs = (fps > 0) ? (GST_SECOND / fps) : 0;
+  m_firstPtsNs = -1;
+
+  if (!buildPipeline(fileName, fps)) {
+    return false;
+  }
+
+  m_keepRunning = true;
+  m_recording = true;
+  start();
+  return true;
+}
+
+void
+Recorder::Stop()
+{
+  if (!m_recording) {
+    return;
+  }
+  m_recording = false;
+
+  // Frames already drawn still go in
+  collectReadbacks(true);
+  stopThread();
+
+  // MP4 only gets its index written at EOS, which the encode thread sent
+  // after its last frame
+  GstBus *bus = gst_element_get_bus(m_pipeline);
+  GstMessage *msg = gst_bus_timed_pop_filtered(bus, (GstClockTime)RECORDER_STOP_TIMEOUT_MS * GST_MSECOND,
+                                               (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  if (msg == NULL) {
+    LOG(LOG_VIDPIPELINE, Logger::Warning, "Recording to %s didn't finish in time, file may be incomplete",
+        m_fileName.toUtf8().constData());
+  }
+  else {
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+      GError *err = NULL;
+      gst_message_parse_error(msg, &err, NULL);
+      LOG(LOG_VIDPIPELINE, Logger::Error, "Error finishing recording: %s", err->message);
+      g_error_free(err);
+    }
+    gst_message_unref(msg);
+  }
+  gst_object_unref(bus);
+  releasePipeline();
+
+  QMutexLocker locker(&m_mutex);
+  LOG(LOG_VIDPIPELINE, Logger::Info, "Recorded %lld frames to %s, dropped %lld waiting for readback, "
+      "%lld waiting for the encoder, %lld of the wrong size", m_framesPushed, m_fileName.toUtf8().constData(),
+      m_readbackDrops, m_queueDrops, m_sizeDrops);
+}
+
+void
+Recorder::CaptureFrame(const QSize &size, qint64 ptsNs)
+{
+  if (!m_recording) {
+    return;
+  }
+
+  // Encoder gave up, no point reading any more back for it
+  if (checkBusError()) {
+    m_recording = false;
+    m_readback.Clear();
+    gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    stopThread();
+    releasePipeline();
+    return;
+  }
+
+  // Whatever the GPU has finished with since last time
+  collectReadbacks(false);
+
+  if (size != m_size) {
+    if (m_sizeDrops == 0) {
+      LOG(LOG_VIDPIPELINE, Logger::Warning, "Frames are %dx%d, only %dx%d ones are recorded",
+          size.width(), size.height(), m_size.width(), m_size.height());
+    }
+    m_sizeDrops++;
+    return;
+  }
+
+  if (m_firstPtsNs < 0) {
+    m_firstPtsNs = ptsNs;
+  }
+
+  // Oldest has had the most time to finish, so it's the one waited for
+  if (m_lossless && m_readback.IsFull()) {
+    GstBuffer *buf = m_readback.TakeFinished(true, NULL);
+    if (buf) {
+      queueFrame(buf);
+    }
+  }
+
+  if (m_readback.Start(size, ptsNs - m_firstPtsNs)) {
+    m_framesCaptured++;
+  }
+  else {
+    m_readbackDrops++;
+  }
+}
+
+void
+Recorder::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("recorder_frames_captured", m_framesCaptured);
+  stats.SetCounter("recorder_dropped_readback", m_readbackDrops);
+  stats.SetCounter("recorder_dropped_size", m_sizeDrops);
+
+  QMutexLocker locker(&m_mutex);
+  stats.SetCounter("recorder_dropped_queue", m_queueDrops);
+  stats.SetCounter("recorder_frames_pushed", m_framesPushed);
+  stats.SetCounter("recorder_push_errors", m_pushErrors);
+}
+
+// Encode thread, pushes queued frames into appsrc in order until stopped
+// and empty, then ends the stream
+void
+Recorder::run()
+{
+  for (;;) {
+    GstBuffer *buf;
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_queue.isEmpty() && m_keepRunning) {
+        m_frameQueued.wait(&m_mutex);
+      }
+      if (m_queue.isEmpty()) {
+        break;
+      }
+      buf = m_queue.takeFirst();
+      m_frameTaken.wakeOne();
+    }
+
+    // Blocks while appsrc is full, which is what backs frames up into the
+    // queue rather than appsrc growing without limit
+    GstFlowReturn flowRet = GST_FLOW_OK;
+    g_signal_emit_by_name(m_appsrc, "push-buffer", buf, &flowRet);
+    gst_buffer_unref(buf);
+
+    QMutexLocker locker(&m_mutex);
+    if (flowRet == GST_FLOW_OK) {
+      m_framesPushed++;
+    }
+    else {
+      m_pushErrors++;
+    }
+  }
+
+  GstFlowReturn flowRet;
+  g_signal_emit_by_name(m_appsrc, "end-of-stream", &flowRet);
+}
+
+bool
+Recorder::buildPipeline(const QString &fileName, int fps)
+{
+  const char *mux = fileName.endsWith(".mkv", Qt::CaseInsensitive) ? "matroskamux" : "mp4mux";
+
+  for (unsigned encIx = 0; encIx < sizeof(RecorderEncoders) / sizeof(RecorderEncoders[0]); encIx++) {
+    GstElementFactory *factory = gst_element_factory_find(RecorderEncoders[encIx].factoryName);
+    if (factory == NULL) {
+      continue;
+    }
+    gst_object_unref(factory);
+
+    // GL rows come bottom up
+    QString launch = QString("appsrc name=recsrc ! videoflip method=vertical-flip ! videoconvert ! "
+                             "%1 ! h264parse ! %2 ! filesink name=recsink")
+                     .arg(RecorderEncoders[encIx].launch).arg(mux);
+    GError *err = NULL;
+    GstElement *pipeline = gst_parse_launch(launch.toUtf8().constData(), &err);
+    if (err) {
+      LOG(LOG_VIDPIPELINE, Logger::Debug1, "Recording pipeline with %s: %s",
+          RecorderEncoders[encIx].factoryName, err->message);
+      g_error_free(err);
+      if (pipeline) {
+        gst_object_unref(pipeline);
+      }
+      continue;
+    }
+
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "recsink");
+    g_object_set(G_OBJECT(sink), "location", fileName.toUtf8().constData(), NULL);
+    gst_object_unref(sink);
+
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "recsrc");
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+                                        "format", G_TYPE_STRING, "RGBA",
+                                        "width", G_TYPE_INT, m_size.width(),
+                                        "height", G_TYPE_INT, m_size.height(),
+                                        "framerate", GST_TYPE_FRACTION, fps, 1,
+                                        NULL);
+    g_object_set(G_OBJECT(appsrc), "caps", caps, "format", GST_FORMAT_TIME, "block", TRUE,
+                 "max-bytes", (guint64)m_size.width() * m_size.height() * 4 * RECORDER_APPSRC_FRAMES, NULL);
+    gst_caps_unref(caps);
+
+    // Hardware encoders that are there but can't be used fail here
+    if ((gst_element_set_state(pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE) ||
+        (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)) {
+      LOG(LOG_VIDPIPELINE, Logger::Debug1, "Couldn't start recording with %s", RecorderEncoders[encIx].factoryName);
+      gst_element_set_state(pipeline, GST_STATE_NULL);
+      gst_object_unref(appsrc);
+      gst_object_unref(pipeline);
+      continue;
+    }
+
+    LOG(LOG_VIDPIPELINE, Logger::Info, "Recording %dx%d to %s with %s", m_size.width(), m_size.height(),
+        fileName.toUtf8().constData(), RecorderEncoders[encIx].factoryName);
+    m_pipeline = pipeline;
+    m_appsrc = appsrc;
+    return true;
+  }
+
+  LOG(LOG_VIDPIPELINE, Logger::Error, "No H.264 encoder could be started, not recording");
+  return false;
+}
+
+void
+Recorder::collectReadbacks(bool wait)
+{
+  GstBuffer *buf;
+  while ((m_readback.NumPending() > 0) && ((buf = m_readback.TakeFinished(wait, NULL)) != NULL)) {
+    queueFrame(buf);
+  }
+}
+
+void
+Recorder::queueFrame(GstBuffer *buf)
+{
+  if (m_frameDurationNs > 0) {
+    GST_BUFFER_DURATION(buf) = m_frameDurationNs;
+  }
+
+  QMutexLocker locker(&m_mutex);
+
+  // Lossless only drops if the encoder has stopped taking frames at all
+  while (m_lossless && (m_queue.size() >= RECORDER_MAX_QUEUED_FRAMES) &&
+         m_frameTaken.wait(&m_mutex, RECORDER_STOP_TIMEOUT_MS)) {
+  }
+
+  // Newest goes, the encoder is behind and older ones are further along
+  if (m_queue.size() >= RECORDER_MAX_QUEUED_FRAMES) {
+    gst_buffer_unref(buf);
+    m_queueDrops++;
+    return;
+  }
+
+  m_queue.append(buf);
+  m_frameQueued.wakeOne();
+}
+
+bool
+Recorder::checkBusError()
+{
+  GstBus *bus = gst_element_get_bus(m_pipeline);
+  GstMessage *msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+  gst_object_unref(bus);
+
+  if (msg == NULL) {
+    return false;
+  }
+
+  GError *err = NULL;
+  gst_message_parse_error(msg, &err, NULL);
+  LOG(LOG_VIDPIPELINE, Logger::Error, "Recording stopped: %s", err->message);
+  g_error_free(err);
+  gst_message_unref(msg);
+  return true;
+}
+
+// Lets the encode thread drain the queue. If appsrc never takes the frames,
+// the pipeline is stopped under it so the push gives up.
+void
+Recorder::stopThread()
+{
+  {
+    QMutexLocker locker(&m_mutex);
+    m_keepRunning = false;
+    m_frameQueued.wakeOne();
+  }
+
+  if (isRunning() && !wait(RECORDER_STOP_TIMEOUT_MS)) {
+    LOG(LOG_VIDPIPELINE, Logger::Warning, "Encoder stuck, dropping the frames still queued for it");
+    gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    wait();
+  }
+}
+
+void
+Recorder::releasePipeline()
+{
+  if (m_pipeline == NULL) {
+    return;
+  }
+
+  gst_element_set_state(m_pipeline, GST_STATE_NULL);
+  gst_object_unref(m_appsrc);
+  gst_object_unref(m_pipeline);
+  m_appsrc = NULL;
+  m_pipeline = NULL;
+}
@@ -0,0 +1,101 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QGLContext>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+#include <gst/gst.h>
+
+#include "framereadback.h"
+#include "renderstats.h"
+
+// Frames waiting for the encode thread, beyond which new ones are dropped
+#define RECORDER_MAX_QUEUED_FRAMES           8
+// Frames appsrc holds before pushing blocks the encode thread
+#define RECORDER_APPSRC_FRAMES               2
+// Longest to wait for the encoder to drain and the file to be finished
+#define RECORDER_STOP_TIMEOUT_MS             5000
+
+typedef struct _RecorderEncoder
+{
+  const char *factoryName;
+  const char *launch;
+} RecorderEncoder;
+
+// Records the composited output to a file. Each frame is read back
+// asynchronously with FrameReadback, then goes through a bounded queue to
+// a thread pushing it into appsrc ! encoder ! mux ! filesink, so neither
+// readback nor encoding holds up rendering. Frames are dropped and counted,
+// rather than waited for, when readbacks or the queue back up.
+//
+// Hardware H.264 encoders are used where there is one, x264 otherwise.
+class Recorder : public QThread
+{
+public:
+  Recorder();
+  ~Recorder();
+
+  // Context must be current. fps goes in the caps, 0 for frames coming
+  // whenever they're rendered, timed by their PTS. .mkv files are
+  // Matroska, anything else MP4.
+  bool Start(const QGLContext *context, const QString &fileName, const QSize &size, int fps);
+  // Finishes off pending readbacks and queued frames, then the file.
+  // Context must be current.
+  void Stop();
+  bool IsRecording() const { return m_recording; }
+  // Context must be current. Deletes the readback buffers, after Stop.
+  void Cleanup();
+  // Wait for readbacks and the encoder rather than drop frames, for when
+  // every frame has to be in the file more than rendering has to keep going
+  void SetLossless(bool lossless) { m_lossless = lossless; }
+
+  // Context must be current, with the frame drawn in the bound framebuffer.
+  // Frames of any other size than it was started with are dropped.
+  void CaptureFrame(const QSize &size, qint64 ptsNs);
+
+  // Frame and drop counts as counters named recorder_*
+  void ReportStats(RenderStats &stats) const;
+
+protected:
+  void run();
+
+private:
+  bool buildPipeline(const QString &fileName, int fps);
+  void collectReadbacks(bool wait);
+  void queueFrame(GstBuffer *buf);
+  bool checkBusError();
+  void stopThread();
+  void releasePipeline();
+
+  bool m_recording;
+  bool m_lossless;
+  QSize m_size;
+  qint64 m_frameDurationNs;
+  qint64 m_firstPtsNs;
+  QString m_fileName;
+  FrameReadback m_readback;
+  GstElement *m_pipeline;
+  GstElement *m_appsrc;
+
+  // Render thread only
+  qint64 m_framesCaptured;
+  qint64 m_readbackDrops;
+  qint64 m_sizeDrops;
+
+  // Everything below is shared with the encode thread
+  mutable QMutex m_mutex;
+  QWaitCondition m_frameQueued;
+  QWaitCondition m_frameTaken;
+  QList<GstBuffer *> m_queue;
+  bool m_keepRunning;
+  qint64 m_queueDrops;
+  qint64 m_framesPushed;
+  qint64 m_pushErrors;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <math.h>
+#include <QtGlobal>
+#ifdef Q_OS_UNIX
+ #include <sys/resource.h>
+ #include <unistd.h>
+ #include <stdio.h>
+#endif
+#include "renderstats.h"
+
+TimingStats::TimingStats() :
+  m_nextSampleIx(0), m_sortedValid(false)
+{
+}
+
+void
+TimingStats::AddSample(qint64 ns)
+{
+  // Once full, overwrite the oldest sample
+  if (m_samples.size() < TIMINGSTATS_MAX_SAMPLES) {
+    m_samples.push_back(ns);
+  }
+  else {
+    m_samples[m_nextSampleIx] = ns;
+    m_nextSampleIx = (m_nextSampleIx + 1) % TIMINGSTATS_MAX_SAMPLES;
+  }
+  m_sortedValid = false;
+}
+
+void
+TimingStats::Reset()
+{
+  m_samples.clear();
+  m_nextSampleIx = 0;
+  m_sortedSamples.clear();
+  m_sortedValid = false;
+}
+
+qint64
+TimingStats::Min() const
+{
+  if (m_samples.isEmpty()) {
+    return 0;
+  }
+
+  return *std::min_element(m_samples.constBegin(), m_samples.constEnd());
+}
+
+qint64
+TimingStats::Max() const
+{
+  if (m_samples.isEmpty()) {
+    return 0;
+  }
+
+  return *std::max_element(m_samples.constBegin(), m_samples.constEnd());
+}
+
+qint64
+TimingStats::Mean() const
+{
+  if (m_samples.isEmpty()) {
+    return 0;
+  }
+
+  qint64 total = 0;
+  for (int sampleIx = 0; sampleIx < m_samples.size(); sampleIx++) {
+    total += m_samples[sampleIx];
+  }
+
+  return total / m_samples.size();
+}
+
+qint64
+TimingStats::Percentile(qreal pct) const
+{
+  if (m_samples.isEmpty()) {
+    return 0;
+  }
+
+  if (!m_sortedValid) {
+    m_sortedSamples = m_samples;
+    std::sort(m_sortedSamples.begin(), m_sortedSamples.end());
+    m_sortedValid = true;
+  }
+
+  // Nearest rank, the smallest sample with at least pct% of them at or below it
+  int rank = (int)ceil((pct / 100.0) * m_sortedSamples.size());
+  rank = qBound(1, rank, m_sortedSamples.size());
+
+  return m_sortedSamples[rank - 1];
+}
+
+RenderStats::RenderStats()
+{
+}
+
+void
+RenderStats::Reset()
+{
+  m_timings.clear();
+  m_counters.clear();
+}
+
+// CPU time and memory use of the whole process so far
+void
+RenderStats::AddProcessCounters()
+{
+#ifdef Q_OS_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    SetCounter("cpu_user_ms", ((qint64)usage.ru_utime.tv_sec * 1000) + (usage.ru_utime.tv_usec / 1000));
+    SetCounter("cpu_sys_ms", ((qint64)usage.ru_stime.tv_sec * 1000) + (usage.ru_stime.tv_usec / 1000));
+    SetCounter("max_rss_kb", usage.ru_maxrss);
+  }
+
+  // Current resident size, second field of statm is in pages
+  FILE *statmFile = fopen("/proc/self/statm", "r");
+  if (statmFile) {
+    long sizePages, residentPages;
+    if (fscanf(statmFile, "%ld %ld", &sizePages, &residentPages) == 2) {
+      SetCounter("rss_kb", (qint64)residentPages * (sysconf(_SC_PAGESIZE) / 1024));
+    }
+    fclose(statmFile);
+  }
+#endif
+}
+
+QString
+RenderStats::ReportText() const
+{
+  QString report;
+
+  QMap<QString, TimingStats>::const_iterator timingIt;
+  for (timingIt = m_timings.constBegin(); timingIt != m_timings.constEnd(); ++timingIt) {
+    const TimingStats &timing = timingIt.value();
+    report += QString("%1: n=%2 min=%3ms mean=%4ms p50=%5ms p95=%6ms p99=%7ms max=%8ms\n")
+              .arg(timingIt.key())
+              .arg(timing.Count())
+              .arg(timing.Min() / 1000000.0, 0, 'f', 3)
+              .arg(timing.Mean() / 1000000.0, 0, 'f', 3)
+              .arg(timing.Percentile(50.0) / 1000000.0, 0, 'f', 3)
+              .arg(timing.Percentile(95.0) / 1000000.0, 0, 'f', 3)
+              .arg(timing.Percentile(99.0) / 1000000.0, 0, 'f', 3)
+              .arg(timing.Max() / 1000000.0, 0, 'f', 3);
+  }
+
+  QMap<QString, qint64>::const_iterator counterIt;
+  for (counterIt = m_counters.constBegin(); counterIt != m_counters.constEnd(); ++counterIt) {
+    report += QString("%1: %2\n").arg(counterIt.key()).arg(counterIt.value());
+  }
+
+  return report;
+}
+
+QJsonObject
+RenderStats::ReportJson() const
+{
+  QJsonObject timings;
+  QMap<QString, TimingStats>::const_iterator timingIt;
+  for (timingIt = m_timings.constBegin(); timingIt != m_timings.constEnd(); ++timingIt) {
+    const TimingStats &timing = timingIt.value();
+    QJsonObject timingObj;
+    timingObj["count"] = timing.Count();
+    timingObj["min_ms"] = timing.Min() / 1000000.0;
+    timingObj["mean_ms"] = timing.Mean() / 1000000.0;
+    timingObj["p50_ms"] = timing.Percentile(50.0) / 1000000.0;
+    timingObj["p95_ms"] = timing.Percentile(95.0) / 1000000.0;
+    timingObj["p99_ms"] = timing.Percentile(99.0) / 1000000.0;
+    timingObj["max_ms"] = timing.Max() / 1000000.0;
+    timings[timingIt.key()] = timingObj;
+  }
+
+  QJsonObject counters;
+  QMap<QString, qint64>::const_iterator counterIt;
+  for (counterIt = m_counters.constBegin(); counterIt != m_counters.constEnd(); ++counterIt) {
+    counters[counterIt.key()] = (double)counterIt.value();
+  }
+
+  QJsonObject report;
+  report["timings"] = timings;
+  report["counters"] = counters;
+  return report;
+}
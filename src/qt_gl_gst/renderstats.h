@@ -0,0 +1,59 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <QVector>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+
+#define TIMINGSTATS_MAX_SAMPLES     10000
+
+// Keeps the most recent samples of one timing (in nanoseconds) so
+// percentiles can be worked out when stats are reported.
+class TimingStats
+{
+public:
+  TimingStats();
+
+  void AddSample(qint64 ns);
+  void Reset();
+
+  int Count() const { return m_samples.size(); }
+  qint64 Min() const;
+  qint64 Max() const;
+  qint64 Mean() const;
+  qint64 Percentile(qreal pct) const;
+
+private:
+  QVector<qint64> m_samples;
+  int m_nextSampleIx;
+  // Sorted once for all the percentiles of a report, not per query
+  mutable QVector<qint64> m_sortedSamples;
+  mutable bool m_sortedValid;
+};
+
+// Named timings and counters gathered while rendering, reported as text
+// on request. Timing names are free form, e.g. "cpu_frame" or "gpu_vid0".
+class RenderStats
+{
+public:
+  RenderStats();
+
+  TimingStats &Timing(const QString &name) { return m_timings[name]; }
+  void SetCounter(const QString &name, qint64 value) { m_counters[name] = value; }
+  void AddToCounter(const QString &name, qint64 delta) { m_counters[name] += delta; }
+  qint64 Counter(const QString &name) const { return m_counters.value(name, 0); }
+  QStringList TimingNames() const { return m_timings.keys(); }
+
+  void Reset();
+  void AddProcessCounters();
+  QString ReportText() const;
+  QJsonObject ReportJson() const;
+
+private:
+  QMap<QString, TimingStats> m_timings;
+  QMap<QString, qint64> m_counters;
+};
+
+#endif // RENDERSTATS_H
@@ -0,0 +1,4 @@
+# Same load as run_with_5_vids.sh but with generated streams, so results are comparable between machines.
+# Override with e.g. --synth-format=NV12 --synth-size=1920x1080, results are written to bench_synthetic.json
+
+./qt_gl_gst --headless --frames=1000 --synthetic=5 --synth-format=I420 --synth-size=1280x720 --synth-fps=30 --bench-output=bench_synthetic.json "$@"
@@ -8,6 +8,15 @@ GLShaderModule BrickGLESShaderList[NUM_SHADERS_BRICKGLES] =
   { "shaders/brick.frag", QGLShader::Fragment }
 };
 
+#ifdef RECTTEX_EXT_NEEDED
+// Works on the uploaded frame whatever its format, before YUV conversion
+GLShaderModule VidDeinterlaceShaderList[NUM_SHADERS_VIDDEINTERLACE] =
+{
+  { "shaders/deinterlace.vert", QGLShader::Vertex },
+  { "shaders/deinterlace-recttex.frag", QGLShader::Fragment }
+};
+#endif
+
 #ifdef VIDI420_SHADERS_NEEDED
 /* I420 */
 GLShaderModule VidI420NoEffectNormalisedShaderList[NUM_SHADERS_VIDI420_NOEFFECT_NORMALISED] =
@@ -58,6 +67,22 @@ GLShaderModule VidI420AlphaMaskShaderList[NUM_SHADERS_VIDI420_ALPHAMASK] =
   { "shaders/alphamask"VIDCONV_FRAG_SHADER_SUFFIX".frag", QGLShader::Fragment },
   { "shaders/alphamask.vert", QGLShader::Vertex }
 };
+
+// Batched quads, frames are layers of a texture array whatever the platform
+GLShaderModule VidI420NoEffectInstancedShaderList[NUM_SHADERS_VIDI420_NOEFFECT_INSTANCED] =
+{
+  { "shaders/yuv2rgbI420-texarray.frag", QGLShader::Fragment },
+  { "shaders/noeffect-instanced.vert", QGLShader::Vertex },
+  { "shaders/noeffect.frag", QGLShader::Fragment }
+};
+
+// Conversion and effects come from a 3D LUT, see colourlut.h
+GLShaderModule VidI420ColourLutShaderList[NUM_SHADERS_VIDI420_COLOURLUT] =
+{
+  { "shaders/yuv2rgbI420"VIDCONV_FRAG_SHADER_SUFFIX".frag", QGLShader::Fragment },
+  { "shaders/noeffect.vert", QGLShader::Vertex },
+  { "shaders/colourlut.frag", QGLShader::Fragment }
+};
 #endif
 
 #ifdef VIDUYVY_SHADERS_NEEDED
@@ -162,4 +187,19 @@ GLShaderModule VidNV12AlphaMaskShaderList[NUM_SHADERS_VIDNV12_ALPHAMASK] =
   { "shaders/alphamask"VIDCONV_FRAG_SHADER_SUFFIX".frag", QGLShader::Fragment },
   { "shaders/alphamask.vert", QGLShader::Vertex }
 };
+
+GLShaderModule VidNV12NoEffectInstancedShaderList[NUM_SHADERS_VIDNV12_NOEFFECT_INSTANCED] =
+{
+  { "shaders/yuv2rgbNV12-texarray.frag", QGLShader::Fragment },
+  { "shaders/noeffect-instanced.vert", QGLShader::Vertex },
+  { "shaders/noeffect.frag", QGLShader::Fragment }
+};
+
+// Conversion and effects come from a 3D LUT, see colourlut.h
+GLShaderModule VidNV12ColourLutShaderList[NUM_SHADERS_VIDNV12_COLOURLUT] =
+{
+  { "shaders/yuv2rgbNV12"VIDCONV_FRAG_SHADER_SUFFIX".frag", QGLShader::Fragment },
+  { "shaders/noeffect.vert", QGLShader::Vertex },
+  { "shaders/colourlut.frag", QGLShader::Fragment }
+};
 #endif
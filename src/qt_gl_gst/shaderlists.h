@@ -6,6 +6,11 @@
 #define NUM_SHADERS_BRICKGLES       2
 extern GLShaderModule BrickGLESShaderList[NUM_SHADERS_BRICKGLES];
 
+#ifdef RECTTEX_EXT_NEEDED
+#define NUM_SHADERS_VIDDEINTERLACE       2
+extern GLShaderModule VidDeinterlaceShaderList[NUM_SHADERS_VIDDEINTERLACE];
+#endif
+
 #ifdef VIDI420_SHADERS_NEEDED
 /* I420 */
 #define NUM_SHADERS_VIDI420_NOEFFECT_NORMALISED       3
@@ -28,6 +33,12 @@ extern GLShaderModule VidI420ColourHilightSwapShaderList[NUM_SHADERS_VIDI420_COL
 
 #define NUM_SHADERS_VIDI420_ALPHAMASK       3
 extern GLShaderModule VidI420AlphaMaskShaderList[NUM_SHADERS_VIDI420_ALPHAMASK];
+
+#define NUM_SHADERS_VIDI420_NOEFFECT_INSTANCED       3
+extern GLShaderModule VidI420NoEffectInstancedShaderList[NUM_SHADERS_VIDI420_NOEFFECT_INSTANCED];
+
+#define NUM_SHADERS_VIDI420_COLOURLUT       3
+extern GLShaderModule VidI420ColourLutShaderList[NUM_SHADERS_VIDI420_COLOURLUT];
 #endif
 
 #ifdef VIDUYVY_SHADERS_NEEDED
@@ -76,6 +87,12 @@ extern GLShaderModule VidNV12ColourHilightSwapShaderList[NUM_SHADERS_VIDNV12_COL
 
 #define NUM_SHADERS_VIDNV12_ALPHAMASK       3
 extern GLShaderModule VidNV12AlphaMaskShaderList[NUM_SHADERS_VIDNV12_ALPHAMASK];
+
+#define NUM_SHADERS_VIDNV12_NOEFFECT_INSTANCED       3
+extern GLShaderModule VidNV12NoEffectInstancedShaderList[NUM_SHADERS_VIDNV12_NOEFFECT_INSTANCED];
+
+#define NUM_SHADERS_VIDNV12_COLOURLUT       3
+extern GLShaderModule VidNV12ColourLutShaderList[NUM_SHADERS_VIDNV12_COLOURLUT];
 #endif
 
 #endif // SHADERLISTS_H
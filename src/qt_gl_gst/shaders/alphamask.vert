@@ -4,6 +4,9 @@
 
 uniform highp mat4 u_mvp_matrix;
 uniform highp mat4 u_mv_matrix;
+// Texture co-ords come in as 0..1, scaled to texels where the frag shader needs it
+uniform highp vec2 u_texCoordScale;
+uniform highp vec2 u_alphaTexCoordScale;
 
 attribute highp vec4 a_vertex;
 attribute highp vec3 a_alphaTexCoord;
@@ -15,8 +18,8 @@ varying highp vec4 v_texCoord;
 void main(void)
 {
     gl_Position = (u_mvp_matrix * a_vertex);
-    v_alphaTexCoord = a_alphaTexCoord;
-    v_texCoord = a_texCoord;
+    v_alphaTexCoord = a_alphaTexCoord * vec3(u_alphaTexCoordScale, 1.0);
+    v_texCoord = a_texCoord * vec4(u_texCoordScale, 1.0, 1.0);
 }
 
 
@@ -0,0 +1,18 @@
+// GLSL shader which looks the output colour up in a 3D LUT, with the YUV to
+// RGB conversion and any colour effects or grading baked into it
+// This shader must be linked with another containing yuv2rgb function,
+// its conversion set to pass the YUV samples straight through
+
+
+uniform sampler3D u_lutTexture;
+// 0..1 onto the centres of the first and last entries
+uniform mediump float u_lutScale, u_lutOffset;
+
+mediump vec4 yuv2rgb(void);
+
+void main(void)
+{
+	mediump vec3 yuv = clamp(yuv2rgb().rgb, 0.0, 1.0);
+
+	gl_FragColor = vec4(texture3D(u_lutTexture, yuv * u_lutScale + u_lutOffset).rgb, 1.0);
+}
@@ -0,0 +1,98 @@
+// Deinterlaces a frame held the way the vid textures hold it: one single
+// channel texture with the planes one after the other. Each output texel
+// is mapped back to its plane, line and column so that lines missing from
+// the kept field can be rebuilt from the lines either side in the same
+// plane. Output is the same layout, so the YUV conversion shaders don't
+// change.
+//
+// u_format: 0 I420, 1 NV12, 2 UYVY
+// u_mode:   0 bob (repeat the line above), 1 linear (average the lines
+//           either side), 2 motion adaptive (weave where the missing field
+//           hasn't changed since the previous frame, linear where it has)
+// u_keepParity: 0 keeps the top field (even lines), 1 the bottom
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform lowp sampler2DRect u_frameTexture;
+uniform lowp sampler2DRect u_prevTexture;
+uniform highp float u_yWidth, u_yHeight;
+uniform mediump float u_format;
+uniform mediump float u_mode;
+uniform mediump float u_keepParity;
+uniform mediump float u_motionLow, u_motionHigh;
+
+// Plane of the texel being written
+highp float planeBase;
+highp float planeLines;
+highp float planeHalfRows;
+
+// Texel of the given line and column in the current plane
+highp vec2 lineCoord(highp float line, highp float col)
+{
+	line = clamp(line, 0.0, planeLines - 1.0);
+	if (planeHalfRows > 0.5) {
+		// I420 chroma, two lines per texture row
+		return vec2(mod(line, 2.0) * (u_yWidth / 2.0) + col + 0.5, planeBase + floor(line / 2.0) + 0.5);
+	}
+	return vec2(col + 0.5, planeBase + line + 0.5);
+}
+
+mediump float sampleLine(sampler2DRect tex, highp float line, highp float col)
+{
+	return texture2DRect(tex, lineCoord(line, col)).r;
+}
+
+void main(void)
+{
+	highp vec2 texel = floor(gl_FragCoord.xy);
+	highp float line = texel.y;
+	highp float col = texel.x;
+
+	planeBase = 0.0;
+	planeLines = u_yHeight;
+	planeHalfRows = 0.0;
+
+	if (texel.y >= u_yHeight) {
+		if (u_format < 0.5) {
+			// I420 U then V, each a quarter of the Y height in texture rows
+			planeBase = (texel.y < u_yHeight * 1.25) ? u_yHeight : u_yHeight * 1.25;
+			planeLines = u_yHeight / 2.0;
+			planeHalfRows = 1.0;
+			line = (texel.y - planeBase) * 2.0 + ((texel.x >= u_yWidth / 2.0) ? 1.0 : 0.0);
+			col = mod(texel.x, u_yWidth / 2.0);
+		}
+		else {
+			// NV12 interleaved UV, one line per row
+			planeBase = u_yHeight;
+			planeLines = u_yHeight / 2.0;
+			line = texel.y - planeBase;
+		}
+	}
+
+	mediump float current = sampleLine(u_frameTexture, line, col);
+	if (mod(line, 2.0) == u_keepParity) {
+		gl_FragColor = vec4(current, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	// Kept field's lines either side, one of them may be off the edge
+	mediump float above = sampleLine(u_frameTexture, (line > 0.0) ? line - 1.0 : line + 1.0, col);
+	mediump float below = sampleLine(u_frameTexture, (line < planeLines - 1.0) ? line + 1.0 : line - 1.0, col);
+
+	mediump float result;
+	if (u_mode < 0.5) {
+		result = above;
+	}
+	else {
+		result = (above + below) * 0.5;
+		if (u_mode > 1.5) {
+			// Either field changing counts as motion
+			mediump float motion = abs(current - sampleLine(u_prevTexture, line, col));
+			motion = max(motion, abs(above - sampleLine(u_prevTexture, (line > 0.0) ? line - 1.0 : line + 1.0, col)));
+			motion = max(motion, abs(below - sampleLine(u_prevTexture, (line < planeLines - 1.0) ? line + 1.0 : line - 1.0, col)));
+			result = mix(current, result, smoothstep(u_motionLow, u_motionHigh, motion));
+		}
+	}
+
+	gl_FragColor = vec4(result, 0.0, 0.0, 1.0);
+}
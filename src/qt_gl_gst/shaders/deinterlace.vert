@@ -0,0 +1,10 @@
+// GLES shader covering the whole deinterlace target, the frag shader
+// works from gl_FragCoord
+
+
+attribute highp vec4 a_vertex;
+
+void main(void)
+{
+    gl_Position = a_vertex;
+}
@@ -0,0 +1,22 @@
+// GLES shader for passing interpolated texture co-ordinates
+// to the video fragment shader, for batches of video quads drawn
+// with one instanced call. Transform and texture array layer are
+// per-instance attributes.
+
+
+// Texture co-ords come in as 0..1, scaled to texels for the frag shader
+uniform highp vec2 u_texCoordScale;
+
+attribute highp vec4 a_vertex;
+attribute highp vec4 a_texCoord;
+attribute highp mat4 a_instanceMvp;
+attribute highp float a_instanceLayer;
+
+// Array layer is passed through in z
+varying highp vec4 v_texCoord;
+
+void main(void)
+{
+    gl_Position = (a_instanceMvp * a_vertex);
+    v_texCoord = vec4(a_texCoord.xy * u_texCoordScale, a_instanceLayer, 1.0);
+}
@@ -4,6 +4,8 @@
 
 uniform highp mat4 u_mvp_matrix;
 uniform highp mat4 u_mv_matrix;
+// Texture co-ords come in as 0..1, scaled to texels where the frag shader needs it
+uniform highp vec2 u_texCoordScale;
 
 attribute highp vec4 a_vertex;
 attribute highp vec4 a_texCoord;
@@ -13,7 +15,7 @@ varying mediump vec4 v_texCoord;
 void main(void)
 {
     gl_Position = (u_mvp_matrix * a_vertex);
-    v_texCoord = a_texCoord;
+    v_texCoord = a_texCoord * vec4(u_texCoordScale, 1.0, 1.0);
 }
 
 
@@ -0,0 +1,15 @@
+// GLSL effect chain pass which multiplies the colour's alpha by another
+// texture used as an alpha mask, using an average of rgb
+// Linked with the other passes of a stage and a generated main()
+
+uniform sampler2DRect u_alphaTexture;
+
+varying vec3 v_alphaTexCoord;
+
+vec4 alphaMaskPass(vec4 colour)
+{
+	vec4 alphaColour = texture2DRect(u_alphaTexture, v_alphaTexCoord.xy);
+	float alphaAverage = (alphaColour.r + alphaColour.g + alphaColour.b) / 3.0;
+
+	return vec4(colour.rgb, colour.a * alphaAverage);
+}
@@ -0,0 +1,16 @@
+// GLSL effect chain pass which multiplies the colour's alpha by another
+// texture used as an alpha mask, using an average of rgb
+// Linked with the other passes of a stage and a generated main()
+
+
+uniform highp sampler2D u_alphaTexture;
+
+varying highp vec3 v_alphaTexCoord;
+
+mediump vec4 alphaMaskPass(mediump vec4 colour)
+{
+	highp vec4 alphaColour = texture2D(u_alphaTexture, v_alphaTexCoord.xy);
+	highp float alphaAverage = (alphaColour.r + alphaColour.g + alphaColour.b) / 3.0;
+
+	return vec4(colour.rgb, colour.a * alphaAverage);
+}
@@ -0,0 +1,26 @@
+// GLSL effect chain pass which blurs the previous stage's output with a
+// 3x3 gaussian
+// Starts a stage, linked with the other passes of it and a generated main()
+
+
+uniform sampler2D u_stageTexture;
+// Size of one texel of the stage texture, in 0..1 co-ords
+uniform highp vec2 u_texelSize;
+
+varying highp vec4 v_texCoord;
+
+mediump vec4 blurPass(void)
+{
+	highp vec2 centre = v_texCoord.xy;
+	highp vec2 dx = vec2(u_texelSize.x, 0.0);
+	highp vec2 dy = vec2(0.0, u_texelSize.y);
+	mediump vec4 sum;
+
+	sum = texture2D(u_stageTexture, centre) * 4.0;
+	sum += (texture2D(u_stageTexture, centre - dx) + texture2D(u_stageTexture, centre + dx) +
+	        texture2D(u_stageTexture, centre - dy) + texture2D(u_stageTexture, centre + dy)) * 2.0;
+	sum += texture2D(u_stageTexture, centre - dx - dy) + texture2D(u_stageTexture, centre + dx - dy) +
+	       texture2D(u_stageTexture, centre - dx + dy) + texture2D(u_stageTexture, centre + dx + dy);
+
+	return sum / 16.0;
+}
@@ -0,0 +1,46 @@
+// GLSL effect chain passes which make the colour monochrome except colours
+// in a certain range, and optionally swap the components of those, as
+// colourhilight.frag and colourhilightswap.frag do
+// Linked with the other passes of a stage and a generated main()
+
+
+uniform mediump vec4 u_colrToDisplayMin, u_colrToDisplayMax;
+uniform mediump vec4 u_componentSwapR, u_componentSwapG, u_componentSwapB;
+
+bool colourInRange(mediump vec4 colour)
+{
+	return (colour.r > u_colrToDisplayMin.r) && (colour.r < u_colrToDisplayMax.r) &&
+	       (colour.r > u_colrToDisplayMin.g) && (colour.r < u_colrToDisplayMax.g) &&
+	       (colour.r > u_colrToDisplayMin.b) && (colour.r < u_colrToDisplayMax.b);
+}
+
+mediump vec4 colourMono(mediump vec4 colour)
+{
+	mediump float monoComponent = (colour.r + colour.g + colour.b) / 3.0;
+
+	return vec4(monoComponent, monoComponent, monoComponent, colour.a);
+}
+
+mediump vec4 colourPass(mediump vec4 colour)
+{
+	if(colourInRange(colour))
+	{
+		return colour;
+	}
+	return colourMono(colour);
+}
+
+mediump vec4 colourSwapPass(mediump vec4 colour)
+{
+	mediump vec4 swappedColour;
+
+	if(colourInRange(colour))
+	{
+		swappedColour.r = clamp(dot(colour.rgb, u_componentSwapR.rgb), 0.0, 1.0);
+		swappedColour.g = clamp(dot(colour.rgb, u_componentSwapG.rgb), 0.0, 1.0);
+		swappedColour.b = clamp(dot(colour.rgb, u_componentSwapB.rgb), 0.0, 1.0);
+		swappedColour.a = colour.a;
+		return swappedColour;
+	}
+	return colourMono(colour);
+}
@@ -0,0 +1,26 @@
+// GLSL effect chain pass which sharpens the previous stage's output with an
+// unsharp mask over the 4 neighbours
+// Starts a stage, linked with the other passes of it and a generated main()
+
+
+uniform sampler2D u_stageTexture;
+// Size of one texel of the stage texture, in 0..1 co-ords
+uniform highp vec2 u_texelSize;
+
+varying highp vec4 v_texCoord;
+
+const mediump float SHARPEN_AMOUNT = 0.5;
+
+mediump vec4 sharpenPass(void)
+{
+	highp vec2 centre = v_texCoord.xy;
+	highp vec2 dx = vec2(u_texelSize.x, 0.0);
+	highp vec2 dy = vec2(0.0, u_texelSize.y);
+	mediump vec4 colour = texture2D(u_stageTexture, centre);
+	mediump vec4 neighbours;
+
+	neighbours = texture2D(u_stageTexture, centre - dx) + texture2D(u_stageTexture, centre + dx) +
+	             texture2D(u_stageTexture, centre - dy) + texture2D(u_stageTexture, centre + dy);
+
+	return clamp(colour + (colour * 4.0 - neighbours) * SHARPEN_AMOUNT, 0.0, 1.0);
+}
@@ -0,0 +1,4 @@
+// Turns rectangle textures on for fragment shaders which sample them without
+// a recttex conversion shader linked in ahead, which would do it
+
+#extension GL_ARB_texture_rectangle : enable
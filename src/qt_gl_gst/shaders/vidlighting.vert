@@ -7,6 +7,8 @@ const mediump float DiffuseContribution  = 1.0 - SpecularContribution;
 
 uniform highp mat4 u_mvp_matrix;
 uniform highp mat4 u_mv_matrix;
+// Texture co-ords come in as 0..1, scaled to texels where the frag shader needs it
+uniform highp vec2 u_texCoordScale;
 
 attribute highp vec4 a_vertex;
 attribute highp vec3 a_normal;
@@ -40,6 +42,6 @@ void main(void)
                       SpecularContribution * spec;
 
     gl_Position     = (u_mvp_matrix * a_vertex);
-    v_texCoord = a_texCoord;
+    v_texCoord = a_texCoord * vec4(u_texCoordScale, 1.0, 1.0);
 }
 
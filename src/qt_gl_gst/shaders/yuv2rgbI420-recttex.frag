@@ -1,5 +1,7 @@
 // Perform YUV to RGB conversion on I420 format planar YUV data
-// Using formula:
+// Using R = dot(YUV + offset, rCoeff) and the same for G and B, with the
+// offset and coefficients set for the stream's matrix and range, e.g.
+// for BT.601 limited range:
 // R = 1.164(Y - 16) + 1.596(V - 128)
 // G = 1.164(Y - 16) - 0.813(V - 128) - 0.391(U - 128)
 // B = 1.164(Y - 16)                  + 2.018(U - 128)
@@ -8,15 +10,14 @@
 
 uniform lowp sampler2DRect u_vidTexture;
 uniform lowp float u_yHeight, u_yWidth;
+// Samples of 16 bit textures holding 10 bit values are scaled back to 0..1
+uniform mediump float u_sampleScale;
 
 varying highp vec4 v_texCoord;
 
-// YUV offset (reciprocals of 255 based offsets above)
-const mediump vec3 offset = vec3(-0.0625, -0.5, -0.5);
-// RGB coefficients 
-const mediump vec3 rCoeff = vec3(1.164,  0.000,  1.596);
-const mediump vec3 gCoeff = vec3(1.164, -0.391, -0.813);
-const mediump vec3 bCoeff = vec3(1.164,  2.018,  0.000);
+// YUV offset and RGB coefficients, 0..1 based
+uniform mediump vec3 u_yuvOffset;
+uniform mediump vec3 u_rCoeff, u_gCoeff, u_bCoeff;
 
 vec4 yuv2rgb()
 {
@@ -43,10 +44,11 @@ vec4 yuv2rgb()
 	yuv.b = texture2DRect(u_vidTexture, texCoord.xy).r;
 
 	// Convert
-	yuv += offset;
-	rgb.r = dot(yuv, rCoeff);
-	rgb.g = dot(yuv, gCoeff);
-	rgb.b = dot(yuv, bCoeff);
+	yuv *= u_sampleScale;
+	yuv += u_yuvOffset;
+	rgb.r = dot(yuv, u_rCoeff);
+	rgb.g = dot(yuv, u_gCoeff);
+	rgb.b = dot(yuv, u_bCoeff);
 
 	return vec4(rgb, 1.0);
 }
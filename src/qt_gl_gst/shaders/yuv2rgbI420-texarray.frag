@@ -0,0 +1,54 @@
+// Perform YUV to RGB conversion on I420 format planar YUV data,
+// with each video frame in a layer of a texture array
+// Using R = dot(YUV + offset, rCoeff) and the same for G and B, with the
+// offset and coefficients set for the stream's matrix and range, e.g.
+// for BT.601 limited range:
+// R = 1.164(Y - 16) + 1.596(V - 128)
+// G = 1.164(Y - 16) - 0.813(V - 128) - 0.391(U - 128)
+// B = 1.164(Y - 16)                  + 2.018(U - 128)
+
+#extension GL_EXT_texture_array : enable
+
+uniform lowp sampler2DArray u_vidTexture;
+uniform highp float u_yHeight, u_yWidth;
+
+// xy in texels, z is the array layer
+varying highp vec4 v_texCoord;
+
+// YUV offset and RGB coefficients, 0..1 based
+uniform mediump vec3 u_yuvOffset;
+uniform mediump vec3 u_rCoeff, u_gCoeff, u_bCoeff;
+
+vec4 yuv2rgb()
+{
+	mediump vec3 yuv, rgb;
+	highp vec2 texCoord;
+	// Array textures take normalised co-ords
+	highp vec2 texScale = vec2(1.0 / u_yWidth, 1.0 / (u_yHeight * 1.5));
+
+	texCoord = v_texCoord.xy;
+
+	// lookup Y
+	yuv.r = texture2DArray(u_vidTexture, vec3(texCoord * texScale, v_texCoord.z)).r;
+	// lookup U
+	// co-ordinate conversion algorithm for i420:
+	//	x /= 2.0; if modulo2(y) then x += width/2.0;
+	texCoord.x /= 2.0;
+	if((texCoord.y - floor(texCoord.y)) == 0.0)
+	{
+		texCoord.x += (u_yWidth/2.0);
+	}
+	texCoord.y = u_yHeight+(texCoord.y/4.0);
+	yuv.g = texture2DArray(u_vidTexture, vec3(texCoord * texScale, v_texCoord.z)).r;
+	// lookup V
+	texCoord.y += u_yHeight/4.0;
+	yuv.b = texture2DArray(u_vidTexture, vec3(texCoord * texScale, v_texCoord.z)).r;
+
+	// Convert
+	yuv += u_yuvOffset;
+	rgb.r = dot(yuv, u_rCoeff);
+	rgb.g = dot(yuv, u_gCoeff);
+	rgb.b = dot(yuv, u_bCoeff);
+
+	return vec4(rgb, 1.0);
+}
@@ -0,0 +1,50 @@
+// Perform YUV to RGB conversion on NV12 format semi-planar YUV data
+// (full size Y plane followed by a half height plane of interleaved U/V)
+// Using R = dot(YUV + offset, rCoeff) and the same for G and B, with the
+// offset and coefficients set for the stream's matrix and range, e.g.
+// for BT.601 limited range:
+// R = 1.164(Y - 16) + 1.596(V - 128)
+// G = 1.164(Y - 16) - 0.813(V - 128) - 0.391(U - 128)
+// B = 1.164(Y - 16)                  + 2.018(U - 128)
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform lowp sampler2DRect u_vidTexture;
+uniform highp float u_yHeight, u_yWidth;
+// Samples of 16 bit textures holding 10 bit values are scaled back to 0..1
+uniform mediump float u_sampleScale;
+
+varying highp vec4 v_texCoord;
+
+// YUV offset and RGB coefficients, 0..1 based
+uniform mediump vec3 u_yuvOffset;
+uniform mediump vec3 u_rCoeff, u_gCoeff, u_bCoeff;
+
+vec4 yuv2rgb()
+{
+	mediump vec3 yuv, rgb;
+	highp vec2 texCoord;
+	highp vec2 chromaCoord;
+
+	texCoord.x = v_texCoord.x * u_yWidth;
+	texCoord.y = v_texCoord.y * u_yHeight;
+
+	// lookup Y
+	yuv.r = texture2DRect(u_vidTexture, texCoord).r;
+	// lookup U and V, one pair per 2x2 block of Y:
+	//	x = 2*floor(x/2) (+1 for V), y = height + floor(y/2)
+	chromaCoord.x = (floor(texCoord.x / 2.0) * 2.0) + 0.5;
+	chromaCoord.y = u_yHeight + floor(texCoord.y / 2.0) + 0.5;
+	yuv.g = texture2DRect(u_vidTexture, chromaCoord).r;
+	chromaCoord.x += 1.0;
+	yuv.b = texture2DRect(u_vidTexture, chromaCoord).r;
+
+	// Convert
+	yuv *= u_sampleScale;
+	yuv += u_yuvOffset;
+	rgb.r = dot(yuv, u_rCoeff);
+	rgb.g = dot(yuv, u_gCoeff);
+	rgb.b = dot(yuv, u_bCoeff);
+
+	return vec4(rgb, 1.0);
+}
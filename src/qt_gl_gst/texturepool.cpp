@@ -0,0 +1,183 @@
+#include "texturepool.h"
+#include "applogger.h"
+
+TexturePool::TexturePool(GLenum target) :
+  m_target(target), m_budgetBytes(0), m_bytesAllocated(0), m_bytesInUse(0),
+  m_nextReleaseSeq(0), m_hits(0), m_misses(0), m_evictions(0), m_budgetFailures(0),
+  m_lastAcquireFailed(false)
+{
+}
+
+TexturePool::~TexturePool()
+{
+}
+
+void
+TexturePool::Cleanup()
+{
+  QMap<GLuint, PoolTexture>::const_iterator texIt;
+  for (texIt = m_inUse.constBegin(); texIt != m_inUse.constEnd(); ++texIt) {
+    glDeleteTextures(1, &texIt.value().texId);
+  }
+  for (int freeIx = 0; freeIx < m_free.size(); freeIx++) {
+    glDeleteTextures(1, &m_free[freeIx].texId);
+  }
+  m_inUse.clear();
+  m_free.clear();
+  m_bytesAllocated = 0;
+  m_bytesInUse = 0;
+}
+
+GLuint
+TexturePool::Acquire(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+{
+  // Most recently released match, it's the likeliest to still be resident
+  int matchIx = -1;
+  for (int freeIx = 0; freeIx < m_free.size(); freeIx++) {
+    const PoolTexture &tex = m_free[freeIx];
+    if ((tex.internalFormat == internalFormat) && (tex.width == width) && (tex.height == height) &&
+        ((matchIx < 0) || (tex.releaseSeq > m_free[matchIx].releaseSeq))) {
+      matchIx = freeIx;
+    }
+  }
+
+  if (matchIx >= 0) {
+    PoolTexture tex = m_free.takeAt(matchIx);
+    m_inUse.insert(tex.texId, tex);
+    m_bytesInUse += tex.bytes;
+    m_hits++;
+    m_lastAcquireFailed = false;
+    return tex.texId;
+  }
+
+  m_misses++;
+
+  qint64 bytesNeeded = textureBytes(internalFormat, width, height);
+  if (!evictFor(bytesNeeded)) {
+    m_budgetFailures++;
+    if (!m_lastAcquireFailed) {
+      LOG(LOG_GL, Logger::Warning, "%dx%d texture (%lld bytes) won't fit in the %lld byte budget, %lld bytes in use",
+          width, height, bytesNeeded, m_budgetBytes, m_bytesInUse);
+    }
+    m_lastAcquireFailed = true;
+    return 0;
+  }
+  m_lastAcquireFailed = false;
+
+  PoolTexture newTex;
+  newTex.internalFormat = internalFormat;
+  newTex.width = width;
+  newTex.height = height;
+  newTex.bytes = bytesNeeded;
+  newTex.releaseSeq = 0;
+
+  // Storage allocated once here, frames are uploaded with glTexSubImage2D
+  glGenTextures(1, &newTex.texId);
+  glBindTexture(m_target, newTex.texId);
+  glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(m_target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(m_target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(m_target, 0, internalFormat, width, height, 0, format, type, NULL);
+
+  m_inUse.insert(newTex.texId, newTex);
+  m_bytesAllocated += newTex.bytes;
+  m_bytesInUse += newTex.bytes;
+
+  LOG(LOG_GL, Logger::Debug1, "New %dx%d pool texture %u, %lld bytes allocated",
+      width, height, newTex.texId, m_bytesAllocated);
+
+  return newTex.texId;
+}
+
+bool
+TexturePool::Release(GLuint texId)
+{
+  if (!m_inUse.contains(texId)) {
+    return false;
+  }
+
+  PoolTexture tex = m_inUse.take(texId);
+  tex.releaseSeq = m_nextReleaseSeq++;
+  m_bytesInUse -= tex.bytes;
+  m_free.append(tex);
+
+  // Budget may have been lowered since, or only just fitted
+  evictFor(0);
+  return true;
+}
+
+void
+TexturePool::ReportStats(RenderStats &stats) const
+{
+  stats.SetCounter("texpool_bytes_allocated", m_bytesAllocated);
+  stats.SetCounter("texpool_bytes_in_use", m_bytesInUse);
+  stats.SetCounter("texpool_budget_bytes", m_budgetBytes);
+  stats.SetCounter("texpool_textures", m_inUse.size() + m_free.size());
+  stats.SetCounter("texpool_hits", m_hits);
+  stats.SetCounter("texpool_misses", m_misses);
+  stats.SetCounter("texpool_evictions", m_evictions);
+  stats.SetCounter("texpool_budget_failures", m_budgetFailures);
+}
+
+// Free textures go oldest release first until the new one fits. Textures in
+// use are never taken back, so it can still fail.
+bool
+TexturePool::evictFor(qint64 bytesNeeded)
+{
+  if (m_budgetBytes == 0) {
+    return true;
+  }
+
+  while ((m_bytesAllocated + bytesNeeded > m_budgetBytes) && !m_free.isEmpty()) {
+    int oldestIx = 0;
+    for (int freeIx = 1; freeIx < m_free.size(); freeIx++) {
+      if (m_free[freeIx].releaseSeq < m_free[oldestIx].releaseSeq) {
+        oldestIx = freeIx;
+      }
+    }
+    deleteTexture(m_free.takeAt(oldestIx));
+    m_evictions++;
+  }
+
+  return (m_bytesAllocated + bytesNeeded <= m_budgetBytes);
+}
+
+void
+TexturePool::deleteTexture(const PoolTexture &tex)
+{
+  LOG(LOG_GL, Logger::Debug1, "Deleting %dx%d pool texture %u", tex.width, tex.height, tex.texId);
+  glDeleteTextures(1, &tex.texId);
+  m_bytesAllocated -= tex.bytes;
+}
+
+// Level 0 only, video textures have no mipmaps
+qint64
+TexturePool::textureBytes(GLint internalFormat, int width, int height)
+{
+  int texelBytes;
+
+  switch (internalFormat) {
+  case GL_ALPHA:
+  case GL_LUMINANCE:
+#ifdef GL_R8
+  case GL_R8:
+#endif
+    texelBytes = 1;
+    break;
+  case GL_LUMINANCE_ALPHA:
+#ifdef GL_LUMINANCE16
+  case GL_LUMINANCE16:
+#endif
+    texelBytes = 2;
+    break;
+  case GL_RGB:
+    texelBytes = 3;
+    break;
+  default:
+    texelBytes = 4;
+    break;
+  }
+
+  return (qint64)width * height * texelBytes;
+}
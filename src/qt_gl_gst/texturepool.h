@@ -0,0 +1,72 @@
+#ifndef TEXTUREPOOL_H
+#define TEXTUREPOOL_H
+
+#include <QGLContext>
+#include <QList>
+#include <QMap>
+
+#include "renderstats.h"
+
+// Hands out video textures with their storage already allocated, keyed by
+// internal format and size. Released textures are kept for the next stream
+// of the same format and size, so pipeline restarts and going back to an
+// earlier resolution don't allocate again. Total storage is kept under a
+// budget by deleting the least recently released textures first.
+class TexturePool
+{
+public:
+  TexturePool(GLenum target);
+  ~TexturePool();
+
+  // Bytes, 0 for no limit
+  void SetBudget(qint64 budgetBytes) { m_budgetBytes = budgetBytes; }
+  qint64 Budget() const { return m_budgetBytes; }
+
+  // Context must be current. Returns 0 if a new texture wouldn't fit in the
+  // budget even with every free texture deleted.
+  GLuint Acquire(GLint internalFormat, GLenum format, GLenum type, int width, int height);
+  // Returns false if the texture didn't come from the pool, it's left alone
+  bool Release(GLuint texId);
+
+  // Context must be current. Deletes every texture, in use or not.
+  void Cleanup();
+
+  qint64 BytesAllocated() const { return m_bytesAllocated; }
+  qint64 BytesInUse() const { return m_bytesInUse; }
+
+  // Current usage and hit/miss counts as counters named texpool_*
+  void ReportStats(RenderStats &stats) const;
+
+private:
+  typedef struct _PoolTexture
+  {
+    GLuint texId;
+    GLint internalFormat;
+    int width;
+    int height;
+    qint64 bytes;
+    // Release order, lowest is deleted first when over budget
+    quint64 releaseSeq;
+  } PoolTexture;
+
+  static qint64 textureBytes(GLint internalFormat, int width, int height);
+  bool evictFor(qint64 bytesNeeded);
+  void deleteTexture(const PoolTexture &tex);
+
+  GLenum m_target;
+  qint64 m_budgetBytes;
+  qint64 m_bytesAllocated;
+  qint64 m_bytesInUse;
+
+  QMap<GLuint, PoolTexture> m_inUse;
+  QList<PoolTexture> m_free;
+  quint64 m_nextReleaseSeq;
+
+  quint64 m_hits;
+  quint64 m_misses;
+  quint64 m_evictions;
+  quint64 m_budgetFailures;
+  bool m_lastAcquireFailed;
+};
+
+#endif // TEXTUREPOOL_H
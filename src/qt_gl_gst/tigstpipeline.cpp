@@ -22,14 +22,7 @@ TIGStreamerPipeline::Configure()
 
   // Create the elements
   this->m_pipeline = gst_pipeline_new(NULL);
-  if (this->m_videoLocation.isEmpty()) {
-    LOG(LOG_VIDPIPELINE, Logger::Info, "No video file specified. Using video test source.");
-    this->m_source = gst_element_factory_make("videotestsrc", "testsrc");
-  }
-  else {
-    this->m_source = gst_element_factory_make("filesrc", "filesrc");
-    g_object_set(G_OBJECT(this->m_source), "location", m_videoLocation.toUtf8().constData(), NULL);
-  }
+  createSource();
 
   // gst-launch -v filesrc location=sample.mp4 ! qtdemux name=demux demux.audio_00 !
   //  queue max-size-buffers=8000 max-size-time=0 max-size-bytes=0 ! TIAuddec1 !
@@ -63,7 +56,7 @@ TIGStreamerPipeline::Configure()
   g_signal_connect(this->m_qtdemux, "pad-added", G_CALLBACK(on_new_pad), this);
 
   // Link the elements
-  gst_element_link(this->m_source, this->m_qtdemux);
+  linkSource(this->m_qtdemux);
   gst_element_link(this->m_audioqueue, this->m_tiaudiodecode);
   //gst_element_link(this->m_tiaudiodecode, this->m_audiosink);
   gst_element_link(this->m_videoqueue, this->m_tividdecode);
@@ -78,12 +71,8 @@ TIGStreamerPipeline::Configure()
 #else
   gst_element_link(this->m_tividdecode, this->m_videosink);
 #endif
-  m_bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
-  gst_bus_add_watch(m_bus, (GstBusFunc)bus_call, this);
-  gst_object_unref(m_bus);
-
-  gst_element_set_state(this->m_pipeline, GST_STATE_PAUSED);
-
+  watchVideoSink();
+  watchBusAndPause();
 }
 
 void
@@ -0,0 +1,232 @@
+#include <math.h>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "vidlayout.h"
+#include "glwidget.h"
+#include "applogger.h"
+
+// Flat layouts are drawn in pixel co-ords, right at the back so the model
+// stays in front of the wall
+#define FLAT_LAYOUT_DEPTH     -0.99f
+
+VidLayout::VidLayout() :
+  m_type(VidLayoutCarousel), m_stacked(false), m_scaleDecode(false), m_gridColumns(0),
+  m_gridMargin(DFLT_LAYOUT_GRID_MARGIN), m_focusTile(0), m_thumbnailSize(DFLT_LAYOUT_THUMBNAIL_SIZE)
+{
+}
+
+bool
+VidLayout::Load(const QString &fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG(LOG_GL, Logger::Error, "Couldn't open layout file %s", fileName.toUtf8().constData());
+    return false;
+  }
+
+  QJsonParseError parseError;
+  QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+  if (!doc.isObject()) {
+    LOG(LOG_GL, Logger::Error, "Layout file %s: %s", fileName.toUtf8().constData(),
+        parseError.errorString().toUtf8().constData());
+    return false;
+  }
+
+  QJsonObject config = doc.object();
+
+  QString layoutName = config.value("layout").toString("carousel");
+  if (layoutName == "carousel") {
+    m_type = VidLayoutCarousel;
+  }
+  else if (layoutName == "stack") {
+    m_type = VidLayoutStack;
+  }
+  else if (layoutName == "grid") {
+    m_type = VidLayoutGrid;
+  }
+  else if (layoutName == "focus") {
+    m_type = VidLayoutFocus;
+  }
+  else {
+    LOG(LOG_GL, Logger::Error, "Unknown layout \"%s\" in %s", layoutName.toUtf8().constData(),
+        fileName.toUtf8().constData());
+    return false;
+  }
+
+  // Whole point of giving a layout is usually a big wall, so scale by default
+  m_scaleDecode = config.value("scaleDecode").toBool(true);
+  m_gridColumns = qMax(0, config.value("columns").toInt(0));
+  m_gridMargin = qMax(0, config.value("margin").toInt(DFLT_LAYOUT_GRID_MARGIN));
+  m_focusTile = qMax(0, config.value("focus").toInt(0));
+  m_thumbnailSize = qBound(0.05, config.value("thumbnailSize").toDouble(DFLT_LAYOUT_THUMBNAIL_SIZE), 0.95);
+
+  LOG(LOG_GL, Logger::Info, "Using %s layout from %s", layoutName.toUtf8().constData(),
+      fileName.toUtf8().constData());
+  return true;
+}
+
+void
+VidLayout::Update(int numTiles, const QMatrix4x4 &modelViewMatrix,
+                  const QMatrix4x4 &projectionMatrix, const QSize &viewportSize)
+{
+  m_tiles.resize(numTiles);
+  if (numTiles == 0) {
+    return;
+  }
+
+  switch (m_stacked ? VidLayoutStack : m_type) {
+  case VidLayoutCarousel:
+  case VidLayoutStack:
+    layoutAroundModel(modelViewMatrix, projectionMatrix);
+    break;
+  case VidLayoutGrid:
+  case VidLayoutFocus:
+    layoutFlat(viewportSize);
+    break;
+  }
+
+  for (int tileIx = 0; tileIx < numTiles; tileIx++) {
+    bool frontFacing;
+    m_tiles[tileIx].pixelSize = projectedSize(m_tiles[tileIx].mvpMatrix, viewportSize, frontFacing);
+    m_tiles[tileIx].visible = frontFacing && !m_tiles[tileIx].pixelSize.isEmpty();
+  }
+}
+
+void
+VidLayout::layoutAroundModel(const QMatrix4x4 &modelViewMatrix, const QMatrix4x4 &projectionMatrix)
+{
+  for (int tileIx = 0; tileIx < m_tiles.size(); tileIx++) {
+    QMatrix4x4 mvMatrix = modelViewMatrix;
+
+    if (m_stacked || (m_type == VidLayoutStack)) {
+      mvMatrix.translate(0.0, 0.0, 2.0);
+      mvMatrix.translate(0.0, 0.0, 0.2*tileIx);
+    }
+    else {
+      mvMatrix.rotate((360/m_tiles.size())*tileIx, 0.0, 1.0, 0.0);
+      mvMatrix.translate(0.0, 0.0, 2.0);
+    }
+
+    m_tiles[tileIx].mvMatrix = mvMatrix;
+    m_tiles[tileIx].mvpMatrix = projectionMatrix * mvMatrix;
+  }
+}
+
+void
+VidLayout::layoutFlat(const QSize &viewportSize)
+{
+  // y down to match the usual screen layout
+  QMatrix4x4 orthoMatrix;
+  orthoMatrix.ortho(0.0f, viewportSize.width(), viewportSize.height(), 0.0f, -1.0f, 1.0f);
+
+  for (int tileIx = 0; tileIx < m_tiles.size(); tileIx++) {
+    QRectF rect = flatTileRect(tileIx, viewportSize);
+    rect.adjust(m_gridMargin / 2.0, m_gridMargin / 2.0, -m_gridMargin / 2.0, -m_gridMargin / 2.0);
+
+    // Stretch the quad to fill the tile, flipping y as quad top is +y
+    QMatrix4x4 mvMatrix;
+    mvMatrix.translate(rect.center().x(), rect.center().y(), FLAT_LAYOUT_DEPTH);
+    mvMatrix.scale(rect.width() / (VIDTEXTURE_RIGHT_X - VIDTEXTURE_LEFT_X),
+                   -rect.height() / (VIDTEXTURE_TOP_Y - VIDTEXTURE_BOT_Y), 1.0);
+
+    m_tiles[tileIx].mvMatrix = mvMatrix;
+    m_tiles[tileIx].mvpMatrix = orthoMatrix * mvMatrix;
+  }
+}
+
+QRectF
+VidLayout::flatTileRect(int tileIx, const QSize &viewportSize)
+{
+  int numTiles = m_tiles.size();
+  qreal viewWidth = viewportSize.width();
+  qreal viewHeight = viewportSize.height();
+
+  if (m_type == VidLayoutGrid) {
+    int columns = m_gridColumns;
+    if (columns == 0) {
+      columns = (int)ceil(sqrt((double)numTiles));
+    }
+    int rows = (numTiles + columns - 1) / columns;
+    qreal cellWidth = viewWidth / columns;
+    qreal cellHeight = viewHeight / rows;
+
+    return QRectF((tileIx % columns) * cellWidth, (tileIx / columns) * cellHeight, cellWidth, cellHeight);
+  }
+
+  // Focus: one big tile across the top, thumbnails of the rest along the bottom
+  if (numTiles == 1) {
+    return QRectF(0.0, 0.0, viewWidth, viewHeight);
+  }
+
+  int focusTile = qMin(m_focusTile, numTiles - 1);
+  qreal focusHeight = viewHeight * (1.0 - m_thumbnailSize);
+  if (tileIx == focusTile) {
+    return QRectF(0.0, 0.0, viewWidth, focusHeight);
+  }
+
+  int thumbIx = (tileIx < focusTile) ? tileIx : tileIx - 1;
+  qreal thumbWidth = viewWidth / (numTiles - 1);
+  return QRectF(thumbIx * thumbWidth, focusHeight, thumbWidth, viewHeight - focusHeight);
+}
+
+QSize
+VidLayout::projectedSize(const QMatrix4x4 &mvpMatrix, const QSize &viewportSize, bool &frontFacing)
+{
+  const QVector4D corners[4] = {
+    QVector4D(VIDTEXTURE_LEFT_X,  VIDTEXTURE_TOP_Y, 0.0, 1.0),
+    QVector4D(VIDTEXTURE_RIGHT_X, VIDTEXTURE_TOP_Y, 0.0, 1.0),
+    QVector4D(VIDTEXTURE_LEFT_X,  VIDTEXTURE_BOT_Y, 0.0, 1.0),
+    QVector4D(VIDTEXTURE_RIGHT_X, VIDTEXTURE_BOT_Y, 0.0, 1.0)
+  };
+
+  bool anyInFront = false;
+  bool allInFront = true;
+  QPointF ndc[4];
+  qreal minX = 1.0, minY = 1.0, maxX = -1.0, maxY = -1.0;
+  for (int cornerIx = 0; cornerIx < 4; cornerIx++) {
+    QVector4D clipPos = mvpMatrix * corners[cornerIx];
+    // Corners behind the eye would project somewhere meaningless
+    if (clipPos.w() <= 0.0) {
+      allInFront = false;
+      continue;
+    }
+    qreal ndcX = clipPos.x() / clipPos.w();
+    qreal ndcY = clipPos.y() / clipPos.w();
+    ndc[cornerIx] = QPointF(ndcX, ndcY);
+    if (!anyInFront) {
+      minX = maxX = ndcX;
+      minY = maxY = ndcY;
+      anyInFront = true;
+    }
+    else {
+      minX = qMin(minX, ndcX);
+      maxX = qMax(maxX, ndcX);
+      minY = qMin(minY, ndcY);
+      maxY = qMax(maxY, ndcY);
+    }
+  }
+
+  // Front facing when the quad's x axis still runs to the right of its y
+  // axis on screen, i.e. the video isn't mirrored. Partly behind the eye
+  // can't be worked out this way, assume it's seen.
+  frontFacing = true;
+  if (allInFront) {
+    QPointF xAxis = ndc[1] - ndc[0];
+    QPointF yAxis = ndc[0] - ndc[2];
+    frontFacing = ((xAxis.x() * yAxis.y()) - (xAxis.y() * yAxis.x())) > 0.0;
+  }
+
+  if (!anyInFront) {
+    return QSize(0, 0);
+  }
+
+  // Clip to the viewport, NDC is -1..1 both ways
+  minX = qBound((qreal)-1.0, minX, (qreal)1.0);
+  maxX = qBound((qreal)-1.0, maxX, (qreal)1.0);
+  minY = qBound((qreal)-1.0, minY, (qreal)1.0);
+  maxY = qBound((qreal)-1.0, maxY, (qreal)1.0);
+
+  return QSize((int)ceil((maxX - minX) * 0.5 * viewportSize.width()),
+               (int)ceil((maxY - minY) * 0.5 * viewportSize.height()));
+}
@@ -0,0 +1,79 @@
+#ifndef VIDLAYOUT_H
+#define VIDLAYOUT_H
+
+#include <QMatrix4x4>
+#include <QVector>
+#include <QString>
+#include <QSize>
+#include <QRectF>
+
+#define DFLT_LAYOUT_GRID_MARGIN       4
+#define DFLT_LAYOUT_THUMBNAIL_SIZE    0.2f
+
+typedef enum
+{
+  VidLayoutCarousel = 0,
+  VidLayoutStack,
+  VidLayoutGrid,
+  VidLayoutFocus
+} VidLayoutType;
+
+// Places the video quads. Carousel and stack are the original 3D layouts
+// around the model, grid and focus+thumbnails are flat video wall layouts
+// behind it. Also works out how many pixels each tile covers on screen, so
+// streams can be decoded at a size to match.
+//
+// Layout files are JSON, all keys optional, e.g.
+// { "layout": "grid", "columns": 4, "margin": 4 }
+// { "layout": "focus", "focus": 0, "thumbnailSize": 0.2 }
+// { "layout": "carousel", "scaleDecode": false }
+class VidLayout
+{
+public:
+  VidLayout();
+
+  bool Load(const QString &fileName);
+
+  VidLayoutType Type() const { return m_type; }
+  void SetType(VidLayoutType type) { m_type = type; }
+  // Stack toggle from the controls, overrides the configured layout while on
+  void SetStacked(bool stacked) { m_stacked = stacked; }
+  bool ScaleDecode() const { return m_scaleDecode; }
+
+  // Recalculate tile transforms and sizes for this frame
+  void Update(int numTiles, const QMatrix4x4 &modelViewMatrix,
+              const QMatrix4x4 &projectionMatrix, const QSize &viewportSize);
+
+  const QMatrix4x4 &TileMvMatrix(int tileIx) const { return m_tiles[tileIx].mvMatrix; }
+  const QMatrix4x4 &TileMvpMatrix(int tileIx) const { return m_tiles[tileIx].mvpMatrix; }
+  // Bounding box of the tile on screen, clipped to the viewport
+  QSize TilePixelSize(int tileIx) const { return m_tiles[tileIx].pixelSize; }
+  // On screen and facing the camera, back-facing quads show the video mirrored
+  bool TileVisible(int tileIx) const { return m_tiles[tileIx].visible; }
+
+private:
+  typedef struct _VidTile
+  {
+    QMatrix4x4 mvMatrix;
+    QMatrix4x4 mvpMatrix;
+    QSize pixelSize;
+    bool visible;
+  } VidTile;
+
+  void layoutAroundModel(const QMatrix4x4 &modelViewMatrix, const QMatrix4x4 &projectionMatrix);
+  void layoutFlat(const QSize &viewportSize);
+  QRectF flatTileRect(int tileIx, const QSize &viewportSize);
+  QSize projectedSize(const QMatrix4x4 &mvpMatrix, const QSize &viewportSize, bool &frontFacing);
+
+  VidLayoutType m_type;
+  bool m_stacked;
+  bool m_scaleDecode;
+  int m_gridColumns;
+  int m_gridMargin;
+  int m_focusTile;
+  float m_thumbnailSize;
+
+  QVector<VidTile> m_tiles;
+};
+
+#endif // VIDLAYOUT_H
@@ -0,0 +1,274 @@
+#include <string.h>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include "vidquadbatcher.h"
+#include "applogger.h"
+
+VidQuadBatcher::VidQuadBatcher() :
+  m_available(false), m_instanceVbo(QGLBuffer::VertexBuffer)
+{
+}
+
+VidQuadBatcher::~VidQuadBatcher()
+{
+}
+
+void
+VidQuadBatcher::Cleanup()
+{
+  for (int batchIx = 0; batchIx < m_batches.size(); batchIx++) {
+    glDeleteTextures(1, &m_batches[batchIx].texId);
+  }
+  m_batches.clear();
+  m_vidSlots.clear();
+  m_available = false;
+}
+
+bool
+VidQuadBatcher::Init(const QGLContext *context)
+{
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  if (extensions == NULL) {
+    LOG(LOG_GL, Logger::Warning, "Can't get GL extensions, video quads won't be batched");
+    return false;
+  }
+
+  if (!strstr(extensions, "GL_ARB_draw_instanced") ||
+      !strstr(extensions, "GL_ARB_instanced_arrays") ||
+      !strstr(extensions, "GL_EXT_texture_array")) {
+    LOG(LOG_GL, Logger::Info, "No instancing or texture array support, video quads won't be batched");
+    return false;
+  }
+
+  if (!m_glExt.ResolveInstancing(context) || !m_glExt.ResolveTexture3D(context)) {
+    LOG(LOG_GL, Logger::Warning, "Couldn't get instancing functions, video quads won't be batched");
+    return false;
+  }
+
+  m_instanceVbo.create();
+  m_instanceVbo.setUsagePattern(QGLBuffer::StreamDraw);
+
+  LOG(LOG_GL, Logger::Info, "Instanced video quad batching enabled");
+  m_available = true;
+  return true;
+}
+
+void
+VidQuadBatcher::AddVid(int vidIx, ColFormat colFormat, const Colorimetry &colorimetry, int width, int height)
+{
+  if (!m_available) {
+    return;
+  }
+
+  RemoveVid(vidIx);
+
+  int batchIx = findOrCreateBatch(colFormat, colorimetry, width, height);
+  if (batchIx < 0) {
+    return;
+  }
+
+  VidBatch &batch = m_batches[batchIx];
+  int layer = batch.layerOwners.indexOf(-1);
+  if (layer < 0) {
+    growBatch(batch);
+    layer = batch.layerOwners.indexOf(-1);
+  }
+  batch.layerOwners[layer] = vidIx;
+
+  VidSlot slot;
+  slot.batchIx = batchIx;
+  slot.layer = layer;
+  slot.layerValid = false;
+  m_vidSlots.insert(vidIx, slot);
+
+  LOG(LOG_GL, Logger::Debug1, "vid %d added to batch %d layer %d", vidIx, batchIx, layer);
+}
+
+void
+VidQuadBatcher::RemoveVid(int vidIx)
+{
+  if (!m_vidSlots.contains(vidIx)) {
+    return;
+  }
+
+  // Layer is left free for the next vid of this format, batches are never
+  // shrunk as streams tend to come back with the same format
+  VidSlot slot = m_vidSlots.take(vidIx);
+  m_batches[slot.batchIx].layerOwners[slot.layer] = -1;
+}
+
+bool
+VidQuadBatcher::Upload(int vidIx, const void *data)
+{
+  if (!m_vidSlots.contains(vidIx)) {
+    return false;
+  }
+
+  VidSlot &slot = m_vidSlots[vidIx];
+  VidBatch &batch = m_batches[slot.batchIx];
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, batch.texId);
+  m_glExt.glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot.layer,
+                    batch.texSize.width(), batch.texSize.height(), 1,
+                    GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  slot.layerValid = true;
+  return true;
+}
+
+void
+VidQuadBatcher::InvalidateLayer(int vidIx)
+{
+  if (m_vidSlots.contains(vidIx)) {
+    m_vidSlots[vidIx].layerValid = false;
+  }
+}
+
+bool
+VidQuadBatcher::AddInstance(int vidIx, const QMatrix4x4 &mvpMatrix)
+{
+  if (!m_vidSlots.contains(vidIx) || !m_vidSlots[vidIx].layerValid) {
+    return false;
+  }
+
+  const VidSlot &slot = m_vidSlots[vidIx];
+  QVector<GLfloat> &instanceData = m_batches[slot.batchIx].instanceData;
+
+  // Column major, so each column goes to one of the mat4 attribute's locations
+  const float *matData = mvpMatrix.constData();
+  for (int i = 0; i < 16; i++) {
+    instanceData.append(matData[i]);
+  }
+  instanceData.append((GLfloat)slot.layer);
+
+  return true;
+}
+
+void
+VidQuadBatcher::DrawBatch(int batchIx)
+{
+  VidBatch &batch = m_batches[batchIx];
+  int numInstances = NumInstances(batchIx);
+  if (numInstances == 0) {
+    return;
+  }
+
+  QOpenGLFunctions *glFuncs = QOpenGLContext::currentContext()->functions();
+  const int stride = VIDBATCH_INSTANCE_FLOATS * sizeof(GLfloat);
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, batch.texId);
+
+  m_instanceVbo.bind();
+  m_instanceVbo.allocate(batch.instanceData.constData(), batch.instanceData.size() * sizeof(GLfloat));
+
+  for (int col = 0; col < 4; col++) {
+    glFuncs->glVertexAttribPointer(VID_ATTRIB_INSTANCE_MVP + col, 4, GL_FLOAT, GL_FALSE, stride,
+                                   (const void *)(col * 4 * sizeof(GLfloat)));
+    glFuncs->glEnableVertexAttribArray(VID_ATTRIB_INSTANCE_MVP + col);
+    m_glExt.glVertexAttribDivisor(VID_ATTRIB_INSTANCE_MVP + col, 1);
+  }
+  glFuncs->glVertexAttribPointer(VID_ATTRIB_INSTANCE_LAYER, 1, GL_FLOAT, GL_FALSE, stride,
+                                 (const void *)(16 * sizeof(GLfloat)));
+  glFuncs->glEnableVertexAttribArray(VID_ATTRIB_INSTANCE_LAYER);
+  m_glExt.glVertexAttribDivisor(VID_ATTRIB_INSTANCE_LAYER, 1);
+
+  m_glExt.glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, numInstances);
+
+  // Leave things as the separately drawn quads expect them
+  for (int col = 0; col < 4; col++) {
+    m_glExt.glVertexAttribDivisor(VID_ATTRIB_INSTANCE_MVP + col, 0);
+    glFuncs->glDisableVertexAttribArray(VID_ATTRIB_INSTANCE_MVP + col);
+  }
+  m_glExt.glVertexAttribDivisor(VID_ATTRIB_INSTANCE_LAYER, 0);
+  glFuncs->glDisableVertexAttribArray(VID_ATTRIB_INSTANCE_LAYER);
+
+  m_instanceVbo.release();
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  batch.instanceData.clear();
+}
+
+qint64
+VidQuadBatcher::BytesAllocated() const
+{
+  qint64 bytes = 0;
+  for (int batchIx = 0; batchIx < m_batches.size(); batchIx++) {
+    const VidBatch &batch = m_batches[batchIx];
+    bytes += (qint64)batch.texSize.width() * batch.texSize.height() * batch.numLayers;
+  }
+  return bytes;
+}
+
+int
+VidQuadBatcher::findOrCreateBatch(ColFormat colFormat, const Colorimetry &colorimetry, int width, int height)
+{
+  for (int batchIx = 0; batchIx < m_batches.size(); batchIx++) {
+    if ((m_batches[batchIx].colFormat == colFormat) &&
+        (m_batches[batchIx].colorimetry.matrix == colorimetry.matrix) &&
+        (m_batches[batchIx].colorimetry.fullRange == colorimetry.fullRange) &&
+        (m_batches[batchIx].vidSize == QSize(width, height))) {
+      return batchIx;
+    }
+  }
+
+  VidBatch newBatch;
+  newBatch.colFormat = colFormat;
+  newBatch.colorimetry = colorimetry;
+  newBatch.vidSize = QSize(width, height);
+  newBatch.numLayers = 0;
+
+  // Same single channel layouts loadNewTexture uses for the separate textures
+  switch (colFormat) {
+  case ColFmt_I420:
+  case ColFmt_NV12:
+    newBatch.texSize = QSize(width, height*1.5f);
+    break;
+  case ColFmt_UYVY:
+    newBatch.texSize = QSize(width*2, height);
+    break;
+  default:
+    LOG(LOG_GL, Logger::Debug1, "Colour format %d can't be batched", colFormat);
+    return -1;
+  }
+
+  glGenTextures(1, &newBatch.texId);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, newBatch.texId);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  m_batches.append(newBatch);
+  return m_batches.size() - 1;
+}
+
+void
+VidQuadBatcher::growBatch(VidBatch &batch)
+{
+  int newNumLayers = (batch.numLayers == 0) ? 1 : batch.numLayers * 2;
+
+  // Reallocating loses the old contents, so every member has to be
+  // uploaded again before it is drawn batched
+  glBindTexture(GL_TEXTURE_2D_ARRAY, batch.texId);
+  m_glExt.glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_LUMINANCE,
+                 batch.texSize.width(), batch.texSize.height(), newNumLayers,
+                 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  for (int layer = 0; layer < batch.numLayers; layer++) {
+    if (batch.layerOwners[layer] >= 0) {
+      InvalidateLayer(batch.layerOwners[layer]);
+    }
+  }
+
+  batch.layerOwners.resize(newNumLayers);
+  for (int layer = batch.numLayers; layer < newNumLayers; layer++) {
+    batch.layerOwners[layer] = -1;
+  }
+  batch.numLayers = newNumLayers;
+
+  LOG(LOG_GL, Logger::Debug1, "Batch of %dx%d format %d now has %d layers",
+      batch.vidSize.width(), batch.vidSize.height(), batch.colFormat, newNumLayers);
+}
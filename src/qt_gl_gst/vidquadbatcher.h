@@ -0,0 +1,96 @@
+#ifndef VIDQUADBATCHER_H
+#define VIDQUADBATCHER_H
+
+#include <QGLContext>
+#include <QGLBuffer>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QMap>
+#include <QSize>
+
+#include "pipeline.h"
+#include "glextfunctions.h"
+
+// Attribute locations of the per-instance data, the mat4 takes four
+#define VID_ATTRIB_INSTANCE_MVP              3
+#define VID_ATTRIB_INSTANCE_LAYER            7
+
+// Floats per instance: mvp matrix then array layer
+#define VIDBATCH_INSTANCE_FLOATS             17
+
+// Draws all the video quads sharing a colour format, colorimetry and frame
+// size with one instanced call. Frames of a batch live in the layers of one texture array,
+// the per-instance transform and layer come from a streamed vertex buffer.
+// Needs ARB_draw_instanced, ARB_instanced_arrays and EXT_texture_array.
+class VidQuadBatcher
+{
+public:
+  VidQuadBatcher();
+  ~VidQuadBatcher();
+
+  // Context must be current. Returns false if instancing or texture arrays
+  // aren't supported, in which case vids should all be drawn separately.
+  bool Init(const QGLContext *context);
+  bool IsAvailable() const { return m_available; }
+  // Context must be current. Deletes the batches' textures, unavailable
+  // after this.
+  void Cleanup();
+
+  // Put a vid into the batch for its format, colorimetry and size, taking it
+  // out of any batch it was in before
+  void AddVid(int vidIx, ColFormat colFormat, const Colorimetry &colorimetry, int width, int height);
+  void RemoveVid(int vidIx);
+  bool IsBatched(int vidIx) const { return m_vidSlots.contains(vidIx); }
+
+  // Upload a frame into the vid's layer. Its layer is only drawn after this
+  // has succeeded, and until InvalidateLayer if it's uploaded elsewhere.
+  bool Upload(int vidIx, const void *data);
+  void InvalidateLayer(int vidIx);
+
+  // Queue an instance of the vid, returns false if it can't be drawn batched
+  bool AddInstance(int vidIx, const QMatrix4x4 &mvpMatrix);
+
+  int NumBatches() const { return m_batches.size(); }
+  int NumInstances(int batchIx) const { return m_batches[batchIx].instanceData.size() / VIDBATCH_INSTANCE_FLOATS; }
+  ColFormat BatchColourFormat(int batchIx) const { return m_batches[batchIx].colFormat; }
+  Colorimetry BatchColorimetry(int batchIx) const { return m_batches[batchIx].colorimetry; }
+  QSize BatchVidSize(int batchIx) const { return m_batches[batchIx].vidSize; }
+  // Texture array storage of all the batches
+  qint64 BytesAllocated() const;
+
+  // Draw the queued instances of a batch with the current shader, the quad
+  // geometry must already be bound. Clears the batch's queue.
+  void DrawBatch(int batchIx);
+
+private:
+  typedef struct _VidBatch
+  {
+    ColFormat colFormat;
+    Colorimetry colorimetry;
+    QSize vidSize;
+    QSize texSize;
+    GLuint texId;
+    int numLayers;
+    QVector<int> layerOwners; // vidIx, -1 if free
+    QVector<GLfloat> instanceData;
+  } VidBatch;
+
+  typedef struct _VidSlot
+  {
+    int batchIx;
+    int layer;
+    bool layerValid;
+  } VidSlot;
+
+  int findOrCreateBatch(ColFormat colFormat, const Colorimetry &colorimetry, int width, int height);
+  void growBatch(VidBatch &batch);
+
+  bool m_available;
+  QVector<VidBatch> m_batches;
+  QMap<int, VidSlot> m_vidSlots;
+  QGLBuffer m_instanceVbo;
+
+  GLExtFunctions m_glExt;
+};
+
+#endif // VIDQUADBATCHER_H
@@ -0,0 +1,112 @@
+#include "yuvcolourmatrix.h"
+
+YuvToRgbCoeffs
+YuvColourMatrix::Coeffs(const Colorimetry &colorimetry, int height)
+{
+  ColMatrix matrix = colorimetry.matrix;
+  if (matrix == ColMatrix_Unknown) {
+    if (height >= YUVMATRIX_UHD_MIN_HEIGHT) {
+      matrix = ColMatrix_BT2020;
+    }
+    else if (height >= YUVMATRIX_HD_MIN_HEIGHT) {
+      matrix = ColMatrix_BT709;
+    }
+    else {
+      matrix = ColMatrix_BT601;
+    }
+  }
+
+  // Luma weights of red and blue, green's is what's left
+  float kr, kb;
+  switch (matrix) {
+  case ColMatrix_BT709:
+    kr = 0.2126f;
+    kb = 0.0722f;
+    break;
+  case ColMatrix_BT2020:
+    kr = 0.2627f;
+    kb = 0.0593f;
+    break;
+  case ColMatrix_SMPTE240M:
+    kr = 0.212f;
+    kb = 0.087f;
+    break;
+  case ColMatrix_FCC:
+    kr = 0.30f;
+    kb = 0.11f;
+    break;
+  case ColMatrix_BT601:
+  default:
+    kr = 0.299f;
+    kb = 0.114f;
+    break;
+  }
+  float kg = 1.0f - kr - kb;
+
+  // Limited range is stretched back out to 0..1 as well
+  float yScale = 1.0f;
+  float cScale = 1.0f;
+  YuvToRgbCoeffs coeffs;
+  if (colorimetry.fullRange) {
+    coeffs.offset = QVector3D(0.0f, -128.0f/255.0f, -128.0f/255.0f);
+  }
+  else {
+    coeffs.offset = QVector3D(-16.0f/255.0f, -128.0f/255.0f, -128.0f/255.0f);
+    yScale = 255.0f/219.0f;
+    cScale = 255.0f/224.0f;
+  }
+
+  coeffs.rCoeff = QVector3D(yScale, 0.0f, 2.0f*(1.0f - kr)*cScale);
+  coeffs.gCoeff = QVector3D(yScale, -2.0f*kb*(1.0f - kb)/kg*cScale, -2.0f*kr*(1.0f - kr)/kg*cScale);
+  coeffs.bCoeff = QVector3D(yScale, 2.0f*(1.0f - kb)*cScale, 0.0f);
+
+  return coeffs;
+}
+
+YuvToRgbCoeffs
+YuvColourMatrix::Passthrough()
+{
+  YuvToRgbCoeffs coeffs;
+  coeffs.offset = QVector3D(0.0f, 0.0f, 0.0f);
+  coeffs.rCoeff = QVector3D(1.0f, 0.0f, 0.0f);
+  coeffs.gCoeff = QVector3D(0.0f, 1.0f, 0.0f);
+  coeffs.bCoeff = QVector3D(0.0f, 0.0f, 1.0f);
+  return coeffs;
+}
+
+void
+YuvColourMatrix::SetUniforms(QGLShaderProgram *prog, const YuvToRgbCoeffs &coeffs)
+{
+  prog->setUniformValue("u_yuvOffset", coeffs.offset);
+  prog->setUniformValue("u_rCoeff", coeffs.rCoeff);
+  prog->setUniformValue("u_gCoeff", coeffs.gCoeff);
+  prog->setUniformValue("u_bCoeff", coeffs.bCoeff);
+}
+
+QVector3D
+YuvColourMatrix::ToRgb(const YuvToRgbCoeffs &coeffs, const QVector3D &yuv)
+{
+  QVector3D offsetYuv = yuv + coeffs.offset;
+  return QVector3D(QVector3D::dotProduct(offsetYuv, coeffs.rCoeff),
+                   QVector3D::dotProduct(offsetYuv, coeffs.gCoeff),
+                   QVector3D::dotProduct(offsetYuv, coeffs.bCoeff));
+}
+
+const char *
+YuvColourMatrix::MatrixName(ColMatrix matrix)
+{
+  switch (matrix) {
+  case ColMatrix_BT601:
+    return "BT.601";
+  case ColMatrix_BT709:
+    return "BT.709";
+  case ColMatrix_BT2020:
+    return "BT.2020";
+  case ColMatrix_SMPTE240M:
+    return "SMPTE 240M";
+  case ColMatrix_FCC:
+    return "FCC";
+  default:
+    return "unknown";
+  }
+}
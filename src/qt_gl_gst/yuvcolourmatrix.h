@@ -0,0 +1,40 @@
+#ifndef YUVCOLOURMATRIX_H
+#define YUVCOLOURMATRIX_H
+
+#include <QVector3D>
+#include <QGLShaderProgram>
+
+#include "pipeline.h"
+
+// Unknown matrices are guessed from the frame height the way GStreamer
+// does, SD is BT.601, HD BT.709 and UHD BT.2020
+#define YUVMATRIX_HD_MIN_HEIGHT              577
+#define YUVMATRIX_UHD_MIN_HEIGHT             2160
+
+// What the conversion shaders take, as 0..1 samples:
+// R = dot(yuv + offset, rCoeff) and the same for G and B
+typedef struct _YuvToRgbCoeffs
+{
+  QVector3D offset;
+  QVector3D rCoeff;
+  QVector3D gCoeff;
+  QVector3D bCoeff;
+} YuvToRgbCoeffs;
+
+// Works out the YUV to RGB conversion for a stream's colorimetry, rather
+// than the shaders assuming BT.601 limited range. Offsets are the 8 bit
+// ones, which are within 0.1% of the 10 bit ones once normalised.
+class YuvColourMatrix
+{
+public:
+  static YuvToRgbCoeffs Coeffs(const Colorimetry &colorimetry, int height);
+  // Leaves the samples as they are, for when conversion is done later
+  static YuvToRgbCoeffs Passthrough();
+  // Sets u_yuvOffset, u_rCoeff, u_gCoeff and u_bCoeff, prog must be bound
+  static void SetUniforms(QGLShaderProgram *prog, const YuvToRgbCoeffs &coeffs);
+  // Same sums as the shaders on the CPU, 0..1 in and out, not clamped
+  static QVector3D ToRgb(const YuvToRgbCoeffs &coeffs, const QVector3D &yuv);
+  static const char *MatrixName(ColMatrix matrix);
+};
+
+#endif // YUVCOLOURMATRIX_H